@@ -0,0 +1,316 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "AgentStateTable.h"
+#include <algorithm>
+
+namespace AI
+{
+	const AgentStateTable::TrackedIdentifier AgentStateTable::tracked[AgentStateTable::TrackedCount] = 
+	{
+		{WorldStateIdentifier::Alertness, false, true},
+		{WorldStateIdentifier::Curiosity, false, true},
+		{WorldStateIdentifier::PlayerIdentified, true, false}
+	};
+
+	AgentHandle AgentStateTable::addAgent()
+	{
+		for (int n = 0; n < WorldStateIdentifierCount; n++)
+		{
+			flags[n].push_back(0);
+			values[n].push_back(0.f);
+			vectorX[n].push_back(0.f);
+			vectorY[n].push_back(0.f);
+			vectorZ[n].push_back(0.f);
+		}
+
+		flagsPresent.push_back(0);
+		valuesPresent.push_back(0);
+		vectorsPresent.push_back(0);
+
+		for (auto& tracker : trackers)
+		{
+			tracker.maxValue.push_back(0.f);
+			tracker.durationBelowValue.push_back(0.f);
+			tracker.reacted.push_back(0);
+		}
+
+		lostLead.push_back(0);
+
+		return agentCount++;
+	}
+
+	bool AgentStateTable::getFlag(AgentHandle agent, WorldStateIdentifier identifier) const
+	{
+		return flags[static_cast<int>(identifier)][agent] != 0;
+	}
+
+	float AgentStateTable::getValue(AgentHandle agent, WorldStateIdentifier identifier) const
+	{
+		return values[static_cast<int>(identifier)][agent];
+	}
+
+	Math::Vector3 AgentStateTable::getVector(AgentHandle agent, WorldStateIdentifier identifier) const
+	{
+		auto n = static_cast<int>(identifier);
+		return {vectorX[n][agent], vectorY[n][agent], vectorZ[n][agent]};
+	}
+
+	void AgentStateTable::setFlag(AgentHandle agent, WorldStateIdentifier identifier, bool flag)
+	{
+		auto n = static_cast<int>(identifier);
+		flags[n][agent] = flag;
+		flagsPresent[agent] |= 1u << n;
+	}
+
+	void AgentStateTable::setValue(AgentHandle agent, WorldStateIdentifier identifier, float value)
+	{
+		auto n = static_cast<int>(identifier);
+		values[n][agent] = value;
+		valuesPresent[agent] |= 1u << n;
+	}
+
+	void AgentStateTable::setVector(AgentHandle agent, WorldStateIdentifier identifier, Math::Vector3 vector)
+	{
+		auto n = static_cast<int>(identifier);
+		vectorX[n][agent] = vector.x;
+		vectorY[n][agent] = vector.y;
+		vectorZ[n][agent] = vector.z;
+		vectorsPresent[agent] |= 1u << n;
+	}
+
+	void AgentStateTable::load(AgentHandle agent, WorldState& state) const
+	{
+		for (int n = 0; n < WorldStateIdentifierCount; n++)
+		{
+			auto identifier = static_cast<WorldStateIdentifier>(n);
+			auto bit = 1u << n;
+
+			if (flagsPresent[agent] & bit)
+				state.setFlag(identifier, flags[n][agent] != 0);
+			else
+				state.remove(StateSlot::Flag, identifier);
+
+			if (valuesPresent[agent] & bit)
+				state.setValue(identifier, values[n][agent]);
+			else
+				state.remove(StateSlot::Value, identifier);
+
+			if (vectorsPresent[agent] & bit)
+				state.setVector(identifier, getVector(agent, identifier));
+			else
+				state.remove(StateSlot::Vector, identifier);
+		}
+	}
+
+	void AgentStateTable::store(AgentHandle agent, const State& state)
+	{
+		for (int n = 0; n < WorldStateIdentifierCount; n++)
+		{
+			auto identifier = static_cast<WorldStateIdentifier>(n);
+			auto vector = state.vectors.at(identifier);
+
+			flags[n][agent] = state.flags.at(identifier);
+			values[n][agent] = state.values.at(identifier);
+			vectorX[n][agent] = vector.x;
+			vectorY[n][agent] = vector.y;
+			vectorZ[n][agent] = vector.z;
+		}
+
+		flagsPresent[agent] = state.flags.presentMask();
+		valuesPresent[agent] = state.values.presentMask();
+		vectorsPresent[agent] = state.vectors.presentMask();
+	}
+
+	bool AgentStateTable::loadTrackers(AgentHandle agent, std::map<WorldStateIdentifier, ValueOverTimeTracker>& valueTrackers) const
+	{
+		bool changed {false};
+
+		for (int i = 0; i < TrackedCount; i++)
+		{
+			auto& tracker = valueTrackers[tracked[i].identifier];
+			auto reacted = trackers[i].reacted[agent] != 0;
+
+			changed |= tracker.maxValue != trackers[i].maxValue[agent]
+				|| tracker.durationBelowValue != trackers[i].durationBelowValue[agent]
+				|| tracker.reacted != reacted;
+
+			tracker.maxValue = trackers[i].maxValue[agent];
+			tracker.durationBelowValue = trackers[i].durationBelowValue[agent];
+			tracker.reacted = reacted;
+			tracker.hasExtension = tracked[i].hasExtension;
+		}
+
+		return changed;
+	}
+
+	void AgentStateTable::storeTrackers(AgentHandle agent, const std::map<WorldStateIdentifier, ValueOverTimeTracker>& valueTrackers)
+	{
+		for (int i = 0; i < TrackedCount; i++)
+		{
+			auto tracker = valueTrackers.find(tracked[i].identifier);
+
+			if (tracker != valueTrackers.end())
+			{
+				trackers[i].maxValue[agent] = tracker->second.maxValue;
+				trackers[i].durationBelowValue[agent] = tracker->second.durationBelowValue;
+				trackers[i].reacted[agent] = tracker->second.reacted ? 1 : 0;
+			}
+		}
+	}
+
+	void AgentStateTable::decayEmotions()
+	{
+		auto alertness = values[static_cast<int>(WorldStateIdentifier::Alertness)].data();
+		auto boredom = values[static_cast<int>(WorldStateIdentifier::Boredom)].data();
+		auto present = valuesPresent.data();
+		auto written = (1u << static_cast<int>(WorldStateIdentifier::Alertness)) | (1u << static_cast<int>(WorldStateIdentifier::Boredom));
+
+		for (int agent = 0; agent < agentCount; agent++)
+		{
+			alertness[agent] = std::min(std::max(alertness[agent] - 0.09f, 0.f), 100.f);
+			boredom[agent] = std::min(std::max(boredom[agent] + 0.01f, 0.f), 100.f);
+			present[agent] |= written;
+		}
+	}
+
+	//ValueOverTimeTracker::update written without branches so it vectorizes
+	template<typename T>
+	void updateTrackerColumn(const T* input, float* maxValue, float* durationBelowValue, std::uint8_t* reacted, int count, float dt)
+	{
+		for (int agent = 0; agent < count; agent++)
+		{
+			float value = input[agent];
+			bool rising = value >= maxValue[agent];
+			float duration = rising ? 0.f : (maxValue[agent] > 0.f ? durationBelowValue[agent] + dt : 0.f);
+			float max = rising ? value : maxValue[agent];
+			bool expired = duration > ValueOverTimeTracker::maximumDurationToTrack;
+
+			reacted[agent] = rising ? 0 : reacted[agent];
+			durationBelowValue[agent] = expired ? 0.f : duration;
+			maxValue[agent] = expired ? 0.f : max;
+		}
+	}
+
+	void AgentStateTable::updateTrackers(float dt)
+	{
+		for (int i = 0; i < TrackedCount; i++)
+		{
+			auto n = static_cast<int>(tracked[i].identifier);
+			auto& tracker = trackers[i];
+
+			if (tracked[i].isFlag)
+			{
+				updateTrackerColumn(flags[n].data(), tracker.maxValue.data(), tracker.durationBelowValue.data(), 
+					tracker.reacted.data(), agentCount, dt);
+			}
+			else
+			{
+				updateTrackerColumn(values[n].data(), tracker.maxValue.data(), tracker.durationBelowValue.data(), 
+					tracker.reacted.data(), agentCount, dt);
+			}
+		}
+	}
+
+	void AgentStateTable::distancesSquared(WorldStateIdentifier from, WorldStateIdentifier to, std::vector<float>& out) const
+	{
+		auto f = static_cast<int>(from);
+		auto t = static_cast<int>(to);
+		out.resize(agentCount);
+
+		for (int agent = 0; agent < agentCount; agent++)
+		{
+			auto x = vectorX[t][agent] - vectorX[f][agent];
+			auto y = vectorY[t][agent] - vectorY[f][agent];
+			auto z = vectorZ[t][agent] - vectorZ[f][agent];
+			out[agent] = x * x + y * y + z * z;
+		}
+	}
+
+	void AgentStateTable::tickEmotionalState(float dt)
+	{
+		decayEmotions();
+		updateTrackers(dt);
+
+		//trackers 0 and 1 are alertness and curiosity, see tracked
+		auto& alertness = trackers[0];
+		auto& curiosity = trackers[1];
+
+		for (int agent = 0; agent < agentCount; agent++)
+		{
+			bool alertnessFalling = ValueOverTimeTracker::exceedsExtension(alertness.maxValue[agent], alertness.durationBelowValue[agent]);
+			bool curiosityFalling = ValueOverTimeTracker::exceedsExtension(curiosity.maxValue[agent], curiosity.durationBelowValue[agent]);
+			lostLead[agent] |= alertnessFalling && curiosityFalling;
+		}
+	}
+
+	bool AgentStateTable::takeLostLead(AgentHandle agent)
+	{
+		bool lost = lostLead[agent] != 0;
+		lostLead[agent] = 0;
+
+		return lost;
+	}
+
+	template<typename T>
+	void hashColumn(std::uint64_t& hash, const std::vector<T>& column)
+	{
+		//FNV-1a
+		auto bytes = reinterpret_cast<const std::uint8_t*>(column.data());
+
+		for (std::size_t i = 0; i < column.size() * sizeof(T); i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		}
+	}
+
+	std::uint64_t AgentStateTable::checksum() const
+	{
+		std::uint64_t hash {0xcbf29ce484222325ull};
+
+		for (int i = 0; i < WorldStateIdentifierCount; i++)
+		{
+			hashColumn(hash, flags[i]);
+			hashColumn(hash, values[i]);
+			hashColumn(hash, vectorX[i]);
+			hashColumn(hash, vectorY[i]);
+			hashColumn(hash, vectorZ[i]);
+		}
+
+		hashColumn(hash, flagsPresent);
+		hashColumn(hash, valuesPresent);
+		hashColumn(hash, vectorsPresent);
+
+		for (auto& columns : trackers)
+		{
+			hashColumn(hash, columns.maxValue);
+			hashColumn(hash, columns.durationBelowValue);
+			hashColumn(hash, columns.reacted);
+		}
+
+		hashColumn(hash, lostLead);
+
+		return hash;
+	}
+}
@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "WorldState.h"
+
+namespace AI
+{
+	//a row in an AgentStateTable, rows are never moved so this stays valid as long as the table does
+	typedef int AgentHandle;
+
+	/*
+	Every agent's State stored as columns, one per WorldStateIdentifier: alertness for every agent
+	is contiguous, so are positions, and so on. Each agent still plans and runs tasks on its own
+	WorldState, and copies its row in and out of the table with load/store once a tick. The per-tick
+	updates every agent does the same way (emotional decay, value trackers) are done here for all
+	agents in one pass over a few columns, instead of one agent at a time through a map.
+	*/
+	class AgentStateTable
+	{
+	public:
+
+		AgentHandle addAgent();
+		int size() const {return agentCount;}
+
+		bool getFlag(AgentHandle agent, WorldStateIdentifier identifier) const;
+		float getValue(AgentHandle agent, WorldStateIdentifier identifier) const;
+		Math::Vector3 getVector(AgentHandle agent, WorldStateIdentifier identifier) const;
+
+		void setFlag(AgentHandle agent, WorldStateIdentifier identifier, bool flag);
+		void setValue(AgentHandle agent, WorldStateIdentifier identifier, float value);
+		void setVector(AgentHandle agent, WorldStateIdentifier identifier, Math::Vector3 vector);
+
+		//copies an agent's row into/out of state, including which entries are present.
+		//load goes through WorldState's setters so its subscribers see what the batch kernels changed
+		void load(AgentHandle agent, WorldState& state) const;
+		void store(AgentHandle agent, const State& state);
+
+		/*
+		copies the tracked identifiers' ValueOverTimeTrackers, leaving anything else in trackers alone.
+		Returns true if that changed any of them
+		*/
+		bool loadTrackers(AgentHandle agent, std::map<WorldStateIdentifier, ValueOverTimeTracker>& trackers) const;
+		void storeTrackers(AgentHandle agent, const std::map<WorldStateIdentifier, ValueOverTimeTracker>& trackers);
+
+		/*
+		Batch kernels, each runs over every agent
+		*/
+
+		//alertness slowly drops and boredom slowly rises, both clamped to [0, 100]
+		void decayEmotions();
+
+		//ValueOverTimeTracker::update for every agent, tracking values[identifier] (or flags[identifier] for flag trackers)
+		void updateTrackers(float dt);
+
+		//out[agent] = distanceSquared(vectors[from], vectors[to])
+		void distancesSquared(WorldStateIdentifier from, WorldStateIdentifier to, std::vector<float>& out) const;
+
+		//decayEmotions, updateTrackers and then flags agents whose alertness and curiosity have both been falling for a while
+		void tickEmotionalState(float dt);
+
+		//true once after tickEmotionalState decided the agent lost its lead
+		bool takeLostLead(AgentHandle agent);
+
+		//a hash of every column, equal for tables holding the same bits
+		std::uint64_t checksum() const;
+
+		struct TrackedIdentifier
+		{
+			WorldStateIdentifier identifier;
+			//tracks flags[identifier] as 0/1 instead of values[identifier]
+			bool isFlag;
+			//see ValueOverTimeTracker::hasExtension
+			bool hasExtension;
+		};
+
+		//the identifiers updateTrackers tracks
+		static const int TrackedCount {3};
+		static const TrackedIdentifier tracked[TrackedCount];
+
+	private:
+
+		struct TrackerColumns
+		{
+			std::vector<float> maxValue;
+			std::vector<float> durationBelowValue;
+			std::vector<std::uint8_t> reacted;
+		};
+
+		int agentCount {0};
+
+		std::vector<std::uint8_t> flags[WorldStateIdentifierCount];
+		std::vector<float> values[WorldStateIdentifierCount];
+		std::vector<float> vectorX[WorldStateIdentifierCount];
+		std::vector<float> vectorY[WorldStateIdentifierCount];
+		std::vector<float> vectorZ[WorldStateIdentifierCount];
+
+		//per agent, bit n is set if identifier n is present, same as EnumMap::presentMask
+		std::vector<std::uint32_t> flagsPresent;
+		std::vector<std::uint32_t> valuesPresent;
+		std::vector<std::uint32_t> vectorsPresent;
+
+		TrackerColumns trackers[TrackedCount];
+		std::vector<std::uint8_t> lostLead;
+	};
+}
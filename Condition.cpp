@@ -29,79 +29,590 @@ SOFTWARE.
 
 namespace AI
 {
-    bool Condition::isTrue(const WorldState& state, const Task& task, const std::vector<SatisfiablePredicate>& satisfiablePredicates, bool isMerged)
+	bool compare(float lhs, ConditionOp op, float rhs)
 	{
+		switch (op)
+		{
+			case ConditionOp::LessThan
+				:
+			{
+				return lhs < rhs;
+			}
+			case ConditionOp::LessEqual
+				:
+			{
+				return lhs <= rhs;
+			}
+			case ConditionOp::EqualTo
+				:
+			{
+				return lhs == rhs;
+			}
+			case ConditionOp::NotEqualTo
+				:
+			{
+				return lhs != rhs;
+			}
+			case ConditionOp::GreaterThan
+				:
+			{
+				return lhs > rhs;
+			}
+			case ConditionOp::GreaterEqual
+				:
+			{
+				return lhs >= rhs;
+			}
+		}
+
+		return false;
+	}
+
+	bool ValueRange::contains(float x) const
+	{
+		return (minInclusive ? x >= min : x > min)
+			&& (maxInclusive ? x <= max : x < max);
+	}
+
+	bool ValueRange::isEmpty() const
+	{
+		return min > max || (min == max && !(minInclusive && maxInclusive));
+	}
+
+	bool ValueRange::overlaps(const ValueRange& other) const
+	{
+		return !intersect(*this, other).isEmpty();
+	}
+
+	bool operator==(const ValueRange& lhs, const ValueRange& rhs)
+	{
+		return lhs.min == rhs.min
+			&& lhs.max == rhs.max
+			&& lhs.minInclusive == rhs.minInclusive
+			&& lhs.maxInclusive == rhs.maxInclusive;
+	}
+
+	ValueRange toValueRange(ConditionOp op, float value)
+	{
+		ValueRange range;
+
+		switch (op)
+		{
+			case ConditionOp::LessThan
+				:
+			{
+				range.max = value;
+				range.maxInclusive = false;
+				break;
+			}
+			case ConditionOp::LessEqual
+				:
+			{
+				range.max = value;
+				break;
+			}
+			case ConditionOp::EqualTo
+				:
+			{
+				range.min = value;
+				range.max = value;
+				break;
+			}
+			case ConditionOp::NotEqualTo
+				:
+			{
+				break;
+			}
+			case ConditionOp::GreaterThan
+				:
+			{
+				range.min = value;
+				range.minInclusive = false;
+				break;
+			}
+			case ConditionOp::GreaterEqual
+				:
+			{
+				range.min = value;
+				break;
+			}
+		}
+
+		return range;
+	}
+
+	ValueRange intersect(const ValueRange& lhs, const ValueRange& rhs)
+	{
+		ValueRange range;
+
+		if (lhs.min == rhs.min)
+		{
+			range.min = lhs.min;
+			range.minInclusive = lhs.minInclusive && rhs.minInclusive;
+		}
+		else
+		{
+			auto& tighter = lhs.min > rhs.min ? lhs : rhs;
+			range.min = tighter.min;
+			range.minInclusive = tighter.minInclusive;
+		}
+
+		if (lhs.max == rhs.max)
+		{
+			range.max = lhs.max;
+			range.maxInclusive = lhs.maxInclusive && rhs.maxInclusive;
+		}
+		else
+		{
+			auto& tighter = lhs.max < rhs.max ? lhs : rhs;
+			range.max = tighter.max;
+			range.maxInclusive = tighter.maxInclusive;
+		}
+
+		return range;
+	}
+
+	int countBits(std::uint32_t bits)
+	{
+		bits = bits - ((bits >> 1) & 0x55555555u);
+		bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+		return (((bits + (bits >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+	}
+
+	int PackedCondition::count() const
+	{
+		return countBits(flagMask)
+			+ countBits(valueMask | excludedMask)
+			+ countBits(consumableFlags)
+			+ countBits(consumableValues)
+			+ countBits(consumableVectors);
+	}
+
+	template<typename Facts>
+	std::uint64_t unconsumedRequirements(std::uint32_t mask, const Facts& facts, int start)
+	{
+		std::uint64_t satisfied {0};
+
+		forEachBit(mask, [&](int n)
+		{
+			auto it = facts.find(static_cast<ConsumableFact>(n));
+
+			if (it != end(facts) && !it->second.consumed)
+			{
+				satisfied |= std::uint64_t{1} << (start + n);
+			}
+		});
+
+		return satisfied;
+	}
+
+	template<typename Facts>
+	bool allUnconsumed(std::uint32_t mask, const Facts& facts)
+	{
+		for (int n = 0; mask != 0; n++, mask >>= 1)
+		{
+			if (mask & 1)
+			{
+				auto it = facts.find(static_cast<ConsumableFact>(n));
+
+				if (it == end(facts) || it->second.consumed)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	//same order as a compiled Condition, stopping at the first requirement that's false
+	bool PackedCondition::isTrue(const WorldState& state) const
+	{
+		if (contradictory || !holdsFor(state, flagMask, 0))
+			return false;
+
+		if (!allUnconsumed(consumableFlags, state.facts.flags)
+			|| !allUnconsumed(consumableValues, state.facts.values)
+			|| !allUnconsumed(consumableVectors, state.facts.vectors))
+		{
+			return false;
+		}
+
+		return holdsFor(state, 0, valueMask | excludedMask);
+	}
+
+	bool PackedCondition::holdsFor(const WorldState& state, std::uint32_t flags, std::uint32_t values) const
+	{
+		for (std::uint32_t mask = flagMask & flags, n = 0; mask != 0; n++, mask >>= 1)
+		{
+			if (mask & 1)
+			{
+				auto it = state.current.flags.find(static_cast<WorldStateIdentifier>(n));
+
+				if (it == end(state.current.flags) || it->second != ((flagValues & (1u << n)) != 0))
+				{
+					return false;
+				}
+			}
+		}
+
+		for (std::uint32_t mask = (valueMask | excludedMask) & values, n = 0; mask != 0; n++, mask >>= 1)
+		{
+			if (mask & 1)
+			{
+				auto it = state.current.values.find(static_cast<WorldStateIdentifier>(n));
+				auto bit = 1u << n;
+
+				if (it == end(state.current.values)
+					|| ((valueMask & bit) && !ranges[n].contains(it->second))
+					|| ((excludedMask & bit) && excludes(n, it->second)))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	std::uint64_t PackedCondition::requirementMask() const
+	{
+		std::uint64_t mask {0};
+
+		forEachBit(flagMask, [&](int n)
+		{
+			auto flag = (flagValues & (1u << n)) ? 1 : 0;
+			mask |= std::uint64_t{1} << (FlagRequirementsStart + 2 * n + flag);
+		});
+
+		return mask
+			| (std::uint64_t{valueMask | excludedMask} << ValueRequirementsStart)
+			| (std::uint64_t{consumableFlags} << ConsumableFlagRequirementsStart)
+			| (std::uint64_t{consumableValues} << ConsumableValueRequirementsStart)
+			| (std::uint64_t{consumableVectors} << ConsumableVectorRequirementsStart);
+	}
+
+	std::uint64_t PackedCondition::satisfiedRequirements(const WorldState& state) const
+	{
+		std::uint64_t satisfied {0};
+
+		forEachBit(flagMask, [&](int n)
+		{
+			auto it = state.current.flags.find(static_cast<WorldStateIdentifier>(n));
+			auto flag = (flagValues & (1u << n)) != 0;
+
+			if (it != end(state.current.flags) && it->second == flag)
+			{
+				satisfied |= std::uint64_t{1} << (FlagRequirementsStart + 2 * n + (flag ? 1 : 0));
+			}
+		});
+
+		forEachBit(valueMask | excludedMask, [&](int n)
+		{
+			auto it = state.current.values.find(static_cast<WorldStateIdentifier>(n));
+			auto bit = 1u << n;
+
+			if (it != end(state.current.values)
+				&& (!(valueMask & bit) || ranges[n].contains(it->second))
+				&& (!(excludedMask & bit) || !excludes(n, it->second)))
+			{
+				satisfied |= std::uint64_t{1} << (ValueRequirementsStart + n);
+			}
+		});
+
+		return satisfied
+			| unconsumedRequirements(consumableFlags, state.facts.flags, ConsumableFlagRequirementsStart)
+			| unconsumedRequirements(consumableValues, state.facts.values, ConsumableValueRequirementsStart)
+			| unconsumedRequirements(consumableVectors, state.facts.vectors, ConsumableVectorRequirementsStart);
+	}
+
+	bool PackedCondition::excludes(int n, float value) const
+	{
+		return std::find(excluded[n], excluded[n] + excludedCounts[n], value) != excluded[n] + excludedCounts[n];
+	}
+
+	void PackedCondition::exclude(int n, float value)
+	{
+		auto bit = 1u << n;
+
+		if (excludes(n, value))
+			return;
+
+		if (excludedCounts[n] == MaxExcludedValues)
+		{
+			contradictory = true;
+			return;
+		}
+
+		excluded[n][excludedCounts[n]++] = value;
+		excludedMask |= bit;
+		intersectExclusions(n);
+	}
+
+	void PackedCondition::intersectExclusions(int n)
+	{
+		auto bit = 1u << n;
+
+		if (!(valueMask & bit) || !(excludedMask & bit))
+			return;
+
+		auto& range = ranges[n];
+		auto kept = std::remove_if(excluded[n], excluded[n] + excludedCounts[n], [&](float value) {return !range.contains(value);});
+		excludedCounts[n] = static_cast<std::uint8_t>(kept - excluded[n]);
+
+		if (excludedCounts[n] == 0)
+		{
+			excludedMask &= ~bit;
+		}
+		else if (range.min == range.max && excludes(n, range.min))
+		{
+			//the only value the range allows is excluded
+			contradictory = true;
+		}
+	}
+
+	void PackedCondition::clearExclusions(int n)
+	{
+		excludedMask &= ~(1u << n);
+		excludedCounts[n] = 0;
+	}
+
+	void Condition::pack()
+	{
+		packed = {};
+
 		for (auto& requiredFlag : requiredFlags)
 		{
-			auto it = state.current.flags.find(requiredFlag.id);
+			auto bit = 1u << static_cast<int>(requiredFlag.id);
+			auto value = requiredFlag.flag ? bit : 0u;
 
-			if (it == end(state.current.flags))
+			if ((packed.flagMask & bit) && (packed.flagValues & bit) != value)
 			{
-				log("[Condition] ", "ERROR: flag missing");
+				packed.contradictory = true;
 			}
 
-			if (it->second != requiredFlag.flag)
-				return false;
+			packed.flagMask |= bit;
+			packed.flagValues |= value;
 		}
 
 		for (auto& requiredValue : requiredValues)
 		{
-			auto it = state.current.values.find(requiredValue.id);
+			auto n = static_cast<int>(requiredValue.id);
+			auto bit = 1u << n;
 
-			if (it == end(state.current.values))
+			if (requiredValue.op == ConditionOp::NotEqualTo)
 			{
-				log("[Condition] ", "ERROR: flag missing");
+				//added after the ranges are known so the ones the ranges rule out aren't kept
+				continue;
 			}
 
-			switch (requiredValue.op)
+			auto range = toValueRange(requiredValue.op, requiredValue.value);
+			packed.ranges[n] = (packed.valueMask & bit) ? intersect(packed.ranges[n], range) : range;
+			packed.valueMask |= bit;
+
+			if (packed.ranges[n].isEmpty())
+			{
+				packed.contradictory = true;
+			}
+		}
+
+		for (auto& requiredValue : requiredValues)
+		{
+			if (requiredValue.op == ConditionOp::NotEqualTo)
 			{
-				case ConditionOp::LessThan
+				packed.exclude(static_cast<int>(requiredValue.id), requiredValue.value);
+			}
+		}
+
+		for (auto& predicate : satisfiedPredicates)
+		{
+			packed.predicates |= 1u << static_cast<int>(predicate.identifier);
+		}
+
+		for (auto consumable : consumableFlags)
+		{
+			packed.consumableFlags |= 1u << static_cast<int>(consumable);
+		}
+
+		for (auto consumable : consumableValues)
+		{
+			packed.consumableValues |= 1u << static_cast<int>(consumable);
+		}
+
+		for (auto consumable : consumableVectors)
+		{
+			packed.consumableVectors |= 1u << static_cast<int>(consumable);
+		}
+	}
+
+	SatisfiablePredicateFunction findPredicate(SatisfiablePredicateIdentifier identifier, 
+		const std::vector<SatisfiablePredicate>& satisfiablePredicates)
+	{
+		auto it = std::find_if(begin(satisfiablePredicates), end(satisfiablePredicates), 
+			[identifier](const auto& sp) {return sp.identifier == identifier;});
+
+		return it != end(satisfiablePredicates) ? it->func : nullptr;
+	}
+
+	void Condition::compile(const std::vector<SatisfiablePredicate>& satisfiablePredicates)
+	{
+		program.clear();
+		program.reserve(requiredFlags.size() + requiredValues.size() + satisfiedPredicates.size() 
+			+ consumableFlags.size() + consumableValues.size() + consumableVectors.size());
+
+		for (auto& requiredFlag : requiredFlags)
+		{
+			program.push_back({ConditionOpCode::Flag, static_cast<int>(requiredFlag.id), ConditionOp::EqualTo, requiredFlag.flag ? 1.f : 0.f});
+		}
+
+		for (auto consumable : consumableFlags)
+		{
+			program.push_back({ConditionOpCode::ConsumableFlag, static_cast<int>(consumable)});
+		}
+
+		for (auto consumable : consumableValues)
+		{
+			program.push_back({ConditionOpCode::ConsumableValue, static_cast<int>(consumable)});
+		}
+
+		for (auto consumable : consumableVectors)
+		{
+			program.push_back({ConditionOpCode::ConsumableVector, static_cast<int>(consumable)});
+		}
+
+		for (auto& requiredValue : requiredValues)
+		{
+			program.push_back({ConditionOpCode::Value, static_cast<int>(requiredValue.id), requiredValue.op, requiredValue.value});
+		}
+
+		firstPredicateInstruction = program.size();
+
+		for (auto& satisfiable : satisfiedPredicates)
+		{
+			ConditionInstruction instruction {ConditionOpCode::Predicate, satisfiable.index};
+			instruction.identifier = satisfiable.identifier;
+			//predicates registered after this condition was compiled get looked up when they're run
+			instruction.predicate = findPredicate(satisfiable.identifier, satisfiablePredicates);
+			program.push_back(instruction);
+		}
+
+		compiled = true;
+	}
+
+	SatisfiablePredicateFunction Condition::getPredicate(int index) const
+	{
+		return compiled ? program[firstPredicateInstruction + index].predicate : nullptr;
+	}
+
+	bool Condition::isTrue(const WorldState& state, const TaskParameters& parameters, const std::vector<SatisfiablePredicate>& satisfiablePredicates, bool isMerged) const
+	{
+		if (!compiled)
+		{
+			return interpret(state, parameters, satisfiablePredicates, isMerged);
+		}
+
+		auto end = isMerged ? firstPredicateInstruction : static_cast<int>(program.size());
+
+		for (int i = 0; i < end; i++)
+		{
+			auto& instruction = program[i];
+
+			switch (instruction.code)
+			{
+				case ConditionOpCode::Flag
 					:
-				{					
-					if (it->second >= requiredValue.value)
+				{
+					auto it = state.current.flags.find(static_cast<WorldStateIdentifier>(instruction.slot));
+
+					if (it == std::end(state.current.flags) || it->second != (instruction.operand != 0.f))
 						return false;
 
 					break;
 				}
-				case ConditionOp::LessEqual
+				case ConditionOpCode::ConsumableFlag
 					:
-				{					
-					if (it->second > requiredValue.value)
+				{
+					auto it = state.facts.flags.find(static_cast<ConsumableFact>(instruction.slot));
+
+					if (it == std::end(state.facts.flags) || it->second.consumed)
 						return false;
 
 					break;
 				}
-				case ConditionOp::EqualTo
+				case ConditionOpCode::ConsumableValue
 					:
-				{					
-					if (it->second != requiredValue.value)
+				{
+					auto it = state.facts.values.find(static_cast<ConsumableFact>(instruction.slot));
+
+					if (it == std::end(state.facts.values) || it->second.consumed)
 						return false;
+
 					break;
 				}
-				case ConditionOp::NotEqualTo
+				case ConditionOpCode::ConsumableVector
 					:
 				{
-					if (it->second == requiredValue.value)
+					auto it = state.facts.vectors.find(static_cast<ConsumableFact>(instruction.slot));
+
+					if (it == std::end(state.facts.vectors) || it->second.consumed)
 						return false;
+
 					break;
 				}
-				case ConditionOp::GreaterThan
+				case ConditionOpCode::Value
 					:
-				{					
-					if (it->second <= requiredValue.value)
+				{
+					auto it = state.current.values.find(static_cast<WorldStateIdentifier>(instruction.slot));
+
+					if (it == std::end(state.current.values) || !compare(it->second, instruction.op, instruction.operand))
 						return false;
 
 					break;
 				}
-				case ConditionOp::GreaterEqual
+				case ConditionOpCode::Predicate
 					:
-				{					
-					if (it->second < requiredValue.value)
+				{
+					auto predicate = instruction.predicate != nullptr 
+						? instruction.predicate 
+						: findPredicate(instruction.identifier, satisfiablePredicates);
+
+					if (predicate == nullptr || !predicate(state, parameters, instruction.slot))
 						return false;
 
 					break;
-				}				
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool Condition::interpret(const WorldState& state, const TaskParameters& parameters, const std::vector<SatisfiablePredicate>& satisfiablePredicates, bool isMerged) const
+	{
+		for (auto& requiredFlag : requiredFlags)
+		{
+			auto it = state.current.flags.find(requiredFlag.id);
+
+			if (it == end(state.current.flags))
+			{
+				log("[Condition] ", "ERROR: flag missing");
 			}
+
+			if (it->second != requiredFlag.flag)
+				return false;
+		}
+
+		for (auto& requiredValue : requiredValues)
+		{
+			auto it = state.current.values.find(requiredValue.id);
+
+			if (it == end(state.current.values))
+			{
+				log("[Condition] ", "ERROR: flag missing");
+			}
+
+			if (!compare(it->second, requiredValue.op, requiredValue.value))
+				return false;
 		}		
 
 		if (!isMerged)
@@ -111,7 +622,7 @@ namespace AI
 				const auto& pred = std::find_if(begin(satisfiablePredicates), end(satisfiablePredicates), 
 					[satisfiable](const auto& sp) {return sp.identifier == satisfiable.identifier;});
 				
-				if (!pred->func(state, task, satisfiable.index))
+				if (!pred->func(state, parameters, satisfiable.index))
 				{
 					return false;
 				}
@@ -151,17 +662,25 @@ namespace AI
 		return true;
 	}
 
-	bool FMergedCondition::isTrue(const WorldState& state, const Task& task, const std::vector<SatisfiablePredicate>& satisfiablePredicates)
+	void MergedPredicateArena::reset()
+	{
+		predicates.clear();
+	}
+
+	bool FMergedCondition::isTrue(const WorldState& state, const MergedPredicateArena& arena, const std::vector<Task>& taskInstances, 
+		const std::vector<SatisfiablePredicate>& satisfiablePredicates) const
 	{
-		if (!condition.isTrue(state, task, satisfiablePredicates, true))
+		if (!condition.isTrue(state))
 			return false;
 
-		for (auto satisfiedPredicate : satisfiedPredicates)
+		for (int i = 0; i < predicateCount; i++)
 		{
-			const auto& pred = std::find_if(begin(satisfiablePredicates), end(satisfiablePredicates), 
-				[satisfiedPredicate](const auto& sp) {return sp.identifier == satisfiedPredicate.identifier;});
+			auto& satisfiedPredicate = arena.predicates[firstPredicate + i];
+			auto predicate = satisfiedPredicate.func != nullptr
+				? satisfiedPredicate.func
+				: findPredicate(satisfiedPredicate.identifier, satisfiablePredicates);
 			
-			if (!pred->func(state, tasks[satisfiedPredicate.taskIndex], satisfiedPredicate.index))
+			if (predicate == nullptr || !predicate(state, taskInstances[satisfiedPredicate.vertex].parameters, satisfiedPredicate.index))
 			{
 				return false;
 			}
@@ -170,7 +689,7 @@ namespace AI
 		return true;
 	}
 
-	bool Condition::isEmpty()
+	bool Condition::isEmpty() const
 	{
 		return requiredFlags.size() == 0 
 			&& requiredValues.size() == 0
@@ -26,6 +26,8 @@ SOFTWARE.
 
 #include <vector>
 #include <functional>
+#include <cstdint>
+#include <limits>
 #include "WorldState.h"
 
 namespace AI
@@ -45,6 +47,8 @@ namespace AI
 		ReactionFinished
 	};
 
+	const int SatisfiablePredicateCount = static_cast<int>(SatisfiablePredicateIdentifier::ReactionFinished) + 1;
+
 	enum class ConditionOp
 	{
 		LessThan,
@@ -74,6 +78,33 @@ namespace AI
 		float value;
 	};
 
+	//evaluates lhs op rhs
+	bool compare(float lhs, ConditionOp op, float rhs);
+
+	/*
+	The values a RequiredValue allows. NotEqualTo can't be expressed as a single range,
+	so PackedCondition stores those separately
+	*/
+	struct ValueRange
+	{
+		float min {-std::numeric_limits<float>::infinity()};
+		float max {std::numeric_limits<float>::infinity()};
+		bool minInclusive {true};
+		bool maxInclusive {true};
+
+		bool contains(float x) const;
+		bool isEmpty() const;
+		bool overlaps(const ValueRange& other) const;
+	};
+
+	bool operator==(const ValueRange& lhs, const ValueRange& rhs);
+
+	//the range of values satisfying "x op value", every value for NotEqualTo
+	ValueRange toValueRange(ConditionOp op, float value);
+	ValueRange intersect(const ValueRange& lhs, const ValueRange& rhs);
+
+	int countBits(std::uint32_t bits);
+
 	struct SatisfiablePredicateParams
 	{
 		SatisfiablePredicateIdentifier identifier;
@@ -81,25 +112,147 @@ namespace AI
 		int index;	//index into task.parameters.vectors, if necessary the Z value will be an index to the next vector to take params from
 	};
 
+    struct Task;
+    struct TaskParameters;
+
+	typedef bool (*SatisfiablePredicateFunction)(const WorldState& state, const TaskParameters& parameters, int parameterIndex);
+
 	struct MergedSatisfiablePredicateParams
 	{
 		SatisfiablePredicateIdentifier identifier;
 
 		int index;	//index into task.parameters.vectors, if necessary the Z value will be an index to the next vector to take params from
-		int taskIndex; //index into an array of task.parameters
+		int vertex; //TaskDatabase vertex id of the task whose parameters are used
+		//the predicate's function if the task's condition was compiled, otherwise it's looked up by identifier
+		SatisfiablePredicateFunction func {nullptr};
 	};
 
-    struct Task;
+	//how many NotEqualTo values a PackedCondition keeps per identifier
+	const int MaxExcludedValues {4};
+
+	/*
+	A Condition squashed into bitmasks over the WorldStateIdentifier, ConsumableFact and
+	SatisfiablePredicateIdentifier enums plus a table of ranges for the required values.
+	The planner merges conditions for every edge it expands, this turns that into a few
+	bitwise ops instead of searching and copying vectors.
+	*/
+	struct PackedCondition
+	{
+		//bit n is set if flag/value/fact n is required
+		std::uint32_t flagMask {0};
+		//the required value of each flag in flagMask
+		std::uint32_t flagValues {0};
+		std::uint32_t valueMask {0};
+		//values with a NotEqualTo requirement, see excluded
+		std::uint32_t excludedMask {0};
+		std::uint32_t consumableFlags {0};
+		std::uint32_t consumableValues {0};
+		std::uint32_t consumableVectors {0};
+		std::uint32_t predicates {0};
+
+		//set when two requirements can never both be true
+		bool contradictory {false};
+
+		ValueRange ranges[WorldStateIdentifierCount];
+		//the first excludedCounts[n] values of excluded[n] are what value n can't be
+		float excluded[WorldStateIdentifierCount][MaxExcludedValues] {};
+		std::uint8_t excludedCounts[WorldStateIdentifierCount] {};
+
+		bool excludes(int n, float value) const;
+		/*
+		Adds a NotEqualTo requirement on value n. A condition that would need more than
+		MaxExcludedValues is marked contradictory, which can only lose plans, never allow a wrong one
+		*/
+		void exclude(int n, float value);
+		//drops the exclusions ranges[n] already rules out, contradictory if they rule out all it allows
+		void intersectExclusions(int n);
+		void clearExclusions(int n);
+
+		//how many requirements there are, not counting predicates
+		int count() const;
+
+		//checks everything except predicates, since those need a task's parameters
+		bool isTrue(const WorldState& state) const;
+		//only checks the requirements on flags and values whose bits are set in the given masks
+		bool holdsFor(const WorldState& state, std::uint32_t flags, std::uint32_t values) const;
+
+		//see RequirementCount
+		std::uint64_t requirementMask() const;
+		//the requirements from requirementMask that are true in state
+		std::uint64_t satisfiedRequirements(const WorldState& state) const;
+	};
+
+	/*
+	Every kind of requirement a PackedCondition can hold, numbered so all of a condition's
+	requirements fit in one mask: flag n == false, flag n == true, a requirement on value n,
+	then the three kinds of consumable facts. Predicates aren't included since whether
+	they're true depends on a task's parameters
+	*/
+	const int FlagRequirementsStart = 0;
+	const int ValueRequirementsStart = FlagRequirementsStart + 2 * WorldStateIdentifierCount;
+	const int ConsumableFlagRequirementsStart = ValueRequirementsStart + WorldStateIdentifierCount;
+	const int ConsumableValueRequirementsStart = ConsumableFlagRequirementsStart + ConsumableFactCount;
+	const int ConsumableVectorRequirementsStart = ConsumableValueRequirementsStart + ConsumableFactCount;
+	const int RequirementCount = ConsumableVectorRequirementsStart + ConsumableFactCount;
+
+	static_assert(WorldStateIdentifierCount <= 32, "PackedCondition stores WorldStateIdentifiers in 32 bits");
+	static_assert(ConsumableFactCount <= 32, "PackedCondition stores ConsumableFacts in 32 bits");
+	static_assert(SatisfiablePredicateCount <= 32, "PackedCondition stores predicates in 32 bits");
+	static_assert(RequirementCount <= 64, "requirement masks are 64 bits");
+
+	//calls f(n) for every set bit n
+	template<typename Bits, typename Func>
+	void forEachBit(Bits bits, Func f)
+	{
+		for (int n = 0; bits != 0; n++, bits >>= 1)
+		{
+			if (bits & 1)
+			{
+				f(n);
+			}
+		}
+	}
 
     /*
     A predicate function that can examine the complete WorldState (as a particular AI character sees it)
-    along with all the parameters in the task this predicate's condition belongs to. Much more flexible
+    along with all the parameters of the task this predicate's condition belongs to. Much more flexible
     than the other Condition expressions as you can define exactly how its evaluated.
     */
 	struct SatisfiablePredicate
 	{
 		SatisfiablePredicateIdentifier identifier;
-		std::function<bool(const WorldState&, const Task&, int parameterIndex)> func;
+		SatisfiablePredicateFunction func;
+	};
+
+	//returns the function registered for identifier, nullptr if there isn't one
+	SatisfiablePredicateFunction findPredicate(SatisfiablePredicateIdentifier identifier, 
+		const std::vector<SatisfiablePredicate>& satisfiablePredicates);
+
+	enum class ConditionOpCode : std::uint8_t
+	{
+		Flag,
+		ConsumableFlag,
+		ConsumableValue,
+		ConsumableVector,
+		Value,
+		Predicate
+	};
+
+	/*
+	One check out of a compiled Condition. slot is the WorldStateIdentifier or ConsumableFact
+	being checked, or for predicates the parameter index
+	*/
+	struct ConditionInstruction
+	{
+		ConditionOpCode code;
+		int slot;
+		//Flag compares against operand != 0, Value does values[slot] op operand
+		ConditionOp op {ConditionOp::EqualTo};
+		float operand {0.f};
+
+		//only used by Predicate
+		SatisfiablePredicateIdentifier identifier {SatisfiablePredicateIdentifier::NearPlayer};
+		SatisfiablePredicateFunction predicate {nullptr};
 	};
 
     /*
@@ -120,8 +273,29 @@ namespace AI
 		std::vector<ConsumableFact> consumableValues;
 		std::vector<ConsumableFact> consumableVectors;
 
-		bool isTrue(const WorldState& state, const Task& task, const std::vector<SatisfiablePredicate>& satisfiablePredicates, bool isMerged = false);					
-		bool isEmpty();
+		//filled in by pack(), which TaskDatabase::addTask calls for every task it's given
+		PackedCondition packed;
+
+		/*
+		filled in by compile(), which TaskDatabase::addTask also calls. Every requirement above as one
+		instruction, cheapest kinds first and predicates last so they only run when everything else is true
+		*/
+		std::vector<ConditionInstruction> program;
+		//where the predicates start in program
+		int firstPredicateInstruction {0};
+		bool compiled {false};
+
+		void pack();
+		void compile(const std::vector<SatisfiablePredicate>& satisfiablePredicates);
+
+		//the function for satisfiedPredicates[index] found by compile, nullptr if it wasn't compiled
+		SatisfiablePredicateFunction getPredicate(int index) const;
+
+		//runs program, or interpret() if this condition was never compiled
+		bool isTrue(const WorldState& state, const TaskParameters& parameters, const std::vector<SatisfiablePredicate>& satisfiablePredicates, bool isMerged = false) const;					
+		//evaluates the requirement vectors directly
+		bool interpret(const WorldState& state, const TaskParameters& parameters, const std::vector<SatisfiablePredicate>& satisfiablePredicates, bool isMerged = false) const;
+		bool isEmpty() const;
 	};
 
 }
\ No newline at end of file
@@ -24,6 +24,7 @@ SOFTWARE.
 
 #pragma once
 
+#include <limits>
 #include "WorldState.h"
 #include "Tasks.h"
 
@@ -218,12 +219,75 @@ namespace AI
 	{
 	};
 
+	/*
+	A FunctionDefinition (stretches and offsets included) sampled at evenly spaced inputs over
+	[min, max], linearly interpolated in between. Empty unless the curve was baked, see
+	bakeResponseCurve
+	*/
+	struct CurveTable
+	{
+		float min {0.f};
+		float max {1.f};
+		//samples per unit of input
+		float scale {0.f};
+		//what the samples were checked to be within
+		float maxError {0.f};
+		std::vector<float> samples;
+	};
+
+	//the least and most something can score, unbounded unless something narrower is known
+	struct ScoreBounds
+	{
+		float min {-std::numeric_limits<float>::infinity()};
+		float max {std::numeric_limits<float>::infinity()};
+	};
+
+	//bits for the inputs WorldState's subscriptions don't tell anyone about, see ConsiderationInputs
+	enum class InputSource : std::uint32_t
+	{
+		TaskHistory = 1u << 0,
+		ValueTrackers = 1u << 1,
+		FocusLoci = 1u << 2,
+		//predicates can read anything, so they're scored every time
+		Always = 1u << 3
+	};
+
+	inline std::uint32_t operator|(std::uint32_t sources, InputSource source)
+	{
+		return sources | static_cast<std::uint32_t>(source);
+	}
+
+	/*
+	Everything a consideration's input is read from: the WorldState slots (see StateMask) and
+	the InputSource bits for the rest. A cached score only needs recomputing once one of them changes
+	*/
+	struct ConsiderationInputs
+	{
+		StateMask slots;
+		std::uint32_t sources {0};
+
+		bool changedIn(const StateMask& changedSlots, std::uint32_t changedSources) const
+		{
+			return (sources & (changedSources | InputSource::Always)) != 0
+				|| (slots & changedSlots).any();
+		}
+	};
+
+	inline ConsiderationInputs operator|(const ConsiderationInputs& lhs, const ConsiderationInputs& rhs)
+	{
+		return {lhs.slots | rhs.slots, lhs.sources | rhs.sources};
+	}
+
 	struct Consideration
 	{
 		ConsiderationType type;
 		FunctionDefinition function;
 		bool useSubsetMax {false};
 		int group {0}; //group 0 is base score, then multiplied by the max of the remaining groups
+		CurveTable bakedFunction;
+		ConsiderationInputs inputs;
+		//what the response can be for any input gatherConsiderationInput could give it, see considerationBounds
+		ScoreBounds bounds;
 
 		union 
 		{
@@ -0,0 +1,178 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace AI
+{
+	/*
+	A map from a small dense enum to Value, stored as a fixed array with a bit per key
+	saying whether that key has been set. It has the parts of std::map's interface WorldState
+	uses: find/end, operator[] (which marks the key present), at, erase and iterating the present
+	entries in key order. Keys that aren't present always hold a value initialized Value, so
+	at() on a missing key reads that instead of inserting or throwing.
+	*/
+	template<typename Key, typename Value, int Count>
+	struct EnumMap
+	{
+		static_assert(Count <= 32, "EnumMap keeps its presence bits in 32 bits");
+
+		//a plain struct instead of std::pair so EnumMaps of trivially copyable values are trivially copyable too
+		struct Entry
+		{
+			Key first;
+			Value second;
+		};
+
+		typedef Entry value_type;
+
+		template<typename Entry>
+		struct Iterator
+		{
+			Entry* entries;
+			std::uint32_t present;
+			int index;
+
+			Entry& operator*() const { return entries[index]; }
+			Entry* operator->() const { return &entries[index]; }
+
+			Iterator& operator++()
+			{
+				index++;
+				skipAbsent();
+				return *this;
+			}
+
+			void skipAbsent()
+			{
+				while (index < Count && !(present & (1u << index)))
+				{
+					index++;
+				}
+			}
+
+			bool operator==(const Iterator& other) const { return index == other.index; }
+			bool operator!=(const Iterator& other) const { return index != other.index; }
+		};
+
+		typedef Iterator<value_type> iterator;
+		typedef Iterator<const value_type> const_iterator;
+
+		EnumMap()
+		{
+			for (int i = 0; i < Count; i++)
+			{
+				entries[i].first = static_cast<Key>(i);
+			}
+		}
+
+		Value& operator[](Key key)
+		{
+			present |= bit(key);
+			return entries[static_cast<int>(key)].second;
+		}
+
+		Value& at(Key key) { return entries[static_cast<int>(key)].second; }
+		const Value& at(Key key) const { return entries[static_cast<int>(key)].second; }
+
+		iterator find(Key key) { return contains(key) ? iterator{entries, present, static_cast<int>(key)} : end(); }
+		const_iterator find(Key key) const { return contains(key) ? const_iterator{entries, present, static_cast<int>(key)} : end(); }
+
+		bool contains(Key key) const { return (present & bit(key)) != 0; }
+		int count(Key key) const { return contains(key) ? 1 : 0; }
+
+		void erase(Key key)
+		{
+			present &= ~bit(key);
+			entries[static_cast<int>(key)].second = Value{};
+		}
+
+		void clear()
+		{
+			for (int i = 0; i < Count; i++)
+			{
+				entries[i].second = Value{};
+			}
+
+			present = 0;
+		}
+
+		int size() const
+		{
+			int total {0};
+
+			for (auto bits = present; bits != 0; bits &= bits - 1)
+			{
+				total++;
+			}
+
+			return total;
+		}
+
+		bool empty() const { return present == 0; }
+
+		//bit n is set if the key with value n is present
+		std::uint32_t presentMask() const { return present; }
+
+		iterator begin()
+		{
+			iterator it {entries, present, 0};
+			it.skipAbsent();
+			return it;
+		}
+
+		iterator end() { return {entries, present, Count}; }
+
+		const_iterator begin() const
+		{
+			const_iterator it {entries, present, 0};
+			it.skipAbsent();
+			return it;
+		}
+
+		const_iterator end() const { return {entries, present, Count}; }
+
+	private:
+
+		static std::uint32_t bit(Key key) { return 1u << static_cast<int>(key); }
+
+		value_type entries[Count] {};
+		std::uint32_t present {0};
+	};
+
+	//so unqualified begin/end calls find EnumMap's the same way ADL finds std::begin/end for std::map
+	template<typename Key, typename Value, int Count>
+	auto begin(EnumMap<Key, Value, Count>& map) { return map.begin(); }
+
+	template<typename Key, typename Value, int Count>
+	auto end(EnumMap<Key, Value, Count>& map) { return map.end(); }
+
+	template<typename Key, typename Value, int Count>
+	auto begin(const EnumMap<Key, Value, Count>& map) { return map.begin(); }
+
+	template<typename Key, typename Value, int Count>
+	auto end(const EnumMap<Key, Value, Count>& map) { return map.end(); }
+}
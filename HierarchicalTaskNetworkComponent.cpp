@@ -23,9 +23,13 @@ SOFTWARE.
 */
 
 #include "HierarchicalTaskNetworkComponent.h"
+#include "PlanWorkers.h"
 #include "Math.h"
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 #include "SoundMap.h"
+#include "Recording.h"
 #include "log.h"
 
 using namespace AI;
@@ -42,8 +46,8 @@ HierarchicalTaskNetworkComponent::HierarchicalTaskNetworkComponent(Actor* owner)
 	detailAngle = 20.f;
 	motionAngle = detailAngle * 2.f;
 
-	state.current.vectors[WorldStateIdentifier::CurrentPosition] = {};
-	state.current.vectors[WorldStateIdentifier::PlayerPosition] = {1000, 1000, 1000};
+	state.setVector(WorldStateIdentifier::CurrentPosition, {});
+	state.setVector(WorldStateIdentifier::PlayerPosition, {1000, 1000, 1000});
 
 	planPath.resize(5);
 }
@@ -71,27 +75,26 @@ void HierarchicalTaskNetworkComponent::initializeComponent()
 		}
 	}
 
-	state.current.values[WorldStateIdentifier::Stance] = static_cast<float>(Stance::Standing);
+	state.setValue(WorldStateIdentifier::Stance, static_cast<float>(Stance::Standing));
 	
-	state.valueTrackers.emplace(WorldStateIdentifier::Alertness, ValueOverTimeTracker{});
-	state.valueTrackers[WorldStateIdentifier::Alertness].durationExceedsExtension =
-		[](auto& tracker) {return tracker.durationBelowValue > (tracker.maxValue / 8.f);};
+	//the value trackers and emotional decay are updated in the table, fixedTick copies them in
+	auto& agentStates = gameMode->getAgentStates();
+	agentHandle = agentStates.addAgent();
+	agentStates.store(agentHandle, state.current);
 
-	state.valueTrackers.emplace(WorldStateIdentifier::Curiosity, ValueOverTimeTracker{});
-	state.valueTrackers[WorldStateIdentifier::Curiosity].durationExceedsExtension =
-		[](auto& tracker) {return tracker.durationBelowValue > (tracker.maxValue / 8.f);};
-
-	state.valueTrackers.emplace(WorldStateIdentifier::PlayerIdentified, ValueOverTimeTracker{});
+	//considerations pick out the slots they read, see ConsiderationInputs
+	scoringSubscription = state.subscribe({~0u, ~0u, ~0u, ~0u, ~0u, ~0u});
 
 	state.barker = barker;
+	eng.seed(gameMode->makeSeed());
 }
 
 void HierarchicalTaskNetworkComponent::joinConversation()
 {
-	executeFinally(planner.plan, state);
 	auto& tasks = static_cast<GameMode*>(getWorld()->getAuthGameMode())->getAvailableTasks();
 
 	currentGoal = TaskIdentifier::JoinConversation;
+	timeOnGoal = 0.f;
 
 #ifdef SHOW_PLANNER_INFORMATION_MESSAGES
 	log("[", owner->getName(), "] ", "New goal: ", tasks.tasks[currentGoal].debugName);
@@ -108,11 +111,13 @@ void HierarchicalTaskNetworkComponent::updateHUD_PlanPath()
 {
 	auto& tasks = getWorld()->getAuthGameMode()->getAvailableTasks();
 
+	auto& path = planner.plan.getPlanPath();
+
 	for (std::size_t i = 0; i < 5u; i++)
 	{
-		if (i < planner.plan.planPath.size())
+		if (i < path.size())
 		{
-			planPath[i] = tasks.tasks[planner.plan.planPath[i]].debugName.c_str(); 
+			planPath[i] = tasks.tasks[path[i]].debugName.c_str(); 
 		}
 		else
 		{
@@ -120,26 +125,42 @@ void HierarchicalTaskNetworkComponent::updateHUD_PlanPath()
 		}
 	}
 
-	planProgress = (1 + planner.plan.currentPathVertex - begin(planner.plan.planPath)) / 5.f;
+	planProgress = (1 + planner.plan.currentPathVertex) / 5.f;
 }
 
 void HierarchicalTaskNetworkComponent::fixedTick(float dt)
 {
-	auto playerIdentified = state.current.flags[WorldStateIdentifier::PlayerIdentified];
+	auto& agentStates = getWorld()->getAuthGameMode()->getAgentStates();
+	agentStates.load(agentHandle, state);
+
+	if (agentStates.loadTrackers(agentHandle, state.valueTrackers))
+	{
+		changedInputSources = changedInputSources | InputSource::ValueTrackers;
+	}
+
+	if (agentStates.takeLostLead(agentHandle))
+	{
+		state.produceFactFlag(ConsumableFact::LostLead, true);
+	}
+
+	if (isPlanning())
+	{
+		continuePlanning();
+	}
+
+	auto playerIdentified = state.current.flags.at(WorldStateIdentifier::PlayerIdentified);
 
 	sense();
 	perceive();
 	purgeMemoryOfIgnoredActors();
 	produceFacts();
 
-	tickEmotionalState(dt);
-
 	Math::Vector3 eyePosition;
 	//FRotator rotation;
 	//AIOwner->GetCharacter()->GetActorEyesViewPoint(eyePosition, rotation);	
-	state.current.vectors[WorldStateIdentifier::CurrentPosition] = owner->GetActorLocation(); //eyePosition;
+	state.setVector(WorldStateIdentifier::CurrentPosition, owner->GetActorLocation()); //eyePosition;
 
-	state.current.vectors[WorldStateIdentifier::CurrentPosition_Feet] = owner->GetActorLocation();
+	state.setVector(WorldStateIdentifier::CurrentPosition_Feet, owner->GetActorLocation());
 	//state.current.vectors[WorldStateIdentifier::CurrentPosition_Feet].z -= Cast<AAICharacter>(AIOwner->GetPawn())->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
 
 	auto player = GameplayStatics::GetPlayerCharacter(getWorld(), 0);
@@ -147,61 +168,49 @@ void HierarchicalTaskNetworkComponent::fixedTick(float dt)
 	{
 		//player->GetActorEyesViewPoint(eyePosition, rotation);
 
-		if (state.current.flags[WorldStateIdentifier::PlayerIdentified])
+		if (state.current.flags.at(WorldStateIdentifier::PlayerIdentified))
 		{
-			state.current.vectors[WorldStateIdentifier::PlayerPosition] = eyePosition;
+			state.setVector(WorldStateIdentifier::PlayerPosition, eyePosition);
 			state.produceFactVector(ConsumableFact::Player_LastKnownLocation, eyePosition);	
 		}
 	}	
 
+	syncSquadFacts();
 	decide();
 	performTask(dt);
 
 	auto gameMode = getWorld()->getAuthGameMode();
 	auto& tasks = gameMode->getAvailableTasks();
 	
-	evaluatePlan(planner.plan, state, worldQuerySystem, planner.parameters, tasks.satisfiablePredicates);		
+	if (!planner.plan.empty() && !planner.plan.finished)
+	{
+		evaluatePlan(planner.plan, state, worldQuerySystem, planner.parameters, tasks.satisfiablePredicates);		
+	}
 
-	if (isBeingDebugViewed)
+	if (isBeingDebugViewed && !planner.plan.empty())
 	{
 		updateHUD_PlanPath();	
 	}	
 
-	state.valueTrackers[WorldStateIdentifier::PlayerIdentified].update(state.current.flags[WorldStateIdentifier::PlayerIdentified], dt);
-	if (!playerIdentified && state.current.flags[WorldStateIdentifier::PlayerIdentified])
+	if (!playerIdentified && state.current.flags.at(WorldStateIdentifier::PlayerIdentified))
 	{
 		state.produceFactFlag(ConsumableFact::PlayerRecentlyIdentified, true);
 	}
 
 	barker.update(dt);
+	timeOnGoal += dt;
+	agentStates.store(agentHandle, state.current);
 }
 
-void HierarchicalTaskNetworkComponent::tickEmotionalState(float dt)
+void HierarchicalTaskNetworkComponent::sense()
 {
-	auto& alertness = state.current.values[WorldStateIdentifier::Alertness];
-	alertness = clamp(alertness - 0.09f, 0.f, 100.f);
-
-	auto& boredom = state.current.values[WorldStateIdentifier::Boredom];
-	boredom = clamp(boredom + 0.01f, 0.f, 100.f);
+	state.memory.sensoryMemory.clear();
 
-	auto& alertnessTracker = state.valueTrackers[WorldStateIdentifier::Alertness];
-	auto& curiosityTracker = state.valueTrackers[WorldStateIdentifier::Curiosity];
-	
-	alertnessTracker.update(alertness, dt);
-	curiosityTracker.update(state.current.values[WorldStateIdentifier::Curiosity], dt);
-	
-	if (alertnessTracker.durationExceedsExtension(alertnessTracker)
-		&& curiosityTracker.durationExceedsExtension(curiosityTracker))
+	//every locus ages, and may be pruned or replaced below
+	if (!state.memory.focusLocus.empty())
 	{
-		state.produceFactFlag(ConsumableFact::LostLead, true);
+		changedInputSources = changedInputSources | InputSource::FocusLoci;
 	}
-	
-	return;
-}
-
-void HierarchicalTaskNetworkComponent::sense()
-{
-	state.memory.sensoryMemory.clear();
 
 	incrementEngramAges(state.memory);
 	pruneOldEngrams(state.memory);
@@ -324,7 +333,7 @@ void HierarchicalTaskNetworkComponent::senseAuditory()
 {
 	auto& soundMap = getWorld()->getAuthGameMode()->getSoundMap();
 
-	auto location = state.current.vectors[WorldStateIdentifier::CurrentPosition];
+	auto location = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
 
 	auto range = 10.f;
 	auto sounds = soundMap.collectSounds({location.x, location.y}, range);
@@ -349,8 +358,8 @@ void HierarchicalTaskNetworkComponent::senseAuditory()
 
 		//auto& alertness = state.current.values[WorldStateIdentifier::Alertness];
 		//alertness = FMath::Clamp(alertness + stimulus.auditory.intensity / 100.f, 0.f, 60.f);
-		auto& curiosity = state.current.values[WorldStateIdentifier::Curiosity];
-		curiosity = clamp(curiosity + stimulus.intensity / 10.f, 0.f, 100.f);
+		auto curiosity = state.current.values.at(WorldStateIdentifier::Curiosity);
+		state.setValue(WorldStateIdentifier::Curiosity, clamp(curiosity + stimulus.intensity / 10.f, 0.f, 100.f));
 	}	
 }
 
@@ -371,7 +380,7 @@ void HierarchicalTaskNetworkComponent::perceiveVisual()
 			continue;
 
 		if (engram.stimulus.visual.tag == VisualTag::Person
-			&& state.current.flags[WorldStateIdentifier::PlayerIdentified])		
+			&& state.current.flags.at(WorldStateIdentifier::PlayerIdentified))		
 			continue;
 
 		if (std::find(begin(state.actorsToIgnore), end(state.actorsToIgnore), engram.stimulus.visual.target)
@@ -621,7 +630,7 @@ void HierarchicalTaskNetworkComponent::produceFacts()
 		return;
 	}
 
-	auto& factValue = state.facts.values[fact];
+	auto& factValue = state.facts.values.at(fact);
 
 	if (factValue.consumed)
 	{
@@ -645,13 +654,13 @@ void HierarchicalTaskNetworkComponent::produceFacts()
 			if (importanceRatio > 1.5f)
 			{
 				//50% higher importance -> switch to that once
-				factValue.value = state.memory.focusLocus[locusId].id;
+				state.produceFactValue(fact, state.memory.focusLocus[locusId].id);
 			}
 		}
 		else
 		{
 			//its been deleted
-			factValue.value = state.memory.focusLocus[locusId].id;
+			state.produceFactValue(fact, state.memory.focusLocus[locusId].id);
 		}		
 	}	
 }
@@ -733,277 +742,642 @@ int countDistanceSince(std::deque<TaskIdentifier>& history, TaskIdentifier task)
 	return 10;
 }
 
-float evaluateLogistic(float x, FunctionDefinition f)
+float HierarchicalTaskNetworkComponent::gatherConsiderationInput(const Consideration& consideration)
 {
-	return f.logistic.L / (1 + exp(-f.logistic.k * (x - f.logistic.x0)));
+	float x = 0.f;
+
+	switch(consideration.type)
+	{
+		case ConsiderationType::Repeat
+			:
+		{
+			x = countDistanceSince(taskHistory, consideration.repeat.identifier) / 10.f;
+			break;
+		}
+		case ConsiderationType::Scalar
+			:
+		{
+			x = state.current.values.at(consideration.scalar.identifier);
+			x /= 100.f;
+			break;
+		}
+		case ConsiderationType::Flag
+			:
+		{
+			x = state.current.flags.at(consideration.flag.identifier);					
+			x = consideration.flag.negate ? !x : x;
+			break;
+		}
+		case ConsiderationType::Distance
+			:
+		{
+			auto from = state.current.vectors.at(consideration.distance.from);
+			auto to = state.current.vectors.at(consideration.distance.to);
+
+			x = distanceSquared(from, to);
+			x /= 1000000.f;
+			break;
+		}
+		case ConsiderationType::ConsumableFlag
+			:
+		{
+			x = !state.facts.flags.at(consideration.consumableFlag.fact).consumed;
+			break;
+		}
+		case ConsiderationType::ConsumableValue
+			:
+		{
+			x = !state.facts.values.at(consideration.consumableValue.fact).consumed;
+			break;
+		}
+		case ConsiderationType::ConsumableVector
+			:
+		{
+			x = !state.facts.vectors.at(consideration.consumableVector.fact).consumed;
+			break;
+		}
+		case ConsiderationType::AuditoryStimulus
+			:
+		{
+			/*for (auto& engram : state.memory.shortTermMemory)
+			{
+				if (engram.type == EngramType::Heard)
+				{
+					x = 1.f;
+					break;
+				}
+			}*/
+
+			/*for (auto& locus : state.memory.focusLocus)
+			{
+				if (!consumedLoci[locus.id])
+				{
+
+				}
+			}*/
+
+			break;
+		}
+		case ConsiderationType::Predicate
+			:
+		{
+			x = consideration.predicateFunction(state);
+			break;
+		}
+		case ConsiderationType::ValueOverTimeTracker
+			:
+		{
+			auto& tracker = state.valueTrackers[consideration.valueTracker.identifier];
+			x = trackerInput(tracker, consideration.valueTracker.trackerProperty);
+			break;
+		}
+		case ConsiderationType::LocusImportance
+			:
+		{
+			auto& fact = state.facts.values.at(consideration.locusImportance.factContainingLocusId);
+
+			if (!fact.consumed)
+			{
+				//TODO: should divide by 100 for now, have a general scale thing to 0-1 for future						
+				auto locus = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
+					[id=roundToInt(fact.value)](auto& l){return l.id == id;});
+
+				if (locus != end(state.memory.focusLocus))
+				{
+					x = locus->currentImportance;
+				}
+			}
+
+			break;
+		}
+		case ConsiderationType::LocusAge
+			:
+		{
+			auto& fact = state.facts.values.at(consideration.locusAge.factContainingLocusId);
+
+			if (!fact.consumed)
+			{
+				//TODO: should divide by 100 for now, have a general scale thing to 0-1 for future
+				auto locus = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
+					[id=roundToInt(fact.value)](auto& l){return l.id == id;});
+
+				if (locus != end(state.memory.focusLocus))
+				{
+					x = static_cast<float>(locus->engrams.back().age) / MaxEngramAge;
+				}
+			}
+
+			break;
+		}
+	}
+
+	return x;
 }
 
-float evaluateQuadratic(float x, FunctionDefinition f)
+bool byScoreDescending(const Utility& l, const Utility& r)
 {
-	return f.quadratic.a * x * x + f.quadratic.b * x + f.quadratic.c;
+	return l.score > r.score;
 }
 
-float evaluateExponential(float x, FunctionDefinition f)
+TaskIdentifier HierarchicalTaskNetworkComponent::evaluateNeeds()
 {
-	return pow(f.exponential.a, x);
+	TaskIdentifier goal = TaskIdentifier::Null;
+	
+	auto& tasks = getWorld()->getAuthGameMode()->getAvailableTasks();
+	utilities.clear();
+	prunedTasks.clear();
+
+	auto changedSlots = state.takeChanges(scoringSubscription);
+	auto changedSources = changedInputSources;
+	changedInputSources = 0;
+	//a database that never had findConsiderationInputs called can't tell what changed
+	auto scoreEverything = scoredRevision != tasks.revision
+		|| tasks.considerationInputs.size() != tasks.considerations.size();
+
+	if (scoredRevision != tasks.revision)
+	{
+		scoredTasks.clear();
+		responseOffsets.clear();
+		std::size_t considerationCount {0};
+
+		for (auto& taskConsideration : tasks.considerations)
+		{
+			scoredTasks.push_back(&taskConsideration);
+			responseOffsets.push_back(considerationCount);
+			considerationCount += taskConsideration.second.size();
+		}
+
+		considerationResponses.resize(considerationCount);
+		staleResponses.resize(considerationCount);
+		taskScores.assign(scoredTasks.size(), 0.f);
+		scoringOrder.resize(scoredTasks.size());
+		std::iota(begin(scoringOrder), end(scoringOrder), 0);
+		scoredRevision = tasks.revision;
+	}
+
+	for (std::size_t task = 0; task < scoredTasks.size(); task++)
+	{
+		auto& considerations = scoredTasks[task]->second;
+
+		if (!scoreEverything && !tasks.considerationInputs.at(scoredTasks[task]->first).changedIn(changedSlots, changedSources))
+			continue;
+
+		for (std::size_t i = 0; i < considerations.size(); i++)
+		{
+			auto& stale = staleResponses[responseOffsets[task] + i];
+			stale = stale || scoreEverything || considerations[i].inputs.changedIn(changedSlots, changedSources);
+		}
+	}
+
+	//this agent is a batch of one, scored the same way as a batch of many
+	utilityBatch.begin(1);
+
+	//the best scores so far, a task that can't beat the last of them can't be a goal or a fallback
+	float best[FallbackGoalCount];
+	int bestCount {0};
+
+	for (auto task : scoringOrder)
+	{
+		auto threshold = bestCount == FallbackGoalCount ? best[bestCount - 1] : -std::numeric_limits<float>::infinity();
+
+		if (!scoreTask(task, threshold))
+		{
+			prunedTasks.push_back(task);
+			continue;
+		}
+
+		auto score = taskScores[task];
+		utilities.push_back({scoredTasks[task]->first, score});
+
+		//kept best first, the last one drops off when something beats it
+		auto i = bestCount < FallbackGoalCount ? bestCount++ : FallbackGoalCount;
+
+		for (; i > 0 && best[i - 1] < score; i--)
+		{
+			if (i < FallbackGoalCount)
+				best[i] = best[i - 1];
+		}
+
+		if (i < FallbackGoalCount)
+			best[i] = score;
+	}
+
+	std::stable_sort(begin(utilities), end(utilities), byScoreDescending);
+	rankedUtilities = prunedTasks.empty() ? utilities.size() : std::min<std::size_t>(utilities.size(), FallbackGoalCount);
+
+	//pruned tasks keep their last score, it's still a fair guess at where they rank
+	std::stable_sort(begin(scoringOrder), end(scoringOrder), [&](std::size_t l, std::size_t r)
+	{
+		return taskScores[l] > taskScores[r];
+	});
+
+	if (!utilities.empty())
+	{
+		goal = utilities.front().task;
+	}
+
+	utilityIterator = begin(utilities);
+
+	return goal;
 }
 
-float evaluateGaussian(float x, FunctionDefinition f)
+bool HierarchicalTaskNetworkComponent::scoreTask(std::size_t task, float threshold)
 {
-	auto b = x - f.gaussian.b;
-	auto c = 2 * f.gaussian.c;
-	return f.gaussian.a * exp(-(b * b) / (c * c));
+	auto& considerations = scoredTasks[task]->second;
+	auto responses = considerationResponses.data() + responseOffsets[task];
+	auto stale = staleResponses.data() + responseOffsets[task];
+	auto count = considerations.size();
+
+	if (std::find(stale, stale + count, true) == stale + count)
+	{
+		//nothing it reads changed since it was last scored
+		return true;
+	}
+
+	responseBounds.resize(count);
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		responseBounds[i] = stale[i] ? considerations[i].bounds : ScoreBounds{responses[i], responses[i]};
+	}
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if (!stale[i])
+			continue;
+
+		//the responses left stale are evaluated whenever the task is scored next
+		if (taskBounds(considerations, responseBounds.data()).max < threshold)
+			return false;
+
+		auto x = gatherConsiderationInput(considerations[i]);
+		utilityBatch.evaluate(considerations[i], &x, responses + i);
+		responseBounds[i] = {responses[i], responses[i]};
+		stale[i] = false;
+	}
+
+	utilityBatch.beginTask();
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		utilityBatch.scoreResponses(considerations[i], responses + i);
+	}
+
+	utilityBatch.finishTask(&taskScores[task]);
+
+	return true;
 }
 
-float evaluateStep(float x, FunctionDefinition f)
+float HierarchicalTaskNetworkComponent::scoreOf(TaskIdentifier goal)
 {
-	return x >= f.step.crossover;
+	auto utility = std::find_if(begin(utilities), end(utilities), [=](const Utility& u) {return u.task == goal;});
+
+	if (utility != end(utilities))
+		return utility->score;
+
+	auto pruned = std::find_if(begin(prunedTasks), end(prunedTasks), [&](std::size_t task) {return scoredTasks[task]->first == goal;});
+
+	if (pruned == end(prunedTasks))
+		return 0.f;
+
+	//finishing it doesn't change its rank, it stays pruned until a fallback needs it
+	scoreTask(*pruned, -std::numeric_limits<float>::infinity());
+
+	return taskScores[*pruned];
 }
 
-float evaluateLinear(float x, FunctionDefinition f)
+bool GoalCommitment::allowsSwitch(float timeOnGoal, float currentScore, float candidateScore) const
 {
-	return x;
+	if (timeOnGoal < minimumDuration)
+		return false;
+
+	auto held = inertiaHalfLife > 0.f ? inertia * std::exp2(-timeOnGoal / inertiaHalfLife) : 0.f;
+
+	//at least as good is enough without a margin, the best goal always replaces an equal one
+	return candidateScore >= currentScore + held + margin;
 }
 
-typedef float (*Evaluator)(float x, FunctionDefinition function);
+void HierarchicalTaskNetworkComponent::setGoalCommitment(const GoalCommitment& commitment)
+{
+	goalCommitment = commitment;
+}
 
-static Evaluator evaluators[] = 
+const GoalCommitmentStats& HierarchicalTaskNetworkComponent::getGoalCommitmentStats() const
 {
-	&evaluateLogistic,
-	&evaluateQuadratic,
-	&evaluateExponential,
-	&evaluateGaussian,
-	&evaluateStep,
-	&evaluateLinear
-};
+	return goalCommitmentStats;
+}
 
-TaskIdentifier HierarchicalTaskNetworkComponent::evaluateNeeds()
+const Utility* HierarchicalTaskNetworkComponent::nextFallbackGoal()
 {
-	TaskIdentifier goal = TaskIdentifier::Null;
-	
-	//TODO: should have a fallback mechanism, if the best goal's preconditions are false, try the next best one
-	auto& tasks = getWorld()->getAuthGameMode()->getAvailableTasks();
-	utilities.clear();
+	auto next = static_cast<std::size_t>(utilityIterator - begin(utilities)) + 1;
 
-	int i = 0;
-	for (auto& taskConsideration : tasks.considerations)
+	if (next >= rankedUtilities && !prunedTasks.empty())
 	{
-		float scores[5] = {1.f, 1.f, 1.f, 1.f, 1.f};
-		float subsetMax = 0.f;
-		bool usingSubsetMax[5] = {false, false, false, false, false};
-
-		int j = 0;
-		for (auto& consideration : taskConsideration.second)
+		//they all score below the ranked goals, so they're only needed now
+		for (auto task : prunedTasks)
 		{
-			float x = 0.f;
+			scoreTask(task, -std::numeric_limits<float>::infinity());
+			utilities.push_back({scoredTasks[task]->first, taskScores[task]});
+		}
 
-			switch(consideration.type)
-			{
-				case ConsiderationType::Repeat
-					:
-				{
-					x = countDistanceSince(taskHistory, consideration.repeat.identifier) / 10.f;
-					break;
-				}
-				case ConsiderationType::Scalar
-					:
-				{
-					x = state.current.values[consideration.scalar.identifier];
-					x /= 100.f;
-					break;
-				}
-				case ConsiderationType::Flag
-					:
-				{
-					x = state.current.flags[consideration.flag.identifier];					
-					x = consideration.flag.negate ? !x : x;
-					break;
-				}
-				case ConsiderationType::Distance
-					:
-				{
-					auto from = state.current.vectors[consideration.distance.from];
-					auto to = state.current.vectors[consideration.distance.to];
+		prunedTasks.clear();
+		std::stable_sort(begin(utilities) + rankedUtilities, end(utilities), byScoreDescending);
+		rankedUtilities = utilities.size();
+	}
 
-					x = distanceSquared(from, to);
-					x /= 1000000.f;
-					break;
-				}
-				case ConsiderationType::ConsumableFlag
-					:
-				{
-					x = !state.facts.flags[consideration.consumableFlag.fact].consumed;
-					break;
-				}
-				case ConsiderationType::ConsumableValue
-					:
-				{
-					x = !state.facts.values[consideration.consumableValue.fact].consumed;
-					break;
-				}
-				case ConsiderationType::ConsumableVector
-					:
-				{
-					x = !state.facts.vectors[consideration.consumableVector.fact].consumed;
-					break;
-				}
-				case ConsiderationType::AuditoryStimulus
-					:
-				{
-					/*for (auto& engram : state.memory.shortTermMemory)
-					{
-						if (engram.type == EngramType::Heard)
-						{
-							x = 1.f;
-							break;
-						}
-					}*/
-
-					/*for (auto& locus : state.memory.focusLocus)
-					{
-						if (!consumedLoci[locus.id])
-						{
+	utilityIterator = begin(utilities) + std::min(next, utilities.size());
 
-						}
-					}*/
+	return utilityIterator != end(utilities) ? &*utilityIterator : nullptr;
+}
 
-					break;
-				}
-				case ConsiderationType::Predicate
-					:
-				{
-					x = consideration.predicateFunction(state);
-					break;
-				}
-				case ConsiderationType::ValueOverTimeTracker
-					:
-				{
-					auto& tracker = state.valueTrackers[consideration.valueTracker.identifier];
+void HierarchicalTaskNetworkComponent::createPlan(TaskIdentifier goal)
+{
+	auto gameMode = getWorld()->getAuthGameMode();
+	auto& tasks = gameMode->getAvailableTasks();
+	auto& workers = gameMode->getPlanWorkers();
 
-					switch (consideration.valueTracker.trackerProperty)
-					{
-						case ValueOverTimeTracker_Property::MaxValue
-							:
-						{
-							x = tracker.maxValue;
-							break;
-						}
-						case ValueOverTimeTracker_Property::DurationBelowValue
-							:
-						{
-							x = tracker.durationBelowValue;
-							break;
-						}
-						case ValueOverTimeTracker_Property::Reacted
-							:
-						{
-							x = tracker.reacted;
-							break;
-						}
-						case ValueOverTimeTracker_Property::DurationExceedsExtension
-							:
-						{
-							if (tracker.durationExceedsExtension)
-							{
-								x = tracker.durationExceedsExtension(tracker);
-							}	
-							break;						
-						}						
-					}
+	if (workers.getThreadCount() > 0)
+	{
+		//picked up at the start of a later fixedTick
+		planner.pendingPlan = workers.submit(tasks.tasks[goal], state, tasks, &gameMode->getPlanCache());
+		planner.pendingGoal = goal;
+		return;
+	}
 
-					break;
-				}
-				case ConsiderationType::LocusImportance
-					:
-				{
-					auto& fact = state.facts.values[consideration.locusImportance.factContainingLocusId];
+	planner.search.start(tasks.tasks[goal], state, tasks, &gameMode->getPlanCache());
+	continuePlanning();
+}
 
-					if (!fact.consumed)
-					{
-						//TODO: should divide by 100 for now, have a general scale thing to 0-1 for future						
-						auto locus = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
-							[id=roundToInt(fact.value)](auto& l){return l.id == id;});
-
-						if (locus != end(state.memory.focusLocus))
-						{
-							x = locus->currentImportance;
-						}
-					}
+void HierarchicalTaskNetworkComponent::saveSnapshot(SnapshotWriter& writer) const
+{
+	writeWorldState(writer, state);
+	writeTaskHistory(writer, taskHistory);
+	writePlanCursor(writer, getPlanCursor(planner.plan, currentGoal));
+	writer.write(timeOnGoal);
+}
 
-					break;
-				}
-				case ConsiderationType::LocusAge
-					:
-				{
-					auto& fact = state.facts.values[consideration.locusAge.factContainingLocusId];
+bool HierarchicalTaskNetworkComponent::loadSnapshot(SnapshotReader& reader)
+{
+	PlanCursor cursor;
 
-					if (!fact.consumed)
-					{
-						//TODO: should divide by 100 for now, have a general scale thing to 0-1 for future
-						auto locus = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
-							[id=roundToInt(fact.value)](auto& l){return l.id == id;});
-
-						if (locus != end(state.memory.focusLocus))
-						{
-							x = static_cast<float>(locus->engrams.back().age) / MaxEngramAge;
-						}
-					}
+	if (!readWorldState(reader, state, getWorld())
+		|| !readTaskHistory(reader, taskHistory)
+		|| !readPlanCursor(reader, cursor)
+		|| !reader.read(timeOnGoal))
+	{
+		return false;
+	}
 
-					break;
-				}
-			}
+	auto gameMode = getWorld()->getAuthGameMode();
+	auto& tasks = gameMode->getAvailableTasks();
+	auto& agentStates = gameMode->getAgentStates();
+	agentStates.store(agentHandle, state.current);
+	agentStates.storeTrackers(agentHandle, state.valueTrackers);
+	//readWorldState marks every slot changed, the rest has to be rescored too
+	changedInputSources = ~0u;
 
-			x = consideration.function.horizontalStretch * (x + consideration.function.horizontalOffset);
-			float weight = evaluators[static_cast<int>(consideration.function.type)](x, consideration.function);					
-			weight = consideration.function.verticalStretch * weight + consideration.function.verticalOffset;
+	//whatever was being planned before the load is stale now
+	planner.pendingPlan = {};
+	planner.search.takeResult();
 
-			usingSubsetMax[consideration.group] = consideration.useSubsetMax;
+	currentGoal = cursor.goal;
+	currentGoalName = tasks.tasks[currentGoal].debugName.c_str();
+	auto plan = rebuildPlan(cursor.vertices, cursor.implementations, cursor.revision, tasks);
 
-			scores[consideration.group] *= weight;
-	
-			j++;
+	if (plan.empty())
+	{
+		//repaired, or the tasks have changed since the save, so all that's left is the goal
+		planner.search.start(tasks.tasks[currentGoal], state, tasks, &gameMode->getPlanCache());
+		planner.search.run();
+		plan = planner.search.takeResult();
+	}
+
+	if (applyPlanCursor(cursor, plan))
+	{
+		planner.plan = std::move(plan);
+	}
+	else
+	{
+		planner.plan = instantiatePlan(std::move(plan), state, worldQuerySystem);
+		planner.plan.start();
+	}
+
+	updateHUD_PlanPath();
+
+	return true;
+}
+
+void HierarchicalTaskNetworkComponent::joinSquad(SquadBlackboard& blackboard)
+{
+	squad = &blackboard;
+
+	StateMask shared;
+
+	for (int i = 0; i < ConsumableFactCount; i++)
+	{
+		if (squadSharing(static_cast<ConsumableFact>(i)) != FactSharing::Private)
+		{
+			shared.factFlags |= 1u << i;
+			shared.factValues |= 1u << i;
+			shared.factVectors |= 1u << i;
 		}
+	}
 
-		bool shouldMultiply {false};
-		for (int subset = 0; subset < 5; subset++)
+	squadSubscription = state.subscribe(shared);
+}
+
+/*
+A Read fact this agent produced is published and marked as seen. A Claim fact is published
+and dropped locally, so it only comes back through the claim like it would for anyone else
+*/
+std::uint32_t publishSquadFact(SquadBlackboard& squad, WorldState& state, StateSlot slot, ConsumableFact fact, FactSharing sharing, std::uint32_t seen)
+{
+	std::uint32_t generation {0};
+
+	switch (slot)
+	{
+		case StateSlot::Flag:
 		{
-			if (usingSubsetMax[subset])
-			{
-				subsetMax = std::max(subsetMax, scores[subset]);
-				shouldMultiply = true;
-			}
+			if (!state.facts.flags.contains(fact) || state.facts.flags.at(fact).consumed)
+				return seen;
+
+			generation = squad.produceFactFlag(fact, state.facts.flags.at(fact).flag);
+
+			if (sharing == FactSharing::Claim)
+				state.consumeFactFlag(fact);
+
+			break;
 		}
+		case StateSlot::Value:
+		{
+			if (!state.facts.values.contains(fact) || state.facts.values.at(fact).consumed)
+				return seen;
+
+			generation = squad.produceFactValue(fact, state.facts.values.at(fact).value);
 
-		float score = scores[0];
-		if (shouldMultiply)
+			if (sharing == FactSharing::Claim)
+				state.consumeFactValue(fact);
+
+			break;
+		}
+		case StateSlot::Vector:
 		{
-			score *= subsetMax;
+			if (!state.facts.vectors.contains(fact) || state.facts.vectors.at(fact).consumed)
+				return seen;
+
+			generation = squad.produceFactVector(fact, state.facts.vectors.at(fact).value);
+
+			if (sharing == FactSharing::Claim)
+				state.consumeFactVector(fact);
+
+			break;
 		}
+	}
 
-		utilities.push_back({taskConsideration.first, score});
-			
-		i++;
+	return sharing == FactSharing::Read ? generation : seen;
+}
+
+//Read facts are copied if they're still available, Claim facts only if this agent wins the claim
+void pickUpSquadFact(SquadBlackboard& squad, WorldState& state, StateSlot slot, ConsumableFact fact, FactSharing sharing)
+{
+	auto claim = sharing == FactSharing::Claim;
+
+	switch (slot)
+	{
+		case StateSlot::Flag:
+		{
+			auto shared = squad.readFactFlag(fact);
+
+			if (claim ? squad.consumeFactFlag(fact, shared) : !shared.consumed)
+				state.produceFactFlag(fact, shared.flag);
+
+			break;
+		}
+		case StateSlot::Value:
+		{
+			auto shared = squad.readFactValue(fact);
+
+			if (claim ? squad.consumeFactValue(fact, shared) : !shared.consumed)
+				state.produceFactValue(fact, shared.value);
+
+			break;
+		}
+		case StateSlot::Vector:
+		{
+			FactVector shared;
+
+			if (claim ? squad.consumeFactVector(fact, shared) : !(shared = squad.readFactVector(fact)).consumed)
+				state.produceFactVector(fact, shared.value);
+
+			break;
+		}
 	}
+}
 
-	std::sort(begin(utilities), end(utilities), [](const Utility& l, const Utility& r)
+void HierarchicalTaskNetworkComponent::syncSquadFacts()
+{
+	if (squad == nullptr)
+		return;
+
+	auto produced = state.takeChanges(squadSubscription);
+	std::uint32_t StateMask::* masks[] = {&StateMask::factFlags, &StateMask::factValues, &StateMask::factVectors};
+
+	for (int i = 0; i < ConsumableFactCount; i++)
 	{
-		return l.score < r.score;
-	});
+		auto fact = static_cast<ConsumableFact>(i);
+		auto sharing = squadSharing(fact);
 
-	if (!utilities.empty())
+		if (sharing == FactSharing::Private)
+			continue;
+
+		for (int kind = 0; kind < 3; kind++)
+		{
+			auto slot = static_cast<StateSlot>(kind);
+			auto& seen = squadGenerations[kind][i];
+
+			if (produced.*masks[kind] & (1u << i))
+			{
+				seen = publishSquadFact(*squad, state, slot, fact, sharing, seen);
+			}
+
+			auto generation = squad->generation(slot, fact);
+
+			if (generation != seen)
+			{
+				seen = generation;
+				pickUpSquadFact(*squad, state, slot, fact, sharing);
+			}
+		}
+	}
+
+	//what was just picked up came from the squad, it doesn't need publishing
+	state.takeChanges(squadSubscription);
+}
+
+void HierarchicalTaskNetworkComponent::setActorsToIgnore(const std::vector<Actor*>& actors)
+{
+	if (auto recorder = getWorld()->getAuthGameMode()->getRecorder())
 	{
-		goal = utilities.back().task;
+		recorder->recordIgnoredActors(owner->getId(), actors);
 	}
 
-	utilityIterator = begin(utilities);
+	state.actorsToIgnore = actors;
+	state.actorsToIgnoreChanged = true;
+}
 
-	return goal;
+bool HierarchicalTaskNetworkComponent::isPlanning() const
+{
+	return planner.pendingPlan.valid() || planner.search.isRunning() || planner.search.isFinished();
 }
 
-void HierarchicalTaskNetworkComponent::createPlan(TaskIdentifier goal)
+bool HierarchicalTaskNetworkComponent::continuePlanning()
 {
+	Plan plan;
+
+	//the old plan keeps going (or we idle) until the new one is ready
+	if (planner.pendingPlan.valid())
+	{
+		if (planner.pendingPlan.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+		{
+			return false;
+		}
+
+		Plan searched;
+
+		try
+		{
+			searched = planner.pendingPlan.get();
+		}
+		catch (const std::exception& e)
+		{
+			//the search never finished (it threw, or its worker went away), so it's planned again
+			auto& tasks = getWorld()->getAuthGameMode()->getAvailableTasks();
+			log("[", owner->getName(), "] ", "ERROR: planning ", tasks.tasks[planner.pendingGoal].debugName, " failed: ", e.what());
+			createPlan(planner.pendingGoal);
+			return false;
+		}
+
+		plan = instantiatePlan(std::move(searched), state, worldQuerySystem);
+	}
+	else
+	{
+		if (!planner.search.step(PlanningNodeBudget))
+		{
+			return false;
+		}
+
+		plan = planner.search.takePlan(state, worldQuerySystem);
+	}
+
 	auto& tasks = getWorld()->getAuthGameMode()->getAvailableTasks();
-	planner.plan = generatePlan(tasks.tasks[goal], state, worldQuerySystem, planner.parameters, tasks);
+
+	if (!planner.plan.finished && !planner.plan.failed)
+	{
+		//the old plan was interrupted
+		executeFinally(planner.plan, state);
+	}
+
+	planner.plan = std::move(plan);
 
 	if (planner.plan.failed)
 	{
@@ -1012,15 +1386,20 @@ void HierarchicalTaskNetworkComponent::createPlan(TaskIdentifier goal)
 		if (planner.plan.failed)
 		{
 			createPlan(TaskIdentifier::Null);
+			return !isPlanning();
 		}
 	}
 
 	planner.plan.start();
 	updateHUD_PlanPath();
+
+	return true;
 }
 
 void HierarchicalTaskNetworkComponent::updateTaskHistory()
 {
+	changedInputSources = changedInputSources | InputSource::TaskHistory;
+
 	if (taskHistory.size() < 10)
 	{
 		taskHistory.push_back(currentGoal);
@@ -1045,11 +1424,18 @@ void HierarchicalTaskNetworkComponent::decide()
 {
 	auto& tasks = getWorld()->getAuthGameMode()->getAvailableTasks();
 
-	if (planner.plan.finished || planner.plan.tasks.empty())
+	if (isPlanning())
+	{
+		//still waiting on the next plan
+		return;
+	}
+
+	if (planner.plan.finished || planner.plan.empty())
 	{
 		executeFinally(planner.plan, state);
 
 		currentGoal = evaluateNeeds();
+		timeOnGoal = 0.f;
 
 #ifdef SHOW_PLANNER_INFORMATION_MESSAGES
 		log("[", owner->getName(), "] ", "New goal: ", tasks.tasks[currentGoal].debugName);
@@ -1067,12 +1453,12 @@ void HierarchicalTaskNetworkComponent::decide()
 
 		if (planner.plan.failed)
 		{
-			utilityIterator++;
+			auto fallback = nextFallbackGoal();
 
-			if (utilityIterator != end(utilities) && utilityIterator->score > 0.f)
+			if (fallback != nullptr && fallback->score > 0.f)
 			{
-				createPlan(utilityIterator->task);
-				currentGoalName = tasks.tasks[utilityIterator->task].debugName.c_str();
+				createPlan(fallback->task);
+				currentGoalName = tasks.tasks[fallback->task].debugName.c_str();
 			}
 			else
 			{
@@ -1086,7 +1472,7 @@ void HierarchicalTaskNetworkComponent::decide()
 		bool abortGoal {false};
 		TaskIdentifier goal {TaskIdentifier::Null};
 
-		if (planner.plan.currentTask->action != Action::PlayMontage
+		if (planner.plan.getCurrentTask().action != Action::PlayMontage
 			&& frameCount == 30
 			&& !isReaction(currentGoal)
 			&& false //TODO: consider removing the once-a-second task switch check with a emotions based check
@@ -1124,11 +1510,30 @@ void HierarchicalTaskNetworkComponent::decide()
 			}
 		}
 
-		if (abortGoal)
+		auto interrupt = isReaction(goal) && !isReaction(currentGoal);
+
+		if (abortGoal && !interrupt && !goalCommitment.allowsSwitch(timeOnGoal, scoreOf(currentGoal), scoreOf(goal)))
+		{
+			abortGoal = false;
+
+			if (!holdingOffGoal || heldOffGoal != goal)
+			{
+				goalCommitmentStats.replansAvoided++;
+			}
+
+			heldOffGoal = goal;
+			holdingOffGoal = true;
+		}
+		else
 		{
-			executeFinally(planner.plan, state);
+			holdingOffGoal = false;
+		}
 
+		if (abortGoal)
+		{
 			currentGoal = goal;
+			timeOnGoal = 0.f;
+			goalCommitmentStats.goalSwitches++;
 			
 			updateTaskHistory();			
 
@@ -1143,12 +1548,12 @@ void HierarchicalTaskNetworkComponent::decide()
 	
 	if (!planner.plan.failed && (!planner.plan.finished || currentGoal != TaskIdentifier::Null))
 	{
-		currentTaskName = std::string(planner.plan.currentTask->debugName.c_str());
+		currentTaskName = std::string(planner.plan.getCurrentTask().debugName.c_str());
 	}
 
 	if (planner.plan.finished && currentGoal != TaskIdentifier::Null
-		&& planner.plan.tasks[0].identifier != TaskIdentifier::Null
-		&& planner.plan.tasks.size() > 1)
+		&& planner.plan.getTask(0).identifier != TaskIdentifier::Null
+		&& planner.plan.size() > 1)
 	{
 		decide();
 	}	
@@ -1163,15 +1568,17 @@ void HierarchicalTaskNetworkComponent::decide()
 
 void HierarchicalTaskNetworkComponent::performTask(float dt)
 {
-	if (planner.plan.failed || planner.plan.finished)
+	if (planner.plan.failed || planner.plan.finished || planner.plan.empty())
 		return;
 
-	if (planner.plan.currentTask->loop)
+	auto& currentTask = planner.plan.getCurrentTask();
+
+	if (currentTask.loop && !planner.plan.getCurrentInstance().loopFinished)
 	{		
-		planner.plan.currentTask->loop(state, worldQuerySystem, *planner.plan.currentTask);
+		currentTask.loop(state, worldQuerySystem, planner.plan.getCurrentInstance());
 	}
 
-	switch(planner.plan.currentTask->action)
+	switch(planner.plan.getCurrentTask().action)
 	{
 		case Action::SelectDestination
 			:
@@ -1179,7 +1586,7 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 			/*auto navSystem = UNavigationSystem::GetCurrent(getWorld());
 			FNavLocation location;
 
-			switch(static_cast<DestinationType>(static_cast<int>(planner.plan.currentTask->parameters.values[0])))
+			switch(static_cast<DestinationType>(static_cast<int>(planner.plan.getCurrentInstance().parameters.values[0])))
 			{
 				case DestinationType::RandomLocation
 					:
@@ -1247,27 +1654,27 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 		{			
 			//TODO: should only move once per task, use the same method as should PlayAnimation play (check a float value)
 			/*AIOwner->ClearFocus(EAIFocusPriority::Gameplay);
-			AIOwner->GetCharacter()->GetCharacterMovement()->MaxWalkSpeed = planner.plan.currentTask->parameters.values[0];
+			AIOwner->GetCharacter()->GetCharacterMovement()->MaxWalkSpeed = planner.plan.getCurrentInstance().parameters.values[0];
 			
-			//if (planner.plan.currentTask->parameters.values[1] == 1.f)
+			//if (planner.plan.getCurrentInstance().parameters.values[1] == 1.f)
 			{
-				auto& args = planner.plan.currentTask->parameters.vectors[0];
+				auto& args = planner.plan.getCurrentInstance().parameters.vectors[0];
 				AIOwner->MoveToLocation(state.current.vectors[WorldStateIdentifier::Destination], args.x, args.y > 0.f, args.z > 0.f);//2);
-				planner.plan.currentTask->parameters.values[1] = 0.f;
+				planner.plan.getCurrentInstance().parameters.values[1] = 0.f;
 			}		
 
 			auto colour = FColor::Yellow;
 
-			if (!planner.plan.currentTask->parameters.vectors.empty())
+			if (!planner.plan.getCurrentInstance().parameters.vectors.empty())
 			{
-				//colour = FColor(LinearColor(planner.plan.currentTask->parameters.vectors[0]));
-				colour = LinearColor(planner.plan.currentTask->parameters.vectors[0]).ToFColor(true); 
+				//colour = FColor(LinearColor(planner.plan.getCurrentInstance().parameters.vectors[0]));
+				colour = LinearColor(planner.plan.getCurrentInstance().parameters.vectors[0]).ToFColor(true); 
 			}
 			
-			if (planner.plan.currentTask->parameters.values[1] == 1.f)
+			if (planner.plan.getCurrentInstance().parameters.values[1] == 1.f)
 			{
 				DrawDebugSphere(getWorld(), state.current.vectors[WorldStateIdentifier::Destination], 50, 16, colour, false, 60);
-				planner.plan.currentTask->parameters.values[1] = 0.f;
+				planner.plan.getCurrentInstance().parameters.values[1] = 0.f;
 			}
 			*/
 			break;
@@ -1277,16 +1684,16 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 		{			
 			//TODO: should only move once per task, use the same method as should PlayAnimation play (check a float value)
 			/*AIOwner->ClearFocus(EAIFocusPriority::Gameplay);
-			AIOwner->GetCharacter()->GetCharacterMovement()->MaxWalkSpeed = planner.plan.currentTask->parameters.values[0];
+			AIOwner->GetCharacter()->GetCharacterMovement()->MaxWalkSpeed = planner.plan.getCurrentInstance().parameters.values[0];
 			
-			if (planner.plan.currentTask->parameters.values[1] == 1.f)
+			if (planner.plan.getCurrentInstance().parameters.values[1] == 1.f)
 			{
-				auto& args = planner.plan.currentTask->parameters.vectors[0];
+				auto& args = planner.plan.getCurrentInstance().parameters.vectors[0];
 				
 				auto conversationPartner = Cast<AAICharacter>(state.blackboard->GetValueAsObject({*UEnum::GetValueAsString(TEXT("/Script/WoodenSphere.EBlackboardKey"), EBlackboardKey::ConversationPartner)}));
 
 				AIOwner->MoveToActor(conversationPartner, args.x, args.y > 0.f, args.z > 0.f);//2);
-				planner.plan.currentTask->parameters.values[1] = 0.f;
+				planner.plan.getCurrentInstance().parameters.values[1] = 0.f;
 			}*/							
 
 			break;
@@ -1301,8 +1708,8 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 		case Action::Wait
 			:
 		{
-			//planner.plan.currentTask->parameters.values[0] += dt;
-			planner.plan.currentTask->parameters.vectors[0].x += dt;
+			//planner.plan.getCurrentInstance().parameters.values[0] += dt;
+			planner.plan.getCurrentInstance().parameters.vectors[0].x += dt;
 			break;
 		}
 		case Action::BotherPlayer
@@ -1320,7 +1727,7 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 		case Action::Bark
 			:
 		{			
-			auto bark = static_cast<Bark>(static_cast<int>(planner.plan.currentTask->parameters.values[0]));
+			auto bark = static_cast<Bark>(static_cast<int>(planner.plan.getCurrentInstance().parameters.values[0]));
 			barker.bark(getWorld()->getAuthGameMode()->getBarkString(bark));
 
 			break;
@@ -1329,9 +1736,9 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 			:
 		{
 			/*auto animInstance = AIOwner->GetCharacter()->GetMesh()->AnimScriptInstance;
-			auto& parameters = planner.plan.currentTask->parameters;
+			auto& parameters = planner.plan.getCurrentInstance().parameters;
 
-			switch(static_cast<Montage>(static_cast<int>(planner.plan.currentTask->parameters.values[2])))
+			switch(static_cast<Montage>(static_cast<int>(planner.plan.getCurrentInstance().parameters.values[2])))
 			{
 				case Montage::Stare
 					:
@@ -1391,7 +1798,7 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 		case Action::PlayAnimation
 			:
 		{
-			auto& parameters = planner.plan.currentTask->parameters;
+			auto& parameters = planner.plan.getCurrentInstance().parameters;
 
 			/*auto character = Cast<AAICharacter>(AIOwner->GetCharacter());
 			character->isSitting = !character->isSitting;//true;*/
@@ -1436,8 +1843,8 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 		case Action::LookAt
 			:
 		{
-			/*auto lookAt = planner.plan.currentTask->parameters.vectors[1];
-			auto needToCalc = planner.plan.currentTask->parameters.values[0];
+			/*auto lookAt = planner.plan.getCurrentInstance().parameters.vectors[1];
+			auto needToCalc = planner.plan.getCurrentInstance().parameters.values[0];
 
 			if (needToCalc == 0.f)
 			{				
@@ -1447,10 +1854,10 @@ void HierarchicalTaskNetworkComponent::performTask(float dt)
 				rotator.Roll = 0;
 				lookAt = rotator.Vector();
 			
-				planner.plan.currentTask->parameters.values[0] = 1.f;
+				planner.plan.getCurrentInstance().parameters.values[0] = 1.f;
 			}
 
-			auto& interpDt = planner.plan.currentTask->parameters.vectors[0].x;//values[0];
+			auto& interpDt = planner.plan.getCurrentInstance().parameters.vectors[0].x;//values[0];
 			
 			auto v = lookAt - GetOwner()->GetActorLocation();
 			v.normalize();
@@ -32,6 +32,10 @@ SOFTWARE.
 #include "WorldQuerySystem/WorldQuerySystem.h"
 #include "Barker.h"
 #include "UE_Replacements.h"
+#include "AgentStateTable.h"
+#include "Snapshot.h"
+#include "SquadBlackboard.h"
+#include "UtilityBatch.h"
 
 namespace AI
 {
@@ -47,6 +51,33 @@ namespace AI
 		float score;
 	};
 
+	/*
+	How hard an agent holds on to its current goal while its plan runs. Replacing a goal makes
+	a new plan and runs the old one's finally, so goals that score about the same shouldn't
+	keep taking turns. The defaults hold on to nothing, set one with setGoalCommitment to opt in.
+	A reaction interrupting a goal that isn't one is never held off
+	*/
+	struct GoalCommitment
+	{
+		//seconds a goal is kept before anything can replace it
+		float minimumDuration {0.f};
+		//how much more than the current goal a new one has to score
+		float margin {0.f};
+		//extra score the current goal starts with, halving every inertiaHalfLife seconds
+		float inertia {0.f};
+		float inertiaHalfLife {1.f};
+
+		bool allowsSwitch(float timeOnGoal, float currentScore, float candidateScore) const;
+	};
+
+	struct GoalCommitmentStats
+	{
+		//goals replaced while their plan was still running
+		int goalSwitches {0};
+		//goals GoalCommitment held off, counted once however many ticks each was held off for
+		int replansAvoided {0};
+	};
+
 	class HierarchicalTaskNetworkComponent : public Component, public IFixedTickable
 	{
 	public:
@@ -61,9 +92,24 @@ namespace AI
 		float getCurrentStateValue(WorldStateIdentifier identifier);
 		Math::Vector3 getCurrentStateVector(WorldStateIdentifier identifier);
 
-	private:
+		/*
+		Saves/restores the agent's WorldState, task history and its plan, see PlanCursor. If the plan
+		can't be rebuilt it's made again for the saved goal, and if that comes out different the new
+		plan starts from its first task. Returns false if the snapshot couldn't be read
+		*/
+		void saveSnapshot(SnapshotWriter& writer) const;
+		bool loadSnapshot(SnapshotReader& reader);
+
+		//shares facts with the rest of the squad each tick, see FactSharing
+		void joinSquad(SquadBlackboard& blackboard);
+
+		//actors this agent should forget about and not notice again, recorded if the game mode is recording
+		void setActorsToIgnore(const std::vector<Actor*>& actors);
 
-		void tickEmotionalState(float dt);
+		void setGoalCommitment(const GoalCommitment& commitment);
+		const GoalCommitmentStats& getGoalCommitmentStats() const;
+
+	private:
 
 		void sense();
 		void senseVisual();
@@ -76,19 +122,38 @@ namespace AI
 		void addEngramToLocus(Engram& engram);
 		void recalculateLoci(std::vector<int> updatedLociIndices);
 		void produceFacts();
+		//publishes the shared facts this agent produced and picks up the ones its squad did
+		void syncSquadFacts();
 
 		//when ignoring certain actors, we don't want any sensory/short term memory that refers to said actors
 		auto purgeMemoryOfIgnoredActors() -> void;
 
+		//the value consideration scores, from state, memory or task history
+		float gatherConsiderationInput(const Consideration& consideration);
 		TaskIdentifier evaluateNeeds();
+		/*
+		Brings taskScores[task] up to date, unless partway through it turns out the task can't score
+		threshold or more. Returns false if it stopped early
+		*/
+		bool scoreTask(std::size_t task, float threshold);
+		//the next best goal after utilityIterator's, or nullptr if there isn't one
+		const Utility* nextFallbackGoal();
+		//goal's score from the last evaluateNeeds, 0 for goals without considerations
+		float scoreOf(TaskIdentifier goal);
 		void updateTaskHistory();
 		void createPlan(TaskIdentifier goal);
+		bool isPlanning() const;
+		//checks on the search started by createPlan, returns true once the new plan is in place
+		bool continuePlanning();
 		void decide();
 		void performTask(float dt);
 		void updateHUD_PlanPath();		
 
 		int frameCount {0};
 
+		//the most search nodes planning may expand per tick when there aren't any worker threads
+		static const int PlanningNodeBudget {64};
+
 		float detailSightRadius;
 		float detailAngle;
 		float motionSightRadius;
@@ -96,14 +161,58 @@ namespace AI
 
 		Planner planner;
 		WorldState state;
+		//this agent's row in the GameMode's AgentStateTable
+		AgentHandle agentHandle {-1};
 		TaskIdentifier currentGoal;
+		//seconds since currentGoal was chosen
+		float timeOnGoal {0.f};
+		GoalCommitment goalCommitment;
+		GoalCommitmentStats goalCommitmentStats;
+		//the goal being held off, so it's only counted as an avoided replan once
+		TaskIdentifier heldOffGoal;
+		bool holdingOffGoal {false};
+
+		SquadBlackboard* squad {nullptr};
+		int squadSubscription {-1};
+		//the generation of each squad fact this agent last published or picked up, per StateSlot
+		std::uint32_t squadGenerations[3][ConsumableFactCount] {};
 
 		std::deque<TaskIdentifier> taskHistory;	
 
-		std::mt19937 eng{std::random_device{}()};
+		//seeded from the game mode so recordings replay the same
+		std::mt19937 eng;
 
 		WorldQuerier worldQuerySystem;
 
+		UtilityBatch utilityBatch;
+		/*
+		evaluateNeeds only recomputes the responses whose inputs changed since it last ran (see
+		ConsiderationInputs), the rest come from here. All are in TaskDatabase::considerations order,
+		and are thrown away when the database's revision changes
+		*/
+		std::vector<const std::pair<const TaskIdentifier, std::vector<Consideration>>*> scoredTasks;
+		//where each task's considerations start in considerationResponses
+		std::vector<std::size_t> responseOffsets;
+		std::vector<float> considerationResponses;
+		//responses whose inputs changed since they were evaluated
+		std::vector<char> staleResponses;
+		std::vector<float> taskScores;
+		std::vector<ScoreBounds> responseBounds;
+		int scoredRevision {-1};
+		int scoringSubscription {-1};
+		//InputSource bits for what changed since evaluateNeeds last ran
+		std::uint32_t changedInputSources {0};
+
+		/*
+		evaluateNeeds only finishes scoring tasks that could be one of the best FallbackGoalCount,
+		visiting them best first by their last score. The rest are in prunedTasks until a fallback
+		goal past the first rankedUtilities is needed
+		*/
+		static const int FallbackGoalCount {3};
+		std::vector<std::size_t> scoringOrder;
+		std::vector<std::size_t> prunedTasks;
+		std::size_t rankedUtilities {0};
+		//best first
 		std::vector<Utility> utilities;
 		std::vector<Utility>::iterator utilityIterator;
 
@@ -66,6 +66,16 @@ namespace Math
         return result;
     }
 
+    bool operator==(const Vector3& lhs, const Vector3& rhs)
+    {
+        return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z;
+    }
+
+    bool operator!=(const Vector3& lhs, const Vector3& rhs)
+    {
+        return !(lhs == rhs);
+    }
+
     Vector3 operator*(const Vector3& v, float s)
     {
         Vector3 result;
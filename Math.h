@@ -47,6 +47,8 @@ namespace Math
     Vector3 operator+(const Vector3& lhs, const Vector3& rhs);
     Vector3 operator-(const Vector3& lhs, const Vector3& rhs);
     Vector3 operator*(const Vector3& v, float s);
+    bool operator==(const Vector3& lhs, const Vector3& rhs);
+    bool operator!=(const Vector3& lhs, const Vector3& rhs);
     
     float lengthSquared(const Vector3& v);
     float distanceSquared(const Vector3& lhs, const Vector3& rhs);
@@ -0,0 +1,122 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "PlanWorkers.h"
+#include "log.h"
+
+namespace AI
+{
+	PlanWorkerPool::PlanWorkerPool(int threadCount)
+	{
+		for (int i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back([this] {work();});
+		}
+	}
+
+	PlanWorkerPool::~PlanWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			stopping = true;
+		}
+
+		requestsAvailable.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	std::future<Plan> PlanWorkerPool::submit(const Task& goal, const WorldState& currentState, const TaskDatabase& taskDatabase,
+		PlanCache* planCache)
+	{
+		Request request;
+		request.goalVertex = goal.vertexId;
+		request.snapshot.current = currentState.current;
+		request.snapshot.facts = currentState.facts;
+		request.taskDatabase = &taskDatabase;
+		request.planCache = planCache;
+
+		auto future = request.result.get_future();
+
+		if (goal.vertexId == -1)
+		{
+			log("[Planner] ", "ERROR: ", goal.debugName, " was never added to the TaskDatabase");
+
+			Plan plan;
+			plan.failed = true;
+			request.result.set_value(std::move(plan));
+
+			return future;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			requests.push_back(std::move(request));
+		}
+
+		requestsAvailable.notify_one();
+
+		return future;
+	}
+
+	void PlanWorkerPool::work()
+	{
+		//each worker reuses one search so its arena only grows a few times
+		PlanSearch search;
+
+		while (true)
+		{
+			Request request;
+
+			{
+				std::unique_lock<std::mutex> lock {mutex};
+				requestsAvailable.wait(lock, [this] {return stopping || !requests.empty();});
+
+				//whoever submitted what's left is still waiting on it
+				if (stopping && requests.empty())
+				{
+					return;
+				}
+
+				request = std::move(requests.front());
+				requests.pop_front();
+			}
+
+			try
+			{
+				auto& goal = request.taskDatabase->taskInstances[request.goalVertex];
+				search.start(goal, request.snapshot, *request.taskDatabase, request.planCache);
+				search.run();
+				request.result.set_value(search.takeResult());
+			}
+			catch (...)
+			{
+				request.result.set_exception(std::current_exception());
+			}
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include "Planner.h"
+
+namespace AI
+{
+	/*
+	Runs plan searches on a few worker threads so replanning doesn't eat into the game thread.
+	A request copies the parts of the WorldState conditions can see, the TaskDatabase is only
+	ever read, so it must not be changed while there are requests in flight.
+
+	The result is a plan that hasn't been started yet, pass it to instantiatePlan on the
+	game thread once the future is ready. Requests still queued when the pool is destroyed
+	are finished first, so every future gets a plan. A search that throws passes the exception
+	on through the future.
+	*/
+	class PlanWorkerPool
+	{
+	public:
+
+		explicit PlanWorkerPool(int threadCount);
+		~PlanWorkerPool();
+
+		PlanWorkerPool(const PlanWorkerPool&) = delete;
+		PlanWorkerPool& operator=(const PlanWorkerPool&) = delete;
+
+		std::future<Plan> submit(const Task& goal, const WorldState& currentState, const TaskDatabase& taskDatabase,
+			PlanCache* planCache = nullptr);
+
+		int getThreadCount() const {return workers.size();}
+
+	private:
+
+		struct Request
+		{
+			int goalVertex {-1};
+			WorldState snapshot;
+			const TaskDatabase* taskDatabase {nullptr};
+			PlanCache* planCache {nullptr};
+			std::promise<Plan> result;
+		};
+
+		void work();
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable requestsAvailable;
+		std::deque<Request> requests;
+		bool stopping {false};
+	};
+}
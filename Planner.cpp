@@ -23,12 +23,11 @@ SOFTWARE.
 */
 
 #include "Planner.h"
-#include "ConditionOpSatisfies.h"
 #include <iostream>
 #include <string>
-#include <queue>
-#include <unordered_map>
 #include <algorithm>
+#include <limits>
+#include <functional>
 #include "UE_Replacements.h"
 #include "log.h"
 
@@ -38,158 +37,186 @@ namespace AI
 {
 	void Plan::start()
 	{
-		currentTask = begin(tasks);
+		currentTask = 0;
 		hasCurrentTask = true;
 
-		currentPathVertex = begin(planPath);
+		currentPathVertex = 0;
 	}	
-	
-	/*
-	note: should take into account the effects one task will have on the world when deciding whether the next
-	task's precondition is valid, even though we won't know if the world's state will actually change until
-	the effects are performed by some controller and then observed by the sensors
-
-	also have to undo the effects if that path in the network failed
-	*/
 
-	struct TaskNode
+	void Plan::instantiate(std::shared_ptr<const PlanTemplate> newTemplate)
 	{
-		TaskIdentifier identifier;
-		int priority {0};
+		planTemplate = std::move(newTemplate);
+		instances.clear();
+		instances.reserve(planTemplate->tasks.size());
 
-		TaskNode(TaskIdentifier id, int p)
-			: identifier{id}, priority{p} {}
-	};
+		for (auto& task : planTemplate->tasks)
+		{
+			TaskInstance instance;
+			instance.parameters = task.parameters;
+			instance.remainingRepeats = task.maxRepeats;
+			instances.push_back(instance);
+		}
 
-	bool operator>(const TaskNode& lhs, const TaskNode& rhs)
-	{
-		return lhs.priority > rhs.priority;
+		currentTask = 0;
+		currentPathVertex = 0;
 	}
 
-	int heuristic(Condition& remaining)
+	const std::vector<TaskIdentifier>& Plan::getPlanPath() const
 	{
-		return
-			remaining.requiredFlags.size()
-			+ remaining.requiredValues.size()
-			+ remaining.consumableFlags.size()
-			+ remaining.consumableValues.size()
-			+ remaining.consumableVectors.size();
+		static const std::vector<TaskIdentifier> empty;
+		return planTemplate ? planTemplate->planPath : empty;
 	}
+	
+	/*
+	note: the search takes into account the effects one task declares (modifiedFlags/modifiedValues) when deciding
+	whether a later task's precondition can be valid, see PlanSearch::effectsAllow. We won't know if the world's
+	state will actually change until the effects are performed by some controller and then observed by the sensors
+	*/
 
-	int heuristic(FMergedCondition& condition)
+	bool operator>(const TaskNode& lhs, const TaskNode& rhs)
 	{
-		return heuristic(condition.condition) + condition.satisfiedPredicates.size();
+		return lhs.priority > rhs.priority;
 	}
 
-	typedef bool (*Satisfier)(float a, ConditionOp op, float value);
-	static Satisfier satisfiers[] =
+	int heuristic(const FMergedCondition& condition)
 	{
-		&canLessThanSatisfy,
-		&canGreaterThanSatisfy,
-		&canEqualToSatisfy,
-		&canNotEqualToSatisfy,
-		&canLessEqualSatisfy,
-		&canGreaterEqualSatisfy
-	};
+		return condition.condition.count() + countBits(condition.condition.predicates);
+	}
 
-	void mergeConsumables(std::vector<ConsumableFact>& current, std::vector<ConsumableFact>& nextPost,
-		std::vector<ConsumableFact>& nextPre)
+	/*
+	can a task whose postcondition is post produce a value for identifier n that satisfies
+	what required needs?
+	*/
+	bool canSatisfy(const PackedCondition& post, const PackedCondition& required, int n)
 	{
-		for (auto consumable : nextPost)
+		auto bit = 1u << n;
+		auto produced = (post.valueMask & bit) ? post.ranges[n] : ValueRange{};
+		auto wanted = (required.valueMask & bit) ? required.ranges[n] : ValueRange{};
+		auto possible = intersect(produced, wanted);
+
+		if (possible.isEmpty())
 		{
-			auto it = std::find(begin(current), end(current), consumable);
-			
-			if (it != end(current))
+			return false;
+		}
+
+		if (possible.min == possible.max)
+		{
+			//only one value is possible, make sure neither side excludes it
+			if (((post.excludedMask & bit) && post.excludes(n, possible.min))
+				|| ((required.excludedMask & bit) && required.excludes(n, possible.min)))
 			{
-				auto index = it - begin(current);
-				std::swap(current[index], current.back());
-				current.pop_back();
+				return false;
 			}
 		}
 
-		current.reserve(current.size() + nextPre.size());
-		current.insert(end(current), begin(nextPre), end(nextPre));
+		return true;
 	}
 
-	Condition mergeConditions(Task& next, Condition current)
+	/*
+	removes the requirements from current that post satisfies, then adds the requirements from pre
+	*/
+	void mergeConditions(PackedCondition& current, const PackedCondition& post, const PackedCondition& pre)
 	{
-		for (auto flag : next.postconditions.requiredFlags)
-		{
-			auto it = std::find_if(begin(current.requiredFlags), end(current.requiredFlags),
-				[flag](auto& f){return f.id == flag.id;});
-			auto index = it - begin(current.requiredFlags);
+		auto satisfiedFlags = current.flagMask & post.flagMask & ~(current.flagValues ^ post.flagValues);
+		current.flagMask &= ~satisfiedFlags;
+		current.flagValues &= current.flagMask;
 
-			if (it != end(current.requiredFlags)
-				&& current.requiredFlags[index].flag == flag.flag)
+		forEachBit((current.valueMask | current.excludedMask) & (post.valueMask | post.excludedMask), [&](int n)
+		{
+			if (canSatisfy(post, current, n))
 			{
-				current.requiredFlags.erase(begin(current.requiredFlags) + index);
+				current.valueMask &= ~(1u << n);
+				current.clearExclusions(n);
+				current.ranges[n] = {};
 			}
+		});
+
+		if (current.flagMask & pre.flagMask & (current.flagValues ^ pre.flagValues))
+		{
+			current.contradictory = true;
 		}
 
-		current.requiredFlags.insert(end(next.preconditions.requiredFlags), begin(next.preconditions.requiredFlags),
-			end(next.preconditions.requiredFlags));
+		current.flagMask |= pre.flagMask;
+		current.flagValues |= pre.flagValues;
 
-		for (auto value : next.postconditions.requiredValues)
+		forEachBit(pre.valueMask, [&](int n)
 		{
-			auto it = std::find_if(begin(current.requiredValues), end(current.requiredValues),
-				[value](auto& v){return v.id == value.id;});
+			auto& range = current.ranges[n];
+			range = (current.valueMask & (1u << n)) ? intersect(range, pre.ranges[n]) : pre.ranges[n];
 
-			if (it != end(current.requiredValues))
+			if (range.isEmpty())
 			{
-				auto index = it - begin(current.requiredValues);
-				bool canSatisfy = satisfiers[static_cast<int>(value.op)](value.value, current.requiredValues[index].op, current.requiredValues[index].value);
-
-				if (canSatisfy)
-				{
-					current.requiredValues.erase(begin(current.requiredValues) + index);
-				}
+				current.contradictory = true;
 			}
-		}
+		});
+
+		current.valueMask |= pre.valueMask;
 
-		current.requiredValues.insert(end(current.requiredValues), begin(next.preconditions.requiredValues),
-			end(next.preconditions.requiredValues));
-		
-		mergeConsumables(current.consumableFlags, next.postconditions.consumableFlags, next.preconditions.consumableFlags);
-		mergeConsumables(current.consumableValues, next.postconditions.consumableValues, next.preconditions.consumableValues);
-		mergeConsumables(current.consumableVectors, next.postconditions.consumableVectors, next.preconditions.consumableVectors);
+		forEachBit(pre.excludedMask, [&](int n)
+		{
+			for (int i = 0; i < pre.excludedCounts[n]; i++)
+			{
+				current.exclude(n, pre.excluded[n][i]);
+			}
+		});
 
-		return current;
+		//pre's ranges may rule out exclusions current already had, or leave nothing they allow
+		forEachBit(pre.valueMask & current.excludedMask, [&](int n)
+		{
+			current.intersectExclusions(n);
+		});
+
+		current.consumableFlags = (current.consumableFlags & ~post.consumableFlags) | pre.consumableFlags;
+		current.consumableValues = (current.consumableValues & ~post.consumableValues) | pre.consumableValues;
+		current.consumableVectors = (current.consumableVectors & ~post.consumableVectors) | pre.consumableVectors;
+		current.predicates = (current.predicates & ~post.predicates) | pre.predicates;
+		current.contradictory = current.contradictory || pre.contradictory;
 	}
 
-	FMergedCondition mergeConditions(Task& next, FMergedCondition current)
+	FMergedCondition mergeConditions(const Task& next, const FMergedCondition& current, MergedPredicateArena& arena)
 	{
-		current.condition = mergeConditions(next, current.condition);
+		auto& post = next.postconditions.packed;
+		auto& pre = next.preconditions.packed;
 
-		for (auto satisfied : next.postconditions.satisfiedPredicates)
+		FMergedCondition merged;
+		merged.condition = current.condition;
+		merged.firstPredicate = current.firstPredicate;
+		merged.predicateCount = current.predicateCount;
+
+		if ((current.condition.predicates & post.predicates) || !next.preconditions.satisfiedPredicates.empty())
 		{
-			auto it = std::find_if(begin(current.satisfiedPredicates), end(current.satisfiedPredicates), 
-				[satisfied](auto& sp){return sp.identifier == satisfied.identifier;});
-			
-			if (it != end(current.satisfiedPredicates))
+			//the predicates change, copy the survivors to the end of the arena so the range stays contiguous
+			merged.firstPredicate = arena.predicates.size();
+
+			for (int i = 0; i < current.predicateCount; i++)
 			{
-				auto index = it - begin(current.satisfiedPredicates);
-				std::swap(current.satisfiedPredicates[index], current.satisfiedPredicates.back());
-				current.satisfiedPredicates.pop_back();
+				auto predicate = arena.predicates[current.firstPredicate + i];
+
+				if (!(post.predicates & (1u << static_cast<int>(predicate.identifier))))
+				{
+					arena.predicates.push_back(predicate);
+				}
 			}
-		}
 
-		current.satisfiedPredicates.reserve(current.satisfiedPredicates.size() + next.preconditions.satisfiedPredicates.size());
-		
-		int size = current.tasks.size();
-		for(auto& sp : next.preconditions.satisfiedPredicates)
-		{
-			current.satisfiedPredicates.push_back({sp.identifier, sp.index, size});
+			auto& satisfiedPredicates = next.preconditions.satisfiedPredicates;
+
+			for(int i = 0; i < static_cast<int>(satisfiedPredicates.size()); i++)
+			{
+				auto& sp = satisfiedPredicates[i];
+				arena.predicates.push_back({sp.identifier, sp.index, next.vertexId, next.preconditions.getPredicate(i)});
+			}
+
+			merged.predicateCount = arena.predicates.size() - merged.firstPredicate;
 		}
 
-		current.tasks.push_back(next);
+		mergeConditions(merged.condition, post, pre);
 
-		return current;
+		return merged;
 	}
 
-	std::vector<TaskIdentifier> constructPath(std::unordered_map<TaskIdentifier, TaskIdentifier> cameFrom, 
-		TaskIdentifier start, TaskIdentifier goal)
+	std::vector<int> constructPath(const std::vector<int>& cameFrom, int start, int goal)
 	{
-		std::vector<TaskIdentifier> path;
+		std::vector<int> path;
 
 		path.push_back(start);
 
@@ -202,54 +229,59 @@ namespace AI
 		return path;
 	}	
 
-	int finalizePlanImpl(Plan& plan, int index, Task& task)
+	/*
+	the tasks are copied into the plan before their parentTaskIndex is set, the database's
+	copies are shared with other searches so they're never modified
+	*/
+	int finalizePlanImpl(std::vector<Task>& tasks, int index, const Task& task, int parentTaskIndex)
 	{	
 		if (task.type == TaskType::Compound
 			|| task.type == TaskType::Recursive)
 		{
-			plan.tasks.insert(begin(plan.tasks) + index, task);
+			tasks.insert(begin(tasks) + index, task);
+			tasks[index].parentTaskIndex = parentTaskIndex;
 
-			auto parentIndex = plan.tasks.size() - 1;
+			auto parentIndex = tasks.size() - 1;
 			index++;
 
 			for (auto& subtask : task.subtasks)
 			{
-				subtask.parentTaskIndex = parentIndex;
-				index = finalizePlanImpl(plan, index, subtask);
+				index = finalizePlanImpl(tasks, index, subtask, parentIndex);
 			}
+
+			return index;
 		}
 		else if (task.type == TaskType::Abstract)
 		{
-			if (!plan.tasks.empty())
+			if (!tasks.empty())
 			{
-				auto parentIndex = plan.tasks.size();
-				plan.tasks.back().parentTaskIndex = parentIndex;			
+				auto parentIndex = tasks.size();
+				tasks.back().parentTaskIndex = parentIndex;			
 			}
-
-			plan.tasks.insert(begin(plan.tasks) + index, task);
-		}
-		else
-		{
-			plan.tasks.insert(begin(plan.tasks) + index, task);
 		}
 
+		tasks.insert(begin(tasks) + index, task);
+		tasks[index].parentTaskIndex = parentTaskIndex;
+
 		return index + 1;
 	}
 
-	void finalizePlanImpl(Plan& plan, Task& task, std::unordered_map<TaskIdentifier, int>& implementationIndex)
+	void finalizePlanImpl(PlanTemplate& plan, const Task& task, int parentTaskIndex, const std::vector<int>& implementationIndex)
 	{	
 		if (task.type == TaskType::Compound
 			|| task.type == TaskType::Recursive)
 		{
 			plan.tasks.push_back(task);
+			plan.tasks.back().parentTaskIndex = parentTaskIndex;
 
 			auto parentIndex = plan.tasks.size() - 1;
 
 			for (auto& subtask : task.subtasks)
 			{
-				subtask.parentTaskIndex = parentIndex;
-				finalizePlanImpl(plan, subtask, implementationIndex);
+				finalizePlanImpl(plan, subtask, parentIndex, implementationIndex);
 			}
+
+			return;
 		}
 		else if (task.type == TaskType::Abstract)
 		{
@@ -258,271 +290,919 @@ namespace AI
 				auto parentIndex = plan.tasks.size();
 				plan.tasks.back().parentTaskIndex = parentIndex;			
 
-				plan.implementationsUsed[parentIndex].push_back(implementationIndex[task.identifier]);
+				plan.implementationsUsed[parentIndex].push_back(implementationIndex[task.vertexId]);
 			}
+		}
 
-			plan.tasks.push_back(task);
+		plan.tasks.push_back(task);
+		plan.tasks.back().parentTaskIndex = parentTaskIndex;
+	}
+
+	void finalizePlan(Plan& plan, const std::vector<int>& vertices, const TaskDatabase& taskDatabase, 
+		const std::vector<int>& implementationIndex)
+	{
+		auto planTemplate = std::make_shared<PlanTemplate>();
+
+		for(auto vertex : vertices)
+		{
+			auto& task = taskDatabase.taskInstances[vertex];
+			finalizePlanImpl(*planTemplate, task, task.parentTaskIndex, implementationIndex);
+			planTemplate->planPath.push_back(task.identifier);
+			planTemplate->implementations.push_back(implementationIndex[vertex]);
+		}	
+
+		planTemplate->vertices = vertices;
+		planTemplate->revision = taskDatabase.revision;
+		plan.instantiate(std::move(planTemplate));
+	}
+
+	Plan rebuildPlan(const std::vector<int>& vertices, const std::vector<int>& implementations, 
+		int revision, const TaskDatabase& taskDatabase)
+	{
+		Plan plan;
+
+		if (revision != taskDatabase.revision
+			|| vertices.empty()
+			|| vertices.size() != implementations.size())
+		{
+			return plan;
 		}
-		else
+
+		std::vector<int> implementationIndex(taskDatabase.taskInstances.size(), 0);
+
+		for (std::size_t i = 0; i < vertices.size(); i++)
 		{
-			plan.tasks.push_back(task);
+			if (vertices[i] < 0 || vertices[i] >= static_cast<int>(implementationIndex.size()))
+			{
+				return plan;
+			}
+
+			implementationIndex[vertices[i]] = implementations[i];
 		}
+
+		finalizePlan(plan, vertices, taskDatabase, implementationIndex);
+		return plan;
 	}
 
-	void finalizePlan(Plan& plan, std::vector<TaskIdentifier>& identifiers, TaskDatabase& taskDatabase, 
-		std::unordered_map<TaskIdentifier, int>& implementationIndex)
+	FMergedCondition toMergedCondition(const Task& task, MergedPredicateArena& arena)
 	{
-		for(auto identifier : identifiers)
+		FMergedCondition merged;
+
+		merged.condition = task.preconditions.packed;
+		merged.firstPredicate = arena.predicates.size();
+		merged.predicateCount = task.preconditions.satisfiedPredicates.size();
+
+		for(int i = 0; i < merged.predicateCount; i++)
 		{
-			finalizePlanImpl(plan, taskDatabase.tasks[identifier], implementationIndex);
-		}	
+			auto& sp = task.preconditions.satisfiedPredicates[i];
+			arena.predicates.push_back({sp.identifier, sp.index, task.vertexId, task.preconditions.getPredicate(i)});
+		}
 
-		plan.planPath = identifiers;
+		return merged;
 	}
 
-	FMergedCondition toMergedCondition(Condition condition, Task task)
+	void SearchArena::reset(int vertexCount)
 	{
-		FMergedCondition merged;
+		predicates.reset();
+		frontier.clear();
+		frontier.reserve(vertexCount);
+		cameFrom.assign(vertexCount, -1);
+		costSoFar.assign(vertexCount, -1);
+		remainingPreconditions.assign(vertexCount, {});
+		implementationIndex.assign(vertexCount, 0);
+		unreached.clear();
+		satisfiedPreconditions.assign(vertexCount, 0);
+	}
+
+	void SearchArena::push(int vertex, int priority)
+	{
+		frontier.emplace_back(vertex, priority);
+		std::push_heap(begin(frontier), end(frontier), std::greater<TaskNode>{});
+	}
+
+	TaskNode SearchArena::pop()
+	{
+		std::pop_heap(begin(frontier), end(frontier), std::greater<TaskNode>{});
+		auto node = frontier.back();
+		frontier.pop_back();
+
+		return node;
+	}
+
+	bool operator==(const ConditionAtom& lhs, const ConditionAtom& rhs)
+	{
+		return lhs.type == rhs.type
+			&& lhs.id == rhs.id
+			&& lhs.op == rhs.op
+			&& lhs.value == rhs.value
+			&& lhs.vertex == rhs.vertex
+			&& lhs.index == rhs.index;
+	}
 
-		merged.condition = condition;
+	bool operator==(const SearchMode& lhs, const SearchMode& rhs)
+	{
+		return lhs.heuristic == rhs.heuristic
+			&& lhs.simulateEffects == rhs.simulateEffects;
+	}
 
-		for(auto& sp : condition.satisfiedPredicates)
+	void addRead(SearchReads& reads, ConditionAtom atom)
+	{
+		if (std::find(begin(reads.atoms), end(reads.atoms), atom) == end(reads.atoms))
 		{
-			merged.satisfiedPredicates.push_back({sp.identifier, sp.index, 0});
+			reads.atoms.push_back(atom);
 		}
+	}
+
+	void addConsumableReads(SearchReads& reads, ConditionAtomType type, std::uint32_t consumables)
+	{
+		forEachBit(consumables, [&](int n)
+		{
+			addRead(reads, {type, n});
+		});
+	}
 
-		merged.tasks.push_back(task);
+	void recordReads(const PackedCondition& condition, SearchReads* reads)
+	{
+		if (reads == nullptr)
+			return;
 
-		return merged;
+		forEachBit(condition.flagMask, [&](int n)
+		{
+			addRead(*reads, {ConditionAtomType::Flag, n, ConditionOp::EqualTo, (condition.flagValues & (1u << n)) ? 1.f : 0.f});
+		});
+
+		//a range is true exactly when its bounds are, so each finite bound is its own atom
+		forEachBit(condition.valueMask, [&](int n)
+		{
+			auto& range = condition.ranges[n];
+
+			if (range.min == range.max)
+			{
+				addRead(*reads, {ConditionAtomType::Value, n, ConditionOp::EqualTo, range.min});
+				return;
+			}
+
+			if (range.min != -std::numeric_limits<float>::infinity())
+			{
+				addRead(*reads, {ConditionAtomType::Value, n, 
+					range.minInclusive ? ConditionOp::GreaterEqual : ConditionOp::GreaterThan, range.min});
+			}
+
+			if (range.max != std::numeric_limits<float>::infinity())
+			{
+				addRead(*reads, {ConditionAtomType::Value, n, 
+					range.maxInclusive ? ConditionOp::LessEqual : ConditionOp::LessThan, range.max});
+			}
+		});
+
+		forEachBit(condition.excludedMask, [&](int n)
+		{
+			for (int i = 0; i < condition.excludedCounts[n]; i++)
+			{
+				addRead(*reads, {ConditionAtomType::Value, n, ConditionOp::NotEqualTo, condition.excluded[n][i]});
+			}
+		});
+
+		addConsumableReads(*reads, ConditionAtomType::ConsumableFlag, condition.consumableFlags);
+		addConsumableReads(*reads, ConditionAtomType::ConsumableValue, condition.consumableValues);
+		addConsumableReads(*reads, ConditionAtomType::ConsumableVector, condition.consumableVectors);
+	}
+
+	void recordReads(const FMergedCondition& merged, const MergedPredicateArena& arena, SearchReads* reads)
+	{
+		if (reads == nullptr)
+			return;
+
+		recordReads(merged.condition, reads);
+
+		for (int i = 0; i < merged.predicateCount; i++)
+		{
+			auto& predicate = arena.predicates[merged.firstPredicate + i];
+			ConditionAtom atom {ConditionAtomType::Predicate, static_cast<int>(predicate.identifier)};
+			atom.vertex = predicate.vertex;
+			atom.index = predicate.index;
+			addRead(*reads, atom);
+		}
 	}
 	
-	void generatePlanImpl(Plan& plan, Task& initialTask, WorldState& currentState, TaskParameters& parameters, 
-		TaskDatabase& taskDatabase, int parentTaskIndex)
+	Plan instantiatePlan(Plan plan, WorldState& currentState, const WorldQuerier& worldQuerySystem)
 	{
-		auto start = initialTask.identifier;
+		if (plan.failed || plan.empty())
+			return plan;
 
-		std::priority_queue<TaskNode, std::vector<TaskNode>, std::greater<TaskNode>> frontier;
-		std::unordered_map<TaskIdentifier, TaskIdentifier> cameFrom;
-		std::unordered_map<TaskIdentifier, int> costSoFar;
-		std::unordered_map<TaskIdentifier, FMergedCondition> remainingPreconditions;
-		std::unordered_map<TaskIdentifier, int> implementationIndex;
+		plan.currentTask = 0;
 
-		int remainingSatisfiableStateCount = 0;
-		auto taskImplementations = taskDatabase.abstractTaskImplementations.find(initialTask.identifier);
-		bool generatingForAbstractGoal {false};
-		TaskIdentifier currentAbstractImplementation {TaskIdentifier::Null};
+		if (plan.getCurrentTask().setup)
+		{
+			plan.getCurrentTask().setup(plan.getCurrentInstance(), currentState, worldQuerySystem);
+		}
 
-		if (taskImplementations != end(taskDatabase.abstractTaskImplementations))
+		return plan;
+	}
+
+	void PlanSearch::start(const Task& goal, const WorldState& currentState, const TaskDatabase& database, PlanCache* cache)
+	{
+		taskDatabase = &database;
+		planCache = cache;
+		snapshot.current = currentState.current;
+		snapshot.facts = currentState.facts;
+		scratch.current = currentState.current;
+		scratch.journal.clear();
+		plan = {};
+		reads.atoms.clear();
+		running = false;
+		finished = false;
+
+		if (planCache != nullptr)
+		{
+			auto cached = planCache->find(goal.identifier, {searchHeuristic, simulateEffects}, snapshot, database);
+
+			if (cached)
+			{
+				plan = *cached;
+				finished = true;
+				return;
+			}
+		}
+
+		if (goal.vertexId == -1)
+		{
+			log("[Planner] ", "ERROR: ", goal.debugName, " was never added to the TaskDatabase");
+			plan.failed = true;
+			finished = true;
+			return;
+		}
+
+		goalVertex = goal.vertexId;
+		restart();
+	}
+
+	void PlanSearch::restart()
+	{
+		auto& initialTask = taskDatabase->taskInstances[goalVertex];
+		revision = taskDatabase->revision;
+		reads.atoms.clear();
+		expandedCount = 0;
+		remainingSatisfiableStateCount = 0;
+		goalImplementations = nullptr;
+		currentAbstractImplementation = -1;
+		startVertex = goalVertex;
+
+		arena.reset(taskDatabase->taskGraph.size());
+		computeRequirementCosts();
+
+		auto taskImplementations = taskDatabase->abstractTaskImplementations.find(initialTask.identifier);
+
+		if (taskImplementations != end(taskDatabase->abstractTaskImplementations))
 		{
 			//the goal is an abstract task, add all the implementations to the queue
 			//instead of the abstract task itself
 			
 			for(auto& task : taskImplementations->second)
 			{
-				frontier.emplace(task.identifier, 0);
-				cameFrom[task.identifier] = initialTask.identifier;
-				costSoFar[task.identifier] = 0;
-				remainingPreconditions[task.identifier] = toMergedCondition(task.preconditions, task);
+				arena.push(task.vertexId, 0);
+				arena.cameFrom[task.vertexId] = goalVertex;
+				arena.costSoFar[task.vertexId] = 0;
+				arena.remainingPreconditions[task.vertexId] = toMergedCondition(task, arena.predicates);
 			}
 
-			start = taskImplementations->second[0].identifier;	
+			startVertex = taskImplementations->second[0].vertexId;	
 			
-			generatingForAbstractGoal = true;
-			currentAbstractImplementation = start;
+			goalImplementations = &taskImplementations->second;
+			currentAbstractImplementation = startVertex;
 		}
 		else
 		{
-			frontier.emplace(start, 0);
-			remainingPreconditions[start] = toMergedCondition(initialTask.preconditions, initialTask);
+			arena.push(startVertex, 0);
+			arena.remainingPreconditions[startVertex] = toMergedCondition(initialTask, arena.predicates);
 		}		
 
-		cameFrom[start] = start;
-		costSoFar[start] = 0;	
+		arena.cameFrom[startVertex] = startVertex;
+		arena.costSoFar[startVertex] = 0;	
+		current = {startVertex, 0};
+		running = true;
+	}
+
+	/*
+	Builds the h_max table for this search a cost at a time: once a task's unsatisfied preconditions
+	all cost less than n, whatever it makes true that has no cost yet costs n. Everything that doesn't
+	depend on the snapshot comes from TaskDatabase::relaxedGraph, built once per revision
+	*/
+	void PlanSearch::computeRequirementCosts()
+	{
+		std::fill(std::begin(requirementCosts), std::end(requirementCosts), Unreachable);
+		recordedRequirementCosts = false;
+		auto& graph = taskDatabase->relaxedGraph;
+		hasRequirementCosts = searchHeuristic == SearchHeuristic::RelaxedMaxCost && graph.revision == taskDatabase->revision;
 
-		TaskNode current = frontier.top();
-		while (!frontier.empty())
+		if (!hasRequirementCosts)
+			return;
+
+		auto& unreached = arena.unreached;
+		unreached = graph.vertices;
+
+		for (auto vertex : unreached)
+		{
+			arena.satisfiedPreconditions[vertex] = taskDatabase->taskInstances[vertex].preconditions.packed.satisfiedRequirements(snapshot);
+		}
+
+		std::uint64_t costed {0};
+
+		for (int cost = 1; !unreached.empty(); cost++)
 		{
-			current = frontier.top();
-			frontier.pop();
+			std::uint64_t reached {0};
 
-			if (generatingForAbstractGoal)
+			unreached.erase(std::remove_if(begin(unreached), end(unreached), [&](int vertex)
 			{
-				auto it = std::find_if(begin(taskImplementations->second), end(taskImplementations->second),
-					[=](const Task& task) {return task.identifier == current.identifier;});
+				auto& requirements = taskDatabase->taskRequirements[vertex];
 
-				if (it != end(taskImplementations->second))
-				{
-					currentAbstractImplementation = current.identifier;
-				}
+				if (requirements.preconditions & ~arena.satisfiedPreconditions[vertex] & ~costed)
+					return false;
+
+				reached |= requirements.postconditions;
+				return true;
+			}), end(unreached));
+
+			reached &= ~costed;
+
+			if (reached == 0)
+				break;
+
+			forEachBit(reached, [&](int requirement)
+			{
+				requirementCosts[requirement] = cost;
+			});
+
+			costed |= reached;
+		}
+	}
+
+	int PlanSearch::estimate(int vertex, const FMergedCondition& remaining)
+	{
+		if (!hasRequirementCosts)
+		{
+			return heuristic(remaining);
+		}
+
+		auto& condition = remaining.condition;
+		recordReads(condition, getReads());
+
+		int cost {0};
+		auto unsatisfied = condition.requirementMask() & ~condition.satisfiedRequirements(snapshot);
+
+		forEachBit(unsatisfied, [&](int requirement)
+		{
+			cost = std::max(cost, requirementCosts[requirement]);
+		});
+
+		cost = std::min(cost, taskDatabase->relaxedGraph.stepsToAbstract[vertex]);
+
+		/*
+		Only the order of the frontier depends on the other tasks' preconditions, unless the chain is
+		dropped because something left can't be made true in this state even though some task could
+		make it true in another. Then the result rests on all of them, so a cached one has to as well
+		*/
+		if (cost == Unreachable && (unsatisfied & ~taskDatabase->relaxedGraph.achievable) == 0 && !recordedRequirementCosts)
+		{
+			for (auto relaxedVertex : taskDatabase->relaxedGraph.vertices)
+			{
+				recordReads(taskDatabase->taskInstances[relaxedVertex].preconditions.packed, getReads());
 			}
-		
-			//is this task abstract && not the first one?
-			if (current.identifier != initialTask.identifier)
+
+			recordedRequirementCosts = true;
+		}
+
+		return cost;
+	}
+
+	/*
+	The search goes backwards from the goal, so next would run right before the chain that ends at vertex.
+	Everything in that chain was already checked against the tasks after it, so only next's own effects
+	are new. They're applied to scratch and each later precondition on a flag/value they wrote is checked,
+	until some task in between writes that flag/value again or has a postcondition that establishes it.
+	The effects are rewound before returning so scratch is left as it was
+	*/
+	bool PlanSearch::effectsAllow(int next, int vertex)
+	{
+		auto& effects = taskDatabase->taskRequirements[next];
+
+		if (!simulateEffects || (effects.modifiedFlags | effects.modifiedValues) == 0)
+			return true;
+
+		auto& task = taskDatabase->taskInstances[next];
+		auto mark = scratch.markJournal();
+
+		for (auto& flag : task.modifiedFlags)
+		{
+			scratch.setFlag(flag.first, flag.second);
+		}
+
+		for (auto& value : task.modifiedValues)
+		{
+			scratch.setValue(value.first, value.second);
+		}
+
+		auto& ownPostconditions = task.postconditions.packed;
+		auto flags = effects.modifiedFlags & ~ownPostconditions.flagMask;
+		auto values = effects.modifiedValues & ~(ownPostconditions.valueMask | ownPostconditions.excludedMask);
+		bool allowed {true};
+
+		for (int v = vertex; v != -1 && (flags | values) != 0; v = arena.cameFrom[v] == v ? -1 : arena.cameFrom[v])
+		{
+			auto& later = taskDatabase->taskInstances[v];
+
+			if (!later.preconditions.packed.holdsFor(scratch, flags, values))
+			{
+				allowed = false;
+				break;
+			}
+
+			auto& postconditions = later.postconditions.packed;
+			flags &= ~(taskDatabase->taskRequirements[v].modifiedFlags | postconditions.flagMask);
+			values &= ~(taskDatabase->taskRequirements[v].modifiedValues | postconditions.valueMask | postconditions.excludedMask);
+		}
+
+		scratch.rewindJournal(mark);
+
+		return allowed;
+	}
+
+	SearchReads* PlanSearch::getReads()
+	{
+		return planCache != nullptr ? &reads : nullptr;
+	}
+
+	bool PlanSearch::expandNext()
+	{
+		current = arena.pop();
+		expandedCount++;
+
+		auto& currentTask = taskDatabase->taskInstances[current.vertex];
+		auto& cameFrom = arena.cameFrom;
+		auto& costSoFar = arena.costSoFar;
+		auto& remainingPreconditions = arena.remainingPreconditions;
+
+		if (goalImplementations != nullptr)
+		{
+			auto it = std::find_if(begin(*goalImplementations), end(*goalImplementations),
+				[=](const Task& task) {return task.vertexId == current.vertex;});
+
+			if (it != end(*goalImplementations))
 			{
-				auto implementations = taskDatabase.abstractTaskImplementations.find(current.identifier);
-				if (implementations != end(taskDatabase.abstractTaskImplementations))
+				currentAbstractImplementation = current.vertex;
+			}
+		}
+	
+		//is this task abstract && not the first one?
+		if (current.vertex != goalVertex)
+		{
+			auto implementations = taskDatabase->abstractTaskImplementations.find(currentTask.identifier);
+			if (implementations != end(taskDatabase->abstractTaskImplementations))
+			{
+				int i = 0;
+				for(auto& implementation : implementations->second)
 				{
-					int i = 0;
-					for(auto& implementation : implementations->second)
+					if (!effectsAllow(implementation.vertexId, current.vertex))
 					{
-						frontier.emplace(implementation.identifier, 0);
-						cameFrom[implementation.identifier] = current.identifier;
-						costSoFar[implementation.identifier] = 0;
-						remainingPreconditions[implementation.identifier] = toMergedCondition(implementation.preconditions, implementation);
-						implementationIndex[implementation.identifier] = i;
 						i++;
+						continue;
 					}
 
-					continue;
+					arena.push(implementation.vertexId, 0);
+					cameFrom[implementation.vertexId] = current.vertex;
+					costSoFar[implementation.vertexId] = 0;
+					remainingPreconditions[implementation.vertexId] = toMergedCondition(implementation, arena.predicates);
+					arena.implementationIndex[implementation.vertexId] = i;
+					i++;
 				}
+
+				return false;
 			}
+		}
 
-			auto preconditions = remainingPreconditions[current.identifier];
-			remainingSatisfiableStateCount = heuristic(preconditions);					
+		auto& preconditions = remainingPreconditions[current.vertex];
+		remainingSatisfiableStateCount = heuristic(preconditions);					
+		recordReads(preconditions, arena.predicates, getReads());
 
-			if (remainingSatisfiableStateCount == 0
-				|| preconditions.isTrue(currentState, taskDatabase.tasks[current.identifier], taskDatabase.satisfiablePredicates))
-			{
-				break;
-			}
+		if (remainingSatisfiableStateCount == 0
+			|| preconditions.isTrue(snapshot, arena.predicates, taskDatabase->taskInstances, taskDatabase->satisfiablePredicates))
+		{
+			return true;
+		}
 
-			auto vertex = std::find(begin(taskDatabase.taskGraph), end(taskDatabase.taskGraph), TaskVertex{current.identifier});
+		for (auto adjacentVertex : taskDatabase->taskGraph[current.vertex].adjacentTasks)
+		{
+			auto& next = taskDatabase->taskInstances[adjacentVertex];
 
-			for (auto& adjacentVertex : vertex->adjacentTasks)
-			{
-				auto& next = taskDatabase.tasks[adjacentVertex];
+			int new_cost = costSoFar[current.vertex] + 1;
 
-				int new_cost = costSoFar[current.identifier] + 1;
+			if (costSoFar[adjacentVertex] == -1 || new_cost < costSoFar[adjacentVertex])
+			{					
+				auto mergedConditions = mergeConditions(next, remainingPreconditions[current.vertex], arena.predicates);					
 
-				if (!costSoFar.count(adjacentVertex) || new_cost < costSoFar[adjacentVertex])
-				{					
-					auto mergedConditions = mergeConditions(next, remainingPreconditions[current.identifier]);					
-					int priority = heuristic(mergedConditions);
+				if (mergedConditions.condition.contradictory)
+				{
+					//no state can satisfy this chain
+					continue;
+				}
 
-					auto adjacent = std::find(begin(taskDatabase.taskGraph), end(taskDatabase.taskGraph), TaskVertex{adjacentVertex});
+				if (!effectsAllow(adjacentVertex, current.vertex))
+				{
+					//running next would undo something a later task needs
+					continue;
+				}
 
-					if (adjacent->adjacentTasks.empty()
-						&& priority > 0
-						&& !mergedConditions.isTrue(currentState, next, taskDatabase.satisfiablePredicates))
+				int priority = estimate(adjacentVertex, mergedConditions);
+
+				if (priority == Unreachable)
+				{
+					//something left can't be made true by any task
+					continue;
+				}
+
+				bool isLeaf = taskDatabase->taskGraph[adjacentVertex].adjacentTasks.empty();
+
+				if (isLeaf && heuristic(mergedConditions) > 0)
+				{
+					recordReads(mergedConditions, arena.predicates, getReads());
+
+					if (!mergedConditions.isTrue(snapshot, arena.predicates, taskDatabase->taskInstances, taskDatabase->satisfiablePredicates))
 					{
 						//this is a dead end, don't follow
 						continue;
 					}
-
-					priority += new_cost;
-					//this cameFrom stuff isnt going to work if there are multiple instances of the TaskIdentifier in the graph
-					//eg lots of MoveTo or PlayAnimation. instead of taskIdentifier it should be an index or something
-					costSoFar[adjacentVertex] = new_cost;
-					frontier.emplace(adjacentVertex, priority);
-					cameFrom[adjacentVertex] = current.identifier;
-					remainingPreconditions[adjacentVertex] = mergedConditions;
 				}
+
+				priority += new_cost;
+				costSoFar[adjacentVertex] = new_cost;
+				arena.push(adjacentVertex, priority);
+				cameFrom[adjacentVertex] = current.vertex;
+				remainingPreconditions[adjacentVertex] = std::move(mergedConditions);
 			}
 		}
 
+		return false;
+	}
+
+	void PlanSearch::finish()
+	{
+		auto& remaining = arena.remainingPreconditions[current.vertex];
+		recordReads(remaining, arena.predicates, getReads());
+
 		if (remainingSatisfiableStateCount == 0
-			|| remainingPreconditions[current.identifier].isTrue(currentState, taskDatabase.tasks[current.identifier], taskDatabase.satisfiablePredicates))
+			|| remaining.isTrue(snapshot, arena.predicates, taskDatabase->taskInstances, taskDatabase->satisfiablePredicates))
 		{
-			if (generatingForAbstractGoal)
+			if (goalImplementations != nullptr)
 			{
-				start = currentAbstractImplementation;
+				startVertex = currentAbstractImplementation;
 			}
 
-			auto path = constructPath(cameFrom, current.identifier, start);
-			finalizePlan(plan, path, taskDatabase, implementationIndex);
+			auto path = constructPath(arena.cameFrom, current.vertex, startVertex);
+			finalizePlan(plan, path, *taskDatabase, arena.implementationIndex);
 		}
 		else
 		{
 			plan.failed = true;
 		}
-	}	
+
+		if (planCache != nullptr)
+		{
+			planCache->store(taskDatabase->taskInstances[goalVertex].identifier, {searchHeuristic, simulateEffects}, snapshot, *taskDatabase, reads.atoms, plan);
+		}
+
+		running = false;
+		finished = true;
+	}
+
+	bool PlanSearch::step(int nodeBudget)
+	{
+		if (!running)
+			return finished;
+
+		if (revision != taskDatabase->revision)
+		{
+			//the graph changed under us, none of the search so far can be trusted
+			restart();
+		}
+
+		for (int i = 0; i < nodeBudget && !arena.frontier.empty(); i++)
+		{
+			if (expandNext())
+			{
+				finish();
+				return true;
+			}
+		}
+
+		if (arena.frontier.empty())
+		{
+			finish();
+		}
+
+		return finished;
+	}
+
+	bool PlanSearch::step(std::chrono::microseconds timeBudget)
+	{
+		auto deadline = std::chrono::steady_clock::now() + timeBudget;
+
+		while (running && std::chrono::steady_clock::now() < deadline)
+		{
+			step(1);
+		}
+
+		return finished;
+	}
+
+	void PlanSearch::run()
+	{
+		while (running)
+		{
+			step(std::numeric_limits<int>::max());
+		}
+	}
+
+	Plan PlanSearch::takePlan(WorldState& currentState, const WorldQuerier& worldQuerySystem)
+	{
+		return instantiatePlan(takeResult(), currentState, worldQuerySystem);
+	}
+
+	Plan PlanSearch::takeResult()
+	{
+		finished = false;
+
+		return std::move(plan);
+	}
 
 	Plan generatePlan(Task& initialTask, WorldState& currentState, const WorldQuerier& worldQuerySystem, TaskParameters& parameters, TaskDatabase& taskDatabase)
 	{
-		Plan plan;
-		generatePlanImpl(plan, initialTask, currentState, parameters, taskDatabase, -1);
+		PlanSearch search;
+		search.start(initialTask, currentState, taskDatabase);
+		search.run();
 
-		if (plan.failed)
-			return plan;
+		return search.takePlan(currentState, worldQuerySystem);
+	}
+
+	Plan generatePlan(Task& initialTask, WorldState& currentState, const WorldQuerier& worldQuerySystem, TaskParameters& parameters, 
+		TaskDatabase& taskDatabase, PlanCache& planCache)
+	{
+		PlanSearch search;
+		search.start(initialTask, currentState, taskDatabase, &planCache);
+		search.run();
 
-		plan.currentTask = begin(plan.tasks);
+		return search.takePlan(currentState, worldQuerySystem);
+	}
 
-		if (plan.currentTask->setup)
+	bool evaluateAtom(const ConditionAtom& atom, const WorldState& state, const TaskDatabase& taskDatabase)
+	{
+		switch (atom.type)
 		{
-			plan.currentTask->setup(*plan.currentTask, currentState, worldQuerySystem);
+			case ConditionAtomType::Flag
+				:
+			{
+				auto it = state.current.flags.find(static_cast<WorldStateIdentifier>(atom.id));
+				return it != end(state.current.flags) && it->second == (atom.value != 0.f);
+			}
+			case ConditionAtomType::Value
+				:
+			{
+				auto it = state.current.values.find(static_cast<WorldStateIdentifier>(atom.id));
+				return it != end(state.current.values) && compare(it->second, atom.op, atom.value);
+			}
+			case ConditionAtomType::ConsumableFlag
+				:
+			{
+				auto it = state.facts.flags.find(static_cast<ConsumableFact>(atom.id));
+				return it != end(state.facts.flags) && !it->second.consumed;
+			}
+			case ConditionAtomType::ConsumableValue
+				:
+			{
+				auto it = state.facts.values.find(static_cast<ConsumableFact>(atom.id));
+				return it != end(state.facts.values) && !it->second.consumed;
+			}
+			case ConditionAtomType::ConsumableVector
+				:
+			{
+				auto it = state.facts.vectors.find(static_cast<ConsumableFact>(atom.id));
+				return it != end(state.facts.vectors) && !it->second.consumed;
+			}
+			case ConditionAtomType::Predicate
+				:
+			{
+				auto identifier = static_cast<SatisfiablePredicateIdentifier>(atom.id);
+				auto predicate = std::find_if(begin(taskDatabase.satisfiablePredicates), end(taskDatabase.satisfiablePredicates),
+					[identifier](const auto& sp) {return sp.identifier == identifier;});
+
+				return predicate != end(taskDatabase.satisfiablePredicates)
+					&& predicate->func(state, taskDatabase.taskInstances[atom.vertex].parameters, atom.index);
+			}
 		}
 
-		return plan;
+		return false;
+	}
+
+	/*
+	packs the truth value of every atom into a bitset
+	*/
+	std::vector<std::uint64_t> evaluateAtoms(const std::vector<ConditionAtom>& atoms, const WorldState& state, 
+		const TaskDatabase& taskDatabase)
+	{
+		std::vector<std::uint64_t> outcomes((atoms.size() + 63) / 64);
+
+		for (std::size_t i = 0; i < atoms.size(); i++)
+		{
+			if (evaluateAtom(atoms[i], state, taskDatabase))
+			{
+				outcomes[i / 64] |= std::uint64_t{1} << (i % 64);
+			}
+		}
+
+		return outcomes;
+	}
+
+	//FNV-1a
+	std::uint64_t hashOutcomes(TaskIdentifier goal, const std::vector<std::uint64_t>& outcomes)
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+
+		auto mix = [&hash](std::uint64_t word)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				hash ^= (word >> (i * 8)) & 0xff;
+				hash *= 1099511628211ull;
+			}
+		};
+
+		mix(static_cast<std::uint64_t>(goal));
+
+		for (auto word : outcomes)
+		{
+			mix(word);
+		}
+
+		return hash;
+	}
+
+	void PlanCache::checkRevision(const TaskDatabase& taskDatabase)
+	{
+		if (revision != taskDatabase.revision)
+		{
+			goals.clear();
+			revision = taskDatabase.revision;
+		}
+	}
+
+	std::shared_ptr<const Plan> PlanCache::find(TaskIdentifier goal, SearchMode mode, const WorldState& currentState, 
+		const TaskDatabase& taskDatabase)
+	{
+		std::lock_guard<std::mutex> lock {mutex};
+		checkRevision(taskDatabase);
+
+		auto goalEntries = goals.find(goal);
+
+		if (goalEntries != end(goals) && !goalEntries->second.entries.empty())
+		{
+			auto outcomes = evaluateAtoms(goalEntries->second.reads, currentState, taskDatabase);
+			auto hash = hashOutcomes(goal, outcomes);
+
+			for (auto& entry : goalEntries->second.entries)
+			{
+				if (entry.hash == hash && entry.mode == mode && entry.outcomes == outcomes)
+				{
+					hits++;
+					return entry.plan;
+				}
+			}
+		}
+
+		misses++;
+		return nullptr;
+	}
+
+	void PlanCache::store(TaskIdentifier goal, SearchMode mode, const WorldState& currentState, const TaskDatabase& taskDatabase,
+		const std::vector<ConditionAtom>& reads, Plan plan)
+	{
+		std::lock_guard<std::mutex> lock {mutex};
+		checkRevision(taskDatabase);
+
+		auto& goalEntries = goals[goal];
+		bool readNewAtoms {false};
+
+		for (auto& atom : reads)
+		{
+			if (std::find(begin(goalEntries.reads), end(goalEntries.reads), atom) == end(goalEntries.reads))
+			{
+				goalEntries.reads.push_back(atom);
+				readNewAtoms = true;
+			}
+		}
+
+		if (readNewAtoms)
+		{
+			//the existing entries don't have outcomes for the new atoms so they can't be compared anymore
+			goalEntries.entries.clear();
+		}
+
+		if (goalEntries.entries.size() >= static_cast<std::size_t>(MaxPlansPerGoal))
+		{
+			goalEntries.entries.erase(begin(goalEntries.entries));
+		}
+
+		auto outcomes = evaluateAtoms(goalEntries.reads, currentState, taskDatabase);
+		auto hash = hashOutcomes(goal, outcomes);
+
+		goalEntries.entries.push_back({hash, mode, std::move(outcomes), std::make_shared<const Plan>(std::move(plan))});
+	}
+
+	void PlanCache::invalidate()
+	{
+		std::lock_guard<std::mutex> lock {mutex};
+		goals.clear();
+	}
+
+	//moves the plan on to the next task in its template and keeps planPath in step with it
+	void advancePlan(Plan& plan)
+	{
+		plan.currentTask++;
+
+		auto& planPath = plan.getPlanPath();
+		auto& task = plan.getCurrentTask();
+
+		if (task.identifier != TaskIdentifier::Null
+			&& planPath[plan.currentPathVertex] != task.identifier)
+		{
+			plan.currentPathVertex++;
+		}
 	}
 
 	void evaluatePlan(Plan& plan, WorldState& currentState, WorldQuerier const& worldQuerySystem, TaskParameters& parameters, std::vector<SatisfiablePredicate>& satisfiablePredicates)
 	{
+		auto& currentTask = plan.getCurrentTask();
+		auto& currentInstance = plan.getCurrentInstance();
+
 		//is this an abstract or compound/.recursive task? they don't have any actions, so we can skip ahead		
-		if (plan.currentTask->type != TaskType::Simple)			
+		if (currentTask.type != TaskType::Simple)			
 		{
-			if (!plan.currentTask->preconditions.isTrue(currentState, *plan.currentTask, satisfiablePredicates))
+			if (!currentTask.preconditions.isTrue(currentState, currentInstance.parameters, satisfiablePredicates))
 			{
-				log("[", worldQuerySystem.getName(), "] ", "Compound task: ", plan.currentTask->debugName, " preconditions were not met");
+				log("[", worldQuerySystem.getName(), "] ", "Compound task: ", currentTask.debugName, " preconditions were not met");
 				plan.failed = true;
 				return;
 			}
 
 #ifdef SHOW_PLANNER_INFORMATION_MESSAGES
-			log("[", worldQuerySystem.getName(), "] ", "skipping non-simple task: ", plan.currentTask->debugName);
+			log("[", worldQuerySystem.getName(), "] ", "skipping non-simple task: ", currentTask.debugName);
 #endif
 
-			if (plan.currentTask->setup)
+			if (currentTask.setup)
 			{
-				plan.currentTask->setup(*plan.currentTask, currentState, worldQuerySystem);
+				currentTask.setup(currentInstance, currentState, worldQuerySystem);
 			}
 
-			if (plan.currentTask->loop)
+			if (currentTask.loop && !currentInstance.loopFinished)
 			{
-				plan.currentTask->loop(currentState, worldQuerySystem, *plan.currentTask);
+				currentTask.loop(currentState, worldQuerySystem, currentInstance);
 			}
 
-			plan.currentTask++;	
-
-			if (plan.currentTask->identifier != TaskIdentifier::Null
-				&& *plan.currentPathVertex != plan.currentTask->identifier)
-			{
-				plan.currentPathVertex++;
-			}
+			advancePlan(plan);
 
 #ifdef SHOW_PLANNER_INFORMATION_MESSAGES
-			log("[", worldQuerySystem.getName(), "] ", "Started task: ", plan.currentTask->debugName);
+			log("[", worldQuerySystem.getName(), "] ", "Started task: ", plan.getCurrentTask().debugName);
 #endif
 
-			if (plan.currentTask->setup)
+			if (plan.getCurrentTask().setup)
 			{
-				plan.currentTask->setup(*plan.currentTask, currentState, worldQuerySystem);
+				plan.getCurrentTask().setup(plan.getCurrentInstance(), currentState, worldQuerySystem);
 			}
 
 			return;
 		}
 
 		//are we done with the current task?
-		if ((plan.currentTask->postconditions.isTrue(currentState, *plan.currentTask, satisfiablePredicates)
-			|| (!plan.currentTask->breakConditions.isEmpty() && plan.currentTask->breakConditions.isTrue(currentState, *plan.currentTask, satisfiablePredicates)))
-			&& !plan.currentTask->failed)
+		if ((currentTask.postconditions.isTrue(currentState, currentInstance.parameters, satisfiablePredicates)
+			|| (!currentTask.breakConditions.isEmpty() && currentTask.breakConditions.isTrue(currentState, currentInstance.parameters, satisfiablePredicates)))
+			&& !currentInstance.failed)
 		{	
 #ifdef SHOW_PLANNER_INFORMATION_MESSAGES
-			log("[", worldQuerySystem.getName(), "] ", "Finished task: ", plan.currentTask->debugName);
+			log("[", worldQuerySystem.getName(), "] ", "Finished task: ", currentTask.debugName);
 #endif
 
-			if (plan.currentTask->finish)
+			if (currentTask.finish)
 			{
-				plan.currentTask->finish(currentState, *plan.currentTask);
+				currentTask.finish(currentState, currentInstance);
 			}
 
 			//is this the last task in an abstract implementation or a compound task?
-			if (plan.currentTask->parentTaskIndex != -1)
+			if (currentTask.parentTaskIndex != -1)
 			{		
-				auto& parent = plan.tasks[plan.currentTask->parentTaskIndex];		
+				auto& parent = plan.getTask(currentTask.parentTaskIndex);		
+				auto& parentInstance = plan.instances[currentTask.parentTaskIndex];
 
 				if (parent.type == TaskType::Abstract) 
 				{
-					if (!parent.postconditions.isTrue(currentState, parent, satisfiablePredicates))
+					if (!parent.postconditions.isTrue(currentState, parentInstance.parameters, satisfiablePredicates))
 					{
 						log("[", worldQuerySystem.getName(), "] ", "Abstract task: ", parent.debugName, " finished but its postconditions are not met");
 						plan.failed = true;
@@ -530,9 +1210,9 @@ namespace AI
 						return;
 					}
 				}
-				else if (parent.type == TaskType::Compound && plan.currentTask->isLastInCompound) 
+				else if (parent.type == TaskType::Compound && currentTask.isLastInCompound) 
 				{
-					if (!parent.postconditions.isTrue(currentState, parent, satisfiablePredicates)) 
+					if (!parent.postconditions.isTrue(currentState, parentInstance.parameters, satisfiablePredicates)) 
 					{
 						log("[", worldQuerySystem.getName(), "] ", "Compound task: ", parent.debugName, " finished but its postconditions were not met");
 						plan.failed = true;
@@ -540,16 +1220,16 @@ namespace AI
 						return;
 					}
 				}
-				else if (parent.type == TaskType::Recursive && plan.currentTask->isLastInCompound)
+				else if (parent.type == TaskType::Recursive && currentTask.isLastInCompound)
 				{
-					if (!parent.postconditions.isTrue(currentState, parent, satisfiablePredicates)) 
+					if (!parent.postconditions.isTrue(currentState, parentInstance.parameters, satisfiablePredicates)) 
 					{
-						if (parent.remainingRepeats > 0)
+						if (parentInstance.remainingRepeats > 0)
 						{
-							parent.remainingRepeats--;
+							parentInstance.remainingRepeats--;
 
 							log("[", worldQuerySystem.getName(), "] ", "Recursive task: ", parent.debugName, " finished, starting over since postconditions were not met");
-							plan.currentTask = begin(plan.tasks) + plan.currentTask->parentTaskIndex;
+							plan.currentTask = currentTask.parentTaskIndex;
 							evaluatePlan(plan, currentState, worldQuerySystem, parameters, satisfiablePredicates);
 						}
 						else
@@ -568,33 +1248,30 @@ namespace AI
 			}
 
 			//is there a next task?
-			if ((plan.currentTask + 1) < end(plan.tasks))
+			if ((plan.currentTask + 1) < plan.size())
 			{
 				//can we move to the next task?
-				plan.currentTask++;
+				advancePlan(plan);
 
-				if (plan.currentTask->identifier != TaskIdentifier::Null
-					&& *plan.currentPathVertex != plan.currentTask->identifier)
-				{
-					plan.currentPathVertex++;
-				}
+				auto& nextTask = plan.getCurrentTask();
+				auto& nextInstance = plan.getCurrentInstance();
 
 #ifdef SHOW_PLANNER_INFORMATION_MESSAGES
-				log("[", worldQuerySystem.getName(), "] ", "Started task: ", plan.currentTask->debugName);
+				log("[", worldQuerySystem.getName(), "] ", "Started task: ", nextTask.debugName);
 #endif
 
-				if (plan.currentTask->setup)
+				if (nextTask.setup)
 				{
-					plan.currentTask->setup(*plan.currentTask, currentState, worldQuerySystem);
+					nextTask.setup(nextInstance, currentState, worldQuerySystem);
 				}
 
-				if (plan.currentTask->preconditions.isTrue(currentState, *plan.currentTask, satisfiablePredicates)) 
+				if (nextTask.preconditions.isTrue(currentState, nextInstance.parameters, satisfiablePredicates)) 
 				{
 					return;
 				}
 				else
 				{
-					log("[", worldQuerySystem.getName(), "] ", plan.currentTask->debugName, " preconditions false, plan failed");
+					log("[", worldQuerySystem.getName(), "] ", nextTask.debugName, " preconditions false, plan failed");
 					plan.failed = true;					
 				}
 			}
@@ -612,14 +1289,14 @@ namespace AI
 		else
 		{
 			//can we still do this task?
-			if (plan.currentTask->preconditions.isTrue(currentState, *plan.currentTask, satisfiablePredicates) 
-				&& !plan.currentTask->isImmediate && !plan.currentTask->failed)
+			if (currentTask.preconditions.isTrue(currentState, currentInstance.parameters, satisfiablePredicates) 
+				&& !currentTask.isImmediate && !currentInstance.failed)
 			{
 				return;
 			}
 			else
 			{
-				log("[", worldQuerySystem.getName(), "] ", plan.currentTask->debugName, " preconditions false, plan failed");
+				log("[", worldQuerySystem.getName(), "] ", currentTask.debugName, " preconditions false, plan failed");
 				plan.failed = true;
 			}
 		}
@@ -627,13 +1304,18 @@ namespace AI
 
 	void executeFinally(Plan& plan, WorldState& currentState) 
 	{
+		if (plan.empty())
+			return;
+
 		if (plan.finished && !plan.failed)
 		{
-			for (auto it = rbegin(plan.tasks); it != rend(plan.tasks); ++it)
+			for (int i = plan.size() - 1; i >= 0; i--)
 			{
-				if (it->finally)
+				auto& task = plan.getTask(i);
+
+				if (task.finally)
 				{
-					it->finally(currentState);					
+					task.finally(currentState);					
 				}
 			}
 
@@ -643,11 +1325,13 @@ namespace AI
 		if (!plan.hasCurrentTask)
 			return;					
 
-		for(auto it = plan.currentTask; it != begin(plan.tasks); --it)
+		for(int i = plan.currentTask; i != 0; i--)
 		{
-			if (it->finally)
+			auto& task = plan.getTask(i);
+
+			if (task.finally)
 			{
-				it->finally(currentState);
+				task.finally(currentState);
 			}
 		}
 	}
@@ -655,37 +1339,63 @@ namespace AI
 	void fixFailedPlan(Plan& plan, WorldState& currentState, TaskParameters& parameters, TaskDatabase& taskDatabase)
 	{
 		//walk forwards through the plan to try to find an abstract task
-		if (!plan.hasCurrentTask)
+		if (!plan.hasCurrentTask || plan.empty())
 			return;
 
-		auto task = *plan.currentTask;
+		auto& task = plan.getCurrentTask();
 
-		if (plan.tasks[task.parentTaskIndex].type == TaskType::Abstract)
+		if (task.parentTaskIndex != -1 && plan.getTask(task.parentTaskIndex).type == TaskType::Abstract)
 		{
+			//the plan's record of implementations starts out as the template's, and diverges once one is swapped in
+			if (plan.implementationsUsed.empty())
+			{
+				plan.implementationsUsed = plan.planTemplate->implementationsUsed;
+			}
+
 			//try another implementation
 			auto& implementationsUsed = plan.implementationsUsed[task.parentTaskIndex];
 
 			int implementationIndex = 0;
-			auto abstractTask = plan.tasks[task.parentTaskIndex];
+			auto& abstractTask = plan.getTask(task.parentTaskIndex);
+
+			auto implementations = taskDatabase.abstractTaskImplementations.find(abstractTask.identifier);
+
+			if (implementations == end(taskDatabase.abstractTaskImplementations))
+			{
+				return;
+			}
 
-			for (auto& implementation : taskDatabase.abstractTaskImplementations[abstractTask.identifier])
+			for (auto& implementation : implementations->second)
 			{
 				auto it = std::find(begin(implementationsUsed), end(implementationsUsed), implementationIndex);
 
 				if (it == end(implementationsUsed))
 				{
 					//we havent used this implementation yet, check if its usable
-					if (implementation.preconditions.isTrue(currentState, implementation, taskDatabase.satisfiablePredicates))
+					if (implementation.preconditions.isTrue(currentState, implementation.parameters, taskDatabase.satisfiablePredicates))
 					{
 						plan.failed = false;
 						implementationsUsed.push_back(implementationIndex);
 						auto parentTaskIndex = task.parentTaskIndex;
 
-						auto currentTaskIndex = plan.currentTask - begin(plan.tasks);
-						plan.tasks.erase(begin(plan.tasks) + currentTaskIndex);
-						auto index = finalizePlanImpl(plan, currentTaskIndex, implementation);
-						plan.tasks[currentTaskIndex].parentTaskIndex = parentTaskIndex + (index - currentTaskIndex - 1) - 1;
-						plan.currentTask = begin(plan.tasks) + currentTaskIndex;
+						//the template is shared, so splice the implementation into a copy of it
+						auto repaired = std::make_shared<PlanTemplate>(*plan.planTemplate);
+						//it no longer matches what the search made
+						repaired->vertices.clear();
+						repaired->implementations.clear();
+						auto currentTaskIndex = plan.currentTask;
+						repaired->tasks.erase(begin(repaired->tasks) + currentTaskIndex);
+						auto index = finalizePlanImpl(repaired->tasks, currentTaskIndex, implementation, implementation.parentTaskIndex);
+						repaired->tasks[currentTaskIndex].parentTaskIndex = parentTaskIndex + (index - currentTaskIndex - 1) - 1;
+
+						//tasks before the splice keep their state, the new ones start from the implementation's parameters
+						auto instances = std::move(plan.instances);
+						auto currentPathVertex = plan.currentPathVertex;
+						plan.instantiate(std::move(repaired));
+						std::copy(begin(instances), begin(instances) + currentTaskIndex, begin(plan.instances));
+
+						plan.currentTask = currentTaskIndex;
+						plan.currentPathVertex = currentPathVertex;
 
 						//generatePlanImpl(plan, implementation, currentState, parameters, taskDatabase, task.parentTaskIndex);
 						break;
@@ -704,9 +1414,9 @@ namespace AI
 
 	void printTasksImpl(Plan& plan, int taskIndex, int currentParentIndex, std::stack<int> tabs)
 	{
-		if (taskIndex < static_cast<int>(plan.tasks.size()))
+		if (taskIndex < plan.size())
 		{
-			auto& task = plan.tasks[taskIndex];
+			auto& task = plan.getTask(taskIndex);
 
 			if (task.parentTaskIndex > tabs.top())
 			{
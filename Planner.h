@@ -27,6 +27,13 @@ SOFTWARE.
 
 #include <stack>
 #include <map>
+#include <memory>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <limits>
 #include "WorldState.h"
 #include "Tasks.h"
 #include "Utility.h"
@@ -38,32 +45,347 @@ hierarhical task network planner
 namespace AI
 {
 	/*
-	A Plan is a collection of tasks, and records any abstract implementations used by
-	the plan incase the plan fails and a different implementation can be swapped in
+	The tasks of a plan flattened into the order they'll run in, with each task's parentTaskIndex
+	pointing into tasks. Built once when a plan is made, after that it's never modified so every
+	Plan made from it (including the ones handed out by PlanCache) can share it
 	*/
-	struct Plan
+	struct PlanTemplate
 	{
 		std::vector<Task> tasks;
-		std::vector<Task>::iterator currentTask;
 		std::vector<TaskIdentifier> planPath;
-		std::vector<TaskIdentifier>::iterator currentPathVertex;
+		std::map<int, std::vector<int>> implementationsUsed;
+		/*
+		The TaskDatabase vertices the plan was made from and the implementation index of each,
+		as of revision. Empty once the plan has been repaired, see rebuildPlan
+		*/
+		std::vector<int> vertices;
+		std::vector<int> implementations;
+		int revision {-1};
+	};
+
+	/*
+	A Plan is a cursor into a PlanTemplate, plus the state of each of its tasks for the agent running it.
+	It also records any abstract implementations used by the plan incase the plan fails and a different 
+	implementation can be swapped in
+	*/
+	struct Plan
+	{
+		std::shared_ptr<const PlanTemplate> planTemplate;
+		std::vector<TaskInstance> instances;
+		int currentTask {0};
+		int currentPathVertex {0};
 		std::map<int, std::vector<int>> implementationsUsed;
 		bool failed{ false };
 		bool finished{ false };
 		bool hasCurrentTask {false};
 
 		void start();
+
+		//makes an instance for every task in the template, with the template's parameters
+		void instantiate(std::shared_ptr<const PlanTemplate> newTemplate);
+
+		bool empty() const {return instances.empty();}
+		int size() const {return static_cast<int>(instances.size());}
+
+		const Task& getTask(int index) const {return planTemplate->tasks[index];}
+		const Task& getCurrentTask() const {return planTemplate->tasks[currentTask];}
+		TaskInstance& getCurrentInstance() {return instances[currentTask];}
+		const std::vector<TaskIdentifier>& getPlanPath() const;
+	};
+
+	enum class ConditionAtomType
+	{
+		Flag,
+		Value,
+		ConsumableFlag,
+		ConsumableValue,
+		ConsumableVector,
+		Predicate
+	};
+
+	/*
+	A single expression out of a Condition that the planner looked at while searching,
+	eg "flags[PlayerIdentified] == true" or "NearDestination using task X's parameters"
+	*/
+	struct ConditionAtom
+	{
+		ConditionAtomType type;
+		int id;
+
+		//only used by Flag and Value atoms
+		ConditionOp op {ConditionOp::EqualTo};
+		float value {0.f};
+
+		//only used by Predicate atoms, the vertex of the task whose parameters the predicate reads
+		int vertex {-1};
+		int index {0};
+	};
+
+	bool operator==(const ConditionAtom& lhs, const ConditionAtom& rhs);
+
+	/*
+	How PlanSearch orders its frontier.
+
+	UnsatisfiedCount counts the requirements left. RelaxedMaxCost (h_max) takes the unsatisfied
+	requirement that needs the longest chain of tasks to become true, in a relaxed version of
+	the task graph where a task's effects never undo anything. That never overestimates, so it
+	can't make the search miss a shorter plan, and it tells apart requirements one task away
+	from ones that need a deep decomposition. It needs TaskDatabase::buildRelaxedGraph, and
+	costs a pass over every task at the start of each search, so it only pays off on graphs
+	where chains are long and many of them dead end (see bench/planner.cpp --deadends).
+	*/
+	enum class SearchHeuristic
+	{
+		UnsatisfiedCount,
+		RelaxedMaxCost
+	};
+
+	/*
+	the PlanSearch settings that change which plan it makes, cached plans are only
+	shared between searches made with the same ones
+	*/
+	struct SearchMode
+	{
+		SearchHeuristic heuristic {SearchHeuristic::UnsatisfiedCount};
+		bool simulateEffects {true};
+	};
+
+	bool operator==(const SearchMode& lhs, const SearchMode& rhs);
+
+	/*
+	The planner's search only ever looks at the WorldState through the conditions it evaluates,
+	so two searches for the same goal from states that agree on every one of those conditions
+	will make the same plan. The cache remembers which atoms were read per goal, and stores
+	the resulting plans keyed by the truth value of those atoms, so every agent sharing
+	a TaskDatabase can reuse plans made by the others.
+
+	Plans stored in the cache are never started, generatePlan copies them to make an
+	instance for the requesting agent, which shares the cached plan's PlanTemplate.
+	*/
+	class PlanCache
+	{
+	public:
+
+		/*
+		returns the cached plan for goal if there is one that was made from a state that agrees with
+		currentState under the same mode, otherwise nullptr
+		*/
+		std::shared_ptr<const Plan> find(TaskIdentifier goal, SearchMode mode, const WorldState& currentState, 
+			const TaskDatabase& taskDatabase);
+
+		/*
+		stores a plan made for goal by a search using mode, reads are the atoms the search evaluated to make it
+		*/
+		void store(TaskIdentifier goal, SearchMode mode, const WorldState& currentState, const TaskDatabase& taskDatabase,
+			const std::vector<ConditionAtom>& reads, Plan plan);
+
+		//throws away every cached plan, call this if the TaskDatabase was changed
+		void invalidate();
+
+		int getHits() const {return hits.load();}
+		int getMisses() const {return misses.load();}
+
+		//the most plans remembered per goal, oldest ones are evicted first
+		static const int MaxPlansPerGoal {32};
+
+	private:
+
+		struct Entry
+		{
+			std::uint64_t hash;
+			SearchMode mode;
+			std::vector<std::uint64_t> outcomes;
+			std::shared_ptr<const Plan> plan;
+		};
+
+		struct GoalEntries
+		{
+			//every atom any search for this goal has read
+			std::vector<ConditionAtom> reads;
+			std::vector<Entry> entries;
+		};
+
+		//expects mutex to be held
+		void checkRevision(const TaskDatabase& taskDatabase);
+
+		//find/store/invalidate can be called from any thread
+		std::mutex mutex;
+		std::map<TaskIdentifier, GoalEntries> goals;
+		int revision {-1};
+		std::atomic<int> hits {0};
+		std::atomic<int> misses {0};
+	};
+
+	struct TaskNode
+	{
+		//index into TaskDatabase::taskGraph
+		int vertex;
+		int priority {0};
+
+		TaskNode(int v, int p)
+			: vertex{v}, priority{p} {}
+	};
+
+	bool operator>(const TaskNode& lhs, const TaskNode& rhs);
+
+	/*
+	Everything a single search allocates, kept together so it can be sized once up front
+	instead of growing a node at a time
+	*/
+	struct SearchArena
+	{
+		MergedPredicateArena predicates;
+		//a min-heap on priority, use push/pop
+		std::vector<TaskNode> frontier;
+		std::vector<int> cameFrom;
+		//-1 means the vertex hasn't been reached yet
+		std::vector<int> costSoFar;
+		std::vector<FMergedCondition> remainingPreconditions;
+		std::vector<int> implementationIndex;
+
+		//used by the RelaxedMaxCost heuristic, the vertices yet to be given a cost
+		std::vector<int> unreached;
+		std::vector<std::uint64_t> satisfiedPreconditions;
+
+		void reset(int vertexCount);
+		void push(int vertex, int priority);
+		TaskNode pop();
+	};
+
+	/*
+	tracks which atoms a search evaluated against the WorldState
+	*/
+	struct SearchReads
+	{
+		std::vector<ConditionAtom> atoms;
+	};
+
+	/*
+	A search for a plan that can be run a bit at a time, so a large task graph gets spread
+	over several ticks instead of stalling one of them. The current state and facts are
+	copied when the search starts, and the plan is made for that copy.
+	*/
+	class PlanSearch
+	{
+	public:
+
+		/*
+		begins searching for a plan for goal, throwing away any search that was in progress.
+		If planCache is given it's checked first, and the finished plan is stored in it
+		*/
+		void start(const Task& goal, const WorldState& currentState, const TaskDatabase& taskDatabase, PlanCache* planCache = nullptr);
+
+		/*
+		expands at most nodeBudget nodes of the search, or as many as fit in timeBudget.
+		Returns true once the search is finished
+		*/
+		bool step(int nodeBudget);
+		bool step(std::chrono::microseconds timeBudget);
+
+		//runs the search to completion
+		void run();
+
+		//takes effect on the next start
+		void setHeuristic(SearchHeuristic heuristic) {searchHeuristic = heuristic;}
+
+		/*
+		when on (the default), the search applies each task's modifiedFlags/modifiedValues to a scratch
+		copy of the state and drops chains where those effects leave a later task's precondition false
+		*/
+		void setSimulateEffects(bool simulate) {simulateEffects = simulate;}
+
+		bool isRunning() const {return running;}
+		bool isFinished() const {return finished;}
+		int getExpandedCount() const {return expandedCount;}
+
+		//hands over the finished plan, ready to be started
+		Plan takePlan(WorldState& currentState, const WorldQuerier& worldQuerySystem);
+
+		//hands over the finished plan without running any setup, for searches run off the game thread
+		Plan takeResult();
+
+	private:
+
+		void restart();
+		void computeRequirementCosts();
+		//estimated tasks needed to satisfy remaining, Unreachable if it never can be
+		int estimate(int vertex, const FMergedCondition& remaining);
+		//returns true if next's effects don't break the preconditions of the chain from vertex to the goal
+		bool effectsAllow(int next, int vertex);
+		//returns true if the node satisfies the search
+		bool expandNext();
+		void finish();
+		SearchReads* getReads();
+
+		const TaskDatabase* taskDatabase {nullptr};
+		//the implementations of the goal if it's abstract
+		const std::vector<Task>* goalImplementations {nullptr};
+		PlanCache* planCache {nullptr};
+		WorldState snapshot;
+		//what the state looks like after a task's effects, only ever changed through its journal
+		WorldState scratch;
+		int revision {-1};
+
+		SearchArena arena;
+		SearchReads reads;
+		Plan plan;
+
+		static constexpr int Unreachable {std::numeric_limits<int>::max()};
+		SearchHeuristic searchHeuristic {SearchHeuristic::UnsatisfiedCount};
+		bool simulateEffects {true};
+		//false if this search can't use RelaxedMaxCost, see TaskDatabase::buildRelaxedGraph
+		bool hasRequirementCosts {false};
+		//per requirement, the fewest tasks needed to make it true in the relaxed task graph
+		int requirementCosts[RequirementCount];
+		//set once the preconditions requirementCosts came from are recorded as reads
+		bool recordedRequirementCosts {false};
+
+		int goalVertex {-1};
+		int startVertex {-1};
+		TaskNode current {-1, 0};
+		int remainingSatisfiableStateCount {0};
+		int currentAbstractImplementation {-1};
+		int expandedCount {0};
+
+		bool running {false};
+		bool finished {false};
 	};
 
 	struct Planner
 	{		
 		Plan plan;
 		TaskParameters parameters;		
+		//the search for the next plan, the current plan keeps running until it's done.
+		//Only used when there are no worker threads, otherwise the search runs on a worker
+		//and its result shows up in pendingPlan
+		PlanSearch search;
+		std::future<Plan> pendingPlan;
+		//what pendingPlan is a plan for, so it can be planned again if the search never finishes
+		TaskIdentifier pendingGoal {TaskIdentifier::Null};
 	};
 
+	/*
+	gets a freshly made plan ready to be started, running the first task's setup
+	*/
+	Plan instantiatePlan(Plan plan, WorldState& currentState, const WorldQuerier& worldQuerySystem);
+
 	Plan generatePlan(Task& initialTask, WorldState& currentState, const WorldQuerier& worldQuerySystem, 
 		TaskParameters& parameters, TaskDatabase& taskDatabase);
+
+	/*
+	same as above, but first checks planCache for a plan some other agent already made,
+	and stores the plan in planCache if it had to make a new one
+	*/
+	Plan generatePlan(Task& initialTask, WorldState& currentState, const WorldQuerier& worldQuerySystem, 
+		TaskParameters& parameters, TaskDatabase& taskDatabase, PlanCache& planCache);
 	
+	/*
+	makes the same plan the search made from vertices, see PlanTemplate::vertices. The plan is empty
+	if taskDatabase has changed since revision
+	*/
+	Plan rebuildPlan(const std::vector<int>& vertices, const std::vector<int>& implementations, 
+		int revision, const TaskDatabase& taskDatabase);
+
 	/*
 	Checks if we can still continue with this plan, can we move on to the next task, did we fail or finish
 	*/
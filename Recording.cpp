@@ -0,0 +1,180 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Recording.h"
+#include "UE_Replacements.h"
+#include "AgentStateTable.h"
+#include "HierarchicalTaskNetworkComponent.h"
+#include <chrono>
+
+namespace AI
+{
+	void TickRecorder::begin(std::uint32_t seed)
+	{
+		writer.begin();
+		writer.write(RecordingVersion);
+		writer.write(seed);
+	}
+
+	void TickRecorder::recordSound(Math::Vector2<float> position, float intensity, AuditoryTag tag)
+	{
+		writer.write(RecordedEvent::Sound);
+		writer.write(position);
+		writer.write(intensity);
+		writer.write(tag);
+	}
+
+	void TickRecorder::recordTransform(int actorId, const Math::Transform& transform)
+	{
+		writer.write(RecordedEvent::Transform);
+		writer.write(actorId);
+		writer.write(transform);
+	}
+
+	void TickRecorder::recordIgnoredActors(int actorId, const std::vector<Actor*>& actors)
+	{
+		writer.write(RecordedEvent::IgnoredActors);
+		writer.write(actorId);
+		writer.write(static_cast<std::uint32_t>(actors.size()));
+
+		for (auto actor : actors)
+		{
+			writer.write(actor->getId());
+		}
+	}
+
+	void TickRecorder::recordTick(float dt, std::uint64_t checksum)
+	{
+		writer.write(RecordedEvent::Tick);
+		writer.write(dt);
+		writer.write(checksum);
+	}
+
+	TickReplayer::TickReplayer(std::vector<std::uint8_t> log)
+		: log{std::move(log)}, reader{this->log}
+	{
+	}
+
+	bool TickReplayer::begin()
+	{
+		std::uint32_t version {0};
+
+		return reader.begin() && reader.read(version) && version == RecordingVersion && reader.read(seed);
+	}
+
+	bool TickReplayer::step(GameMode& mode, World& world)
+	{
+		RecordedEvent event;
+
+		while (!reader.atEnd() && reader.read(event))
+		{
+			switch (event)
+			{
+				case RecordedEvent::Sound:
+				{
+					Math::Vector2<float> position;
+					float intensity {0.f};
+					AuditoryTag tag;
+
+					if (reader.read(position) && reader.read(intensity) && reader.read(tag))
+					{
+						mode.injectSound(position, intensity, tag);
+					}
+
+					break;
+				}
+				case RecordedEvent::Transform:
+				{
+					int actorId {-1};
+					Math::Transform transform;
+
+					if (reader.read(actorId) && reader.read(transform))
+					{
+						if (auto actor = world.findActor(actorId))
+						{
+							actor->setActorTransform(transform);
+						}
+					}
+
+					break;
+				}
+				case RecordedEvent::IgnoredActors:
+				{
+					int actorId {-1};
+					std::uint32_t count {0};
+					reader.read(actorId);
+					reader.read(count);
+					actors.clear();
+
+					for (std::uint32_t i = 0; i < count && !reader.failed(); i++)
+					{
+						int id {-1};
+						reader.read(id);
+
+						if (auto actor = world.findActor(id))
+						{
+							actors.push_back(actor);
+						}
+					}
+
+					auto actor = world.findActor(actorId);
+					auto component = actor != nullptr ? actor->findComponent<HierarchicalTaskNetworkComponent>() : nullptr;
+
+					if (component != nullptr)
+					{
+						component->setActorsToIgnore(actors);
+					}
+
+					break;
+				}
+				case RecordedEvent::Tick:
+				{
+					float dt {0.f};
+					std::uint64_t checksum {0};
+
+					if (!reader.read(dt) || !reader.read(checksum))
+						return false;
+
+					auto start = std::chrono::steady_clock::now();
+					mode.tick(dt);
+					std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+					tickMilliseconds.push_back(elapsed.count());
+
+					if (firstMismatch == -1 && mode.getAgentStates().checksum() != checksum)
+					{
+						firstMismatch = tickCount;
+					}
+
+					tickCount++;
+					return true;
+				}
+				default:
+					//an event this version doesn't know, nothing after it can be trusted
+					return false;
+			}
+		}
+
+		return false;
+	}
+}
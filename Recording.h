@@ -0,0 +1,116 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/*
+Recording and replaying the inputs to GameMode::tick, to reproduce a run exactly: profile a
+frame spike over and over, bisect to the tick where it starts, or time two builds on the
+same workload.
+
+A recording is everything from outside the AI that an agent's tick depends on: the seed
+every agent's random engine is made from, sounds injected into the SoundMap, actors being
+moved, agents being told which actors to ignore and each tick's dt. It uses the snapshot
+format's header and primitives, and is a stream of events each starting with its kind.
+After each tick a checksum of the AgentStateTable is recorded so a replay can tell where it
+diverged.
+
+Replays don't reproduce the setup, make the same actors and components in the same order
+before replaying. Both recording and replaying plan on the game thread, since how many
+ticks a worker takes to find a plan isn't repeatable.
+*/
+
+#include <vector>
+#include <cstdint>
+#include "Snapshot.h"
+#include "Math.h"
+#include "Memory.h"
+
+namespace AI
+{
+	const std::uint32_t RecordingVersion {1};
+
+	enum class RecordedEvent : std::uint8_t
+	{
+		Sound,
+		Transform,
+		IgnoredActors,
+		Tick
+	};
+
+	class TickRecorder
+	{
+	public:
+
+		//starts a new recording, keeping the buffer's capacity
+		void begin(std::uint32_t seed);
+
+		void recordSound(Math::Vector2<float> position, float intensity, AuditoryTag tag);
+		void recordTransform(int actorId, const Math::Transform& transform);
+		void recordIgnoredActors(int actorId, const std::vector<class Actor*>& actors);
+		//after the tick has run, so checksum is of the state it left behind
+		void recordTick(float dt, std::uint64_t checksum);
+
+		const std::vector<std::uint8_t>& getLog() const {return writer.getBuffer();}
+
+	private:
+
+		SnapshotWriter writer;
+	};
+
+	class TickReplayer
+	{
+	public:
+
+		explicit TickReplayer(std::vector<std::uint8_t> log);
+
+		//reads the header, false if log isn't a recording of the current version
+		bool begin();
+
+		//pass to GameMode::setSeed before setting up the world
+		std::uint32_t getSeed() const {return seed;}
+
+		//applies the next tick's inputs and runs it, false once the log is used up
+		bool step(class GameMode& mode, class World& world);
+
+		//the number of ticks replayed, and the first one whose checksum differed from the recording's (-1 if none)
+		int getTickCount() const {return tickCount;}
+		int getFirstMismatch() const {return firstMismatch;}
+		//true if the log was cut short or corrupt
+		bool failed() const {return reader.failed();}
+
+		//how long each replayed tick took
+		const std::vector<float>& getTickMilliseconds() const {return tickMilliseconds;}
+
+	private:
+
+		std::vector<std::uint8_t> log;
+		SnapshotReader reader;
+		std::uint32_t seed {0};
+		int tickCount {0};
+		int firstMismatch {-1};
+		std::vector<float> tickMilliseconds;
+		std::vector<class Actor*> actors;
+	};
+}
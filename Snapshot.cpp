@@ -0,0 +1,350 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Snapshot.h"
+#include "UE_Replacements.h"
+
+namespace AI
+{
+	static_assert(std::is_trivially_copyable<State>::value, "State is written as is");
+	static_assert(std::is_trivially_copyable<Facts>::value, "Facts are written as is");
+	static_assert(std::is_trivially_copyable<TaskInstance>::value, "TaskInstances are written as is");
+
+	void SnapshotWriter::begin()
+	{
+		buffer.clear();
+		write(SnapshotMagic);
+		write(SnapshotVersion);
+	}
+
+	bool SnapshotReader::begin()
+	{
+		std::uint32_t magic {0};
+		std::uint32_t version {0};
+
+		return read(magic) && read(version) && magic == SnapshotMagic && version == SnapshotVersion;
+	}
+
+	bool SnapshotReader::take(std::size_t bytes)
+	{
+		if (hasFailed || size - offset < bytes)
+		{
+			hasFailed = true;
+			return false;
+		}
+
+		offset += bytes;
+		return true;
+	}
+
+	int actorId(const Stimulus& stimulus)
+	{
+		return stimulus.type == StimulusType::Visual && stimulus.visual.target != nullptr 
+			? stimulus.visual.target->getId() 
+			: -1;
+	}
+
+	//the stimuli as is, followed by the id of each one's actor since the pointers mean nothing once loaded
+	template<typename T, typename GetStimulus>
+	void writeStimuli(SnapshotWriter& writer, const std::vector<T>& items, GetStimulus getStimulus)
+	{
+		writer.writeArray(items);
+
+		for (auto& item : items)
+		{
+			writer.write(actorId(getStimulus(item)));
+		}
+	}
+
+	template<typename T, typename GetStimulus>
+	bool readStimuli(SnapshotReader& reader, std::vector<T>& items, World* world, GetStimulus getStimulus)
+	{
+		if (!reader.readArray(items))
+			return false;
+
+		for (auto& item : items)
+		{
+			int id {-1};
+			reader.read(id);
+
+			auto& stimulus = getStimulus(item);
+
+			if (stimulus.type == StimulusType::Visual)
+			{
+				stimulus.visual.target = id != -1 && world != nullptr ? world->findActor(id) : nullptr;
+			}
+		}
+
+		return !reader.failed();
+	}
+
+	auto stimulusOf = [](auto& item) -> auto& {return item;};
+	auto engramStimulus = [](auto& engram) -> auto& {return engram.stimulus;};
+
+	struct TrackerRecord
+	{
+		WorldStateIdentifier identifier;
+		float maxValue;
+		float durationBelowValue;
+		bool reacted;
+	};
+
+	void writeWorldState(SnapshotWriter& writer, const WorldState& state)
+	{
+		writer.write(state.current);
+		writer.write(state.facts);
+
+		auto& memory = state.memory;
+		writeStimuli(writer, memory.sensoryMemory, stimulusOf);
+		writeStimuli(writer, memory.shortTermMemory, engramStimulus);
+		writer.write(memory.focus);
+		writer.write(static_cast<std::uint32_t>(memory.focusLocus.size()));
+
+		for (auto& locus : memory.focusLocus)
+		{
+			writeStimuli(writer, locus.engrams, engramStimulus);
+			writer.write(locus.area);
+			writer.write(locus.type);
+			writer.write(locus.id);
+			writer.write(locus.currentImportance);
+		}
+
+		writer.write(FocusLocus::nextAvailableId);
+		writer.write(static_cast<std::uint32_t>(state.valueTrackers.size()));
+
+		for (auto& tracker : state.valueTrackers)
+		{
+			writer.write(TrackerRecord{tracker.first, tracker.second.maxValue, tracker.second.durationBelowValue, tracker.second.reacted});
+		}
+
+		writer.write(static_cast<std::uint32_t>(state.actorsToIgnore.size()));
+
+		for (auto actor : state.actorsToIgnore)
+		{
+			writer.write(actor->getId());
+		}
+	}
+
+	bool readWorldState(SnapshotReader& reader, WorldState& state, World* world)
+	{
+		reader.read(state.current);
+		reader.read(state.facts);
+
+		auto& memory = state.memory;
+		readStimuli(reader, memory.sensoryMemory, world, stimulusOf);
+		readStimuli(reader, memory.shortTermMemory, world, engramStimulus);
+		reader.read(memory.focus);
+
+		std::uint32_t count {0};
+		reader.read(count);
+		memory.focusLocus.resize(reader.failed() ? 0 : count);
+
+		for (auto& locus : memory.focusLocus)
+		{
+			readStimuli(reader, locus.engrams, world, engramStimulus);
+			reader.read(locus.area);
+			reader.read(locus.type);
+			reader.read(locus.id);
+			reader.read(locus.currentImportance);
+		}
+
+		int nextLocusId {0};
+
+		if (reader.read(nextLocusId))
+		{
+			//ids have to stay unique among every agent's loci, not just this one's
+			FocusLocus::nextAvailableId = std::max(FocusLocus::nextAvailableId, nextLocusId);
+		}
+
+		count = 0;
+		reader.read(count);
+
+		for (std::uint32_t i = 0; i < count && !reader.failed(); i++)
+		{
+			TrackerRecord record;
+
+			if (reader.read(record))
+			{
+				auto& tracker = state.valueTrackers[record.identifier];
+				tracker.maxValue = record.maxValue;
+				tracker.durationBelowValue = record.durationBelowValue;
+				tracker.reacted = record.reacted;
+			}
+		}
+
+		count = 0;
+		reader.read(count);
+		state.actorsToIgnore.clear();
+
+		for (std::uint32_t i = 0; i < count && !reader.failed(); i++)
+		{
+			int id {-1};
+			reader.read(id);
+			auto actor = world != nullptr ? world->findActor(id) : nullptr;
+
+			if (actor != nullptr)
+			{
+				state.actorsToIgnore.push_back(actor);
+			}
+		}
+
+		state.actorsToIgnoreChanged = true;
+		state.journal.clear();
+		state.changes.clear();
+		state.openJournalMarks = 0;
+		state.rehash();
+
+		//everything may have changed
+		StateMask all;
+		all.flags = all.values = all.vectors = ~0u;
+		all.factFlags = all.factValues = all.factVectors = ~0u;
+		state.markChanged(all);
+
+		return !reader.failed();
+	}
+
+	PlanCursor getPlanCursor(const Plan& plan, TaskIdentifier goal)
+	{
+		PlanCursor cursor;
+		cursor.goal = goal;
+		cursor.planPath = plan.getPlanPath();
+
+		if (plan.planTemplate)
+		{
+			cursor.vertices = plan.planTemplate->vertices;
+			cursor.implementations = plan.planTemplate->implementations;
+			cursor.revision = plan.planTemplate->revision;
+		}
+
+		cursor.instances = plan.instances;
+		cursor.currentTask = plan.currentTask;
+		cursor.currentPathVertex = plan.currentPathVertex;
+		cursor.failed = plan.failed;
+		cursor.finished = plan.finished;
+		cursor.hasCurrentTask = plan.hasCurrentTask;
+
+		for (auto& used : plan.implementationsUsed)
+		{
+			cursor.implementationsUsed.push_back(used.first);
+			cursor.implementationsUsed.push_back(static_cast<int>(used.second.size()));
+			cursor.implementationsUsed.insert(cursor.implementationsUsed.end(), used.second.begin(), used.second.end());
+		}
+
+		return cursor;
+	}
+
+	bool applyPlanCursor(const PlanCursor& cursor, Plan& plan)
+	{
+		if (plan.failed 
+			|| plan.getPlanPath() != cursor.planPath 
+			|| plan.instances.size() != cursor.instances.size())
+		{
+			return false;
+		}
+
+		plan.instances = cursor.instances;
+		plan.currentTask = cursor.currentTask;
+		plan.currentPathVertex = cursor.currentPathVertex;
+		plan.failed = cursor.failed;
+		plan.finished = cursor.finished;
+		plan.hasCurrentTask = cursor.hasCurrentTask;
+		plan.implementationsUsed.clear();
+
+		auto& used = cursor.implementationsUsed;
+
+		for (std::size_t i = 0; i + 1 < used.size(); )
+		{
+			auto count = static_cast<std::size_t>(used[i + 1]);
+			auto first = used.begin() + std::min(used.size(), i + 2);
+			auto last = used.begin() + std::min(used.size(), i + 2 + count);
+			plan.implementationsUsed[used[i]].assign(first, last);
+			i += 2 + count;
+		}
+
+		return true;
+	}
+
+	void writePlanCursor(SnapshotWriter& writer, const PlanCursor& cursor)
+	{
+		writer.write(cursor.goal);
+		writer.writeArray(cursor.vertices);
+		writer.writeArray(cursor.implementations);
+		writer.write(cursor.revision);
+		writer.writeArray(cursor.planPath);
+		writer.writeArray(cursor.instances);
+		writer.writeArray(cursor.implementationsUsed);
+		writer.write(cursor.currentTask);
+		writer.write(cursor.currentPathVertex);
+		writer.write(cursor.failed);
+		writer.write(cursor.finished);
+		writer.write(cursor.hasCurrentTask);
+	}
+
+	bool readPlanCursor(SnapshotReader& reader, PlanCursor& cursor)
+	{
+		reader.read(cursor.goal);
+		reader.readArray(cursor.vertices);
+		reader.readArray(cursor.implementations);
+		reader.read(cursor.revision);
+		reader.readArray(cursor.planPath);
+		reader.readArray(cursor.instances);
+		reader.readArray(cursor.implementationsUsed);
+		reader.read(cursor.currentTask);
+		reader.read(cursor.currentPathVertex);
+		reader.read(cursor.failed);
+		reader.read(cursor.finished);
+		reader.read(cursor.hasCurrentTask);
+
+		return !reader.failed();
+	}
+
+	void writeTaskHistory(SnapshotWriter& writer, const std::deque<TaskIdentifier>& history)
+	{
+		writer.write(static_cast<std::uint32_t>(history.size()));
+
+		for (auto identifier : history)
+		{
+			writer.write(identifier);
+		}
+	}
+
+	bool readTaskHistory(SnapshotReader& reader, std::deque<TaskIdentifier>& history)
+	{
+		std::uint32_t count {0};
+		reader.read(count);
+		history.clear();
+
+		for (std::uint32_t i = 0; i < count && !reader.failed(); i++)
+		{
+			TaskIdentifier identifier;
+
+			if (reader.read(identifier))
+			{
+				history.push_back(identifier);
+			}
+		}
+
+		return !reader.failed();
+	}
+}
@@ -0,0 +1,184 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/*
+Binary snapshots of an agent's AI state, for save games, level streaming and moving agents
+between servers. The format is a header followed by each part's trivially copyable data
+written as is, arrays as a count and then the elements, so loading is mostly memcpy into
+buffers that can be reused between loads. Values are in the writing machine's byte order.
+
+Bump SnapshotVersion whenever anything written changes, readers refuse other versions.
+*/
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "WorldState.h"
+#include "Planner.h"
+
+namespace AI
+{
+	const std::uint32_t SnapshotMagic {0x55544941}; //"AITU"
+	const std::uint32_t SnapshotVersion {4};
+
+	class SnapshotWriter
+	{
+	public:
+
+		template<typename T>
+		void write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be written as is");
+			auto offset = buffer.size();
+			buffer.resize(offset + sizeof(T));
+			std::memcpy(buffer.data() + offset, &value, sizeof(T));
+		}
+
+		template<typename T>
+		void writeArray(const T* values, std::uint32_t count)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be written as is");
+			write(count);
+
+			if (count == 0)
+				return;
+
+			auto offset = buffer.size();
+			buffer.resize(offset + sizeof(T) * count);
+			std::memcpy(buffer.data() + offset, values, sizeof(T) * count);
+		}
+
+		template<typename T>
+		void writeArray(const std::vector<T>& values)
+		{
+			writeArray(values.data(), static_cast<std::uint32_t>(values.size()));
+		}
+
+		//starts a new snapshot, keeping the buffer's capacity
+		void begin();
+		const std::vector<std::uint8_t>& getBuffer() const {return buffer;}
+
+	private:
+
+		std::vector<std::uint8_t> buffer;
+	};
+
+	class SnapshotReader
+	{
+	public:
+
+		SnapshotReader(const std::uint8_t* data, std::size_t size)
+			: data{data}, size{size} {}
+
+		explicit SnapshotReader(const std::vector<std::uint8_t>& buffer)
+			: SnapshotReader(buffer.data(), buffer.size()) {}
+
+		//checks the header, false if this isn't a snapshot of the current version
+		bool begin();
+
+		//once a read fails every later read does too, and failed() returns true
+		template<typename T>
+		bool read(T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be read as is");
+
+			if (!take(sizeof(T)))
+				return false;
+
+			std::memcpy(&value, data + offset - sizeof(T), sizeof(T));
+			return true;
+		}
+
+		//resizes values to the stored count, reusing its capacity
+		template<typename T>
+		bool readArray(std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be read as is");
+			std::uint32_t count {0};
+
+			if (!read(count) || !take(sizeof(T) * count))
+				return false;
+
+			values.resize(count);
+			std::memcpy(values.data(), data + offset - sizeof(T) * count, sizeof(T) * count);
+			return true;
+		}
+
+		bool failed() const {return hasFailed;}
+		bool atEnd() const {return offset == size;}
+
+	private:
+
+		//advances past bytes, false if there aren't that many left
+		bool take(std::size_t bytes);
+
+		const std::uint8_t* data;
+		std::size_t size;
+		std::size_t offset {0};
+		bool hasFailed {false};
+	};
+
+	/*
+	Actors referenced by stimuli are stored as ids, readWorldState looks them up in world
+	*/
+	void writeWorldState(SnapshotWriter& writer, const WorldState& state);
+	bool readWorldState(SnapshotReader& reader, WorldState& state, class World* world);
+
+	/*
+	Where an agent is in its plan. The plan's tasks can't be stored, so it's kept as the TaskDatabase
+	vertices it was made from (see PlanTemplate::vertices) and rebuilt from them on load. A repaired
+	plan, or one saved with a different TaskDatabase revision, has to be made again for goal instead,
+	and then the cursor only applies if it comes out with the same path
+	*/
+	struct PlanCursor
+	{
+		TaskIdentifier goal {TaskIdentifier::Null};
+		std::vector<int> vertices;
+		std::vector<int> implementations;
+		int revision {-1};
+		std::vector<TaskIdentifier> planPath;
+		std::vector<TaskInstance> instances;
+		//implementationsUsed flattened to (abstract task index, count, implementations...)
+		std::vector<int> implementationsUsed;
+		int currentTask {0};
+		int currentPathVertex {0};
+		bool failed {false};
+		bool finished {false};
+		bool hasCurrentTask {false};
+	};
+
+	PlanCursor getPlanCursor(const Plan& plan, TaskIdentifier goal);
+	//applies cursor to plan if plan has the same path, returns false if it doesn't
+	bool applyPlanCursor(const PlanCursor& cursor, Plan& plan);
+
+	void writePlanCursor(SnapshotWriter& writer, const PlanCursor& cursor);
+	bool readPlanCursor(SnapshotReader& reader, PlanCursor& cursor);
+
+	void writeTaskHistory(SnapshotWriter& writer, const std::deque<TaskIdentifier>& history);
+	bool readTaskHistory(SnapshotReader& reader, std::deque<TaskIdentifier>& history);
+}
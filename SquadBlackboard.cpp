@@ -0,0 +1,250 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SquadBlackboard.h"
+#include <cstring>
+
+namespace AI
+{
+	const FactSharing FactSharings[] = 
+	{
+		FactSharing::Claim, //Player_LastKnownLocation
+		FactSharing::Read, //Player_ForwardVector
+		FactSharing::Private, //NoiseDisturbance, the lead is a focus locus id only this agent has
+		FactSharing::Private, //Glimpse
+		FactSharing::Private, //HasLead
+		FactSharing::Private, //LostLead
+		FactSharing::Private, //Lead
+		FactSharing::Private, //PlayerRecentlyIdentified
+		FactSharing::Private, //HasPickedSeat
+		FactSharing::Private //IsPositionedToSit
+	};
+
+	static_assert(sizeof(FactSharings) / sizeof(FactSharing) == ConsumableFactCount, "update FactSharings when changing ConsumableFact");
+
+	FactSharing squadSharing(ConsumableFact fact)
+	{
+		return FactSharings[static_cast<int>(fact)];
+	}
+
+	/*
+	word layout: the flag/value's bits in the low 32, then a 31 bit generation, 
+	and the top bit set while the fact is available
+	*/
+	const std::uint64_t Available {1ull << 63};
+	const std::uint32_t GenerationMask {0x7fffffff};
+
+	std::uint32_t payloadOf(std::uint64_t word)
+	{
+		return static_cast<std::uint32_t>(word);
+	}
+
+	std::uint32_t generationOf(std::uint64_t word)
+	{
+		return static_cast<std::uint32_t>(word >> 32) & GenerationMask;
+	}
+
+	std::uint64_t makeWord(std::uint32_t payload, std::uint32_t generation)
+	{
+		return Available | (static_cast<std::uint64_t>(generation & GenerationMask) << 32) | payload;
+	}
+
+	std::uint32_t floatBits(float x)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		return bits;
+	}
+
+	float bitsFloat(std::uint32_t bits)
+	{
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+
+	std::uint32_t SquadBlackboard::produce(StateSlot slot, ConsumableFact fact, std::uint32_t payload)
+	{
+		auto& word = words[static_cast<int>(slot)][static_cast<int>(fact)];
+		auto current = word.load(std::memory_order_relaxed);
+		std::uint64_t next;
+
+		do
+		{
+			//generation 0 is never produced, it means the fact never was
+			auto generation = generationOf(current) + 1;
+			next = makeWord(payload, (generation & GenerationMask) == 0 ? 1 : generation);
+		} while (!word.compare_exchange_weak(current, next, std::memory_order_release, std::memory_order_relaxed));
+
+		return generationOf(next);
+	}
+
+	bool SquadBlackboard::consume(StateSlot slot, ConsumableFact fact, std::uint64_t& current)
+	{
+		auto& word = words[static_cast<int>(slot)][static_cast<int>(fact)];
+		current = word.load(std::memory_order_acquire);
+
+		while (current & Available)
+		{
+			if (word.compare_exchange_weak(current, current & ~Available, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::uint32_t SquadBlackboard::produceFactFlag(ConsumableFact fact, bool flag)
+	{
+		return produce(StateSlot::Flag, fact, flag ? 1 : 0);
+	}
+
+	std::uint32_t SquadBlackboard::produceFactValue(ConsumableFact fact, float value)
+	{
+		return produce(StateSlot::Value, fact, floatBits(value));
+	}
+
+	std::uint32_t SquadBlackboard::produceFactVector(ConsumableFact fact, Math::Vector3 vector)
+	{
+		auto n = static_cast<int>(fact);
+		auto& producing = vectorProducers[n];
+
+		while (producing.exchange(true, std::memory_order_acquire)) {}
+
+		auto& word = words[static_cast<int>(StateSlot::Vector)][n];
+		auto generation = generationOf(word.load(std::memory_order_relaxed)) + 1;
+		generation = (generation & GenerationMask) == 0 ? 1 : generation;
+
+		//marked as being written first so readers of the generation it held can tell it's gone
+		auto& entry = vectors[n][generation % RingSize];
+		entry.generation.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		entry.x.store(vector.x, std::memory_order_relaxed);
+		entry.y.store(vector.y, std::memory_order_relaxed);
+		entry.z.store(vector.z, std::memory_order_relaxed);
+		entry.generation.store(generation, std::memory_order_release);
+
+		//consumers may have cleared Available meanwhile, producing makes it available again regardless
+		word.store(makeWord(0, generation), std::memory_order_release);
+		producing.store(false, std::memory_order_release);
+
+		return generation;
+	}
+
+	bool SquadBlackboard::readVector(ConsumableFact fact, std::uint64_t word, Math::Vector3& out) const
+	{
+		auto generation = generationOf(word);
+		auto& entry = vectors[static_cast<int>(fact)][generation % RingSize];
+
+		if (entry.generation.load(std::memory_order_acquire) != generation)
+			return false;
+
+		out = {entry.x.load(std::memory_order_relaxed), entry.y.load(std::memory_order_relaxed), entry.z.load(std::memory_order_relaxed)};
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		return entry.generation.load(std::memory_order_relaxed) == generation;
+	}
+
+	bool SquadBlackboard::consumeFactFlag(ConsumableFact fact, FactFlag& out)
+	{
+		std::uint64_t word;
+
+		if (!consume(StateSlot::Flag, fact, word))
+			return false;
+
+		out = {payloadOf(word) != 0, false};
+		return true;
+	}
+
+	bool SquadBlackboard::consumeFactValue(ConsumableFact fact, FactValue& out)
+	{
+		std::uint64_t word;
+
+		if (!consume(StateSlot::Value, fact, word))
+			return false;
+
+		out = {bitsFloat(payloadOf(word)), false};
+		return true;
+	}
+
+	bool SquadBlackboard::consumeFactVector(ConsumableFact fact, FactVector& out)
+	{
+		auto& word = words[static_cast<int>(StateSlot::Vector)][static_cast<int>(fact)];
+		auto current = word.load(std::memory_order_acquire);
+
+		while (current & Available)
+		{
+			Math::Vector3 vector;
+
+			//the vector has to be copied before claiming, once claimed it can be produced over
+			if (!readVector(fact, current, vector))
+			{
+				current = word.load(std::memory_order_acquire);
+				continue;
+			}
+
+			if (word.compare_exchange_weak(current, current & ~Available, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				out = FactVector{vector, false};
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	FactFlag SquadBlackboard::readFactFlag(ConsumableFact fact) const
+	{
+		auto word = words[static_cast<int>(StateSlot::Flag)][static_cast<int>(fact)].load(std::memory_order_acquire);
+
+		return {payloadOf(word) != 0, (word & Available) == 0};
+	}
+
+	FactValue SquadBlackboard::readFactValue(ConsumableFact fact) const
+	{
+		auto word = words[static_cast<int>(StateSlot::Value)][static_cast<int>(fact)].load(std::memory_order_acquire);
+
+		return {bitsFloat(payloadOf(word)), (word & Available) == 0};
+	}
+
+	FactVector SquadBlackboard::readFactVector(ConsumableFact fact) const
+	{
+		auto& word = words[static_cast<int>(StateSlot::Vector)][static_cast<int>(fact)];
+		Math::Vector3 vector {0.f, 0.f, 0.f};
+		std::uint64_t current;
+
+		do
+		{
+			current = word.load(std::memory_order_acquire);
+		} while (generationOf(current) != 0 && !readVector(fact, current, vector));
+
+		return FactVector{vector, (current & Available) == 0};
+	}
+
+	std::uint32_t SquadBlackboard::generation(StateSlot slot, ConsumableFact fact) const
+	{
+		return generationOf(words[static_cast<int>(slot)][static_cast<int>(fact)].load(std::memory_order_acquire));
+	}
+}
@@ -0,0 +1,103 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "WorldState.h"
+
+namespace AI
+{
+	/*
+	How a fact is shared with an agent's squad. Private facts stay with the agent, Read facts are
+	known to the whole squad as soon as one member produces them, and Claim facts are leads that
+	exactly one member takes up, eg only one guard goes to check the player's last known location
+	*/
+	enum class FactSharing : std::uint8_t
+	{
+		Private,
+		Read,
+		Claim
+	};
+
+	FactSharing squadSharing(ConsumableFact fact);
+
+	/*
+	Facts shared by a squad of agents, which may be ticking on different threads.
+
+	Each fact slot is a single 64 bit word holding the flag/value, a generation that's bumped
+	every time the fact is produced, and whether it's still available. Reading is one atomic
+	load so it never waits, and consuming is a compare-and-swap that only succeeds while the
+	fact is available, so however many agents try to consume a fact at once exactly one gets it.
+
+	Vectors don't fit in the word, so each one is written to a small ring indexed by its
+	generation before the word is published. Readers only retry if the fact is produced
+	RingSize times while they're copying it. Producing a vector takes a per-fact spin lock
+	(which readers and consumers never touch) so the ring stays in generation order
+	*/
+	class SquadBlackboard
+	{
+	public:
+
+		//produce the fact and make it available again, returning its new generation
+		std::uint32_t produceFactFlag(ConsumableFact fact, bool flag);
+		std::uint32_t produceFactValue(ConsumableFact fact, float value);
+		std::uint32_t produceFactVector(ConsumableFact fact, Math::Vector3 vector);
+
+		//claims the fact if it's available, true (and the fact in out) for only one caller per generation
+		bool consumeFactFlag(ConsumableFact fact, FactFlag& out);
+		bool consumeFactValue(ConsumableFact fact, FactValue& out);
+		bool consumeFactVector(ConsumableFact fact, FactVector& out);
+
+		//the fact as it is now, without claiming it
+		FactFlag readFactFlag(ConsumableFact fact) const;
+		FactValue readFactValue(ConsumableFact fact) const;
+		FactVector readFactVector(ConsumableFact fact) const;
+
+		//0 until the fact is first produced
+		std::uint32_t generation(StateSlot slot, ConsumableFact fact) const;
+
+		static const int RingSize {4};
+
+	private:
+
+		struct VectorEntry
+		{
+			std::atomic<std::uint32_t> generation {0};
+			std::atomic<float> x {0.f};
+			std::atomic<float> y {0.f};
+			std::atomic<float> z {0.f};
+		};
+
+		std::uint32_t produce(StateSlot slot, ConsumableFact fact, std::uint32_t payload);
+		bool consume(StateSlot slot, ConsumableFact fact, std::uint64_t& word);
+		//false if the ring entry for word's generation has already been reused
+		bool readVector(ConsumableFact fact, std::uint64_t word, Math::Vector3& out) const;
+
+		std::atomic<std::uint64_t> words[3][ConsumableFactCount] {};
+		VectorEntry vectors[ConsumableFactCount][RingSize];
+		std::atomic<bool> vectorProducers[ConsumableFactCount] {};
+	};
+}
@@ -0,0 +1,365 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "StateDelta.h"
+#include <cstring>
+
+namespace AI
+{
+	void BitWriter::begin()
+	{
+		bytes.clear();
+		pending = 0;
+		pendingBits = 0;
+	}
+
+	void BitWriter::write(std::uint32_t bits, int count)
+	{
+		auto mask = count == 32 ? ~0ull : (1ull << count) - 1;
+		pending |= (bits & mask) << pendingBits;
+		pendingBits += count;
+
+		while (pendingBits >= 8)
+		{
+			bytes.push_back(static_cast<std::uint8_t>(pending));
+			pending >>= 8;
+			pendingBits -= 8;
+		}
+	}
+
+	void BitWriter::writeFloat(float x)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		write(bits, 32);
+	}
+
+	const std::vector<std::uint8_t>& BitWriter::finish()
+	{
+		if (pendingBits > 0)
+		{
+			bytes.push_back(static_cast<std::uint8_t>(pending));
+			pending = 0;
+			pendingBits = 0;
+		}
+
+		return bytes;
+	}
+
+	std::uint32_t BitReader::read(int count)
+	{
+		while (pendingBits < count)
+		{
+			if (offset == size)
+			{
+				hasFailed = true;
+				return 0;
+			}
+
+			pending |= static_cast<std::uint64_t>(data[offset++]) << pendingBits;
+			pendingBits += 8;
+		}
+
+		auto mask = count == 32 ? ~0ull : (1ull << count) - 1;
+		auto bits = static_cast<std::uint32_t>(pending & mask);
+		pending >>= count;
+		pendingBits -= count;
+
+		return bits;
+	}
+
+	float BitReader::readFloat()
+	{
+		auto bits = read(32);
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+
+	bool same(bool lhs, bool rhs) {return lhs == rhs;}
+	bool same(float lhs, float rhs) {return lhs == rhs;}
+	bool same(const Math::Vector3& lhs, const Math::Vector3& rhs) {return lhs == rhs;}
+	bool same(const FactFlag& lhs, const FactFlag& rhs) {return lhs.flag == rhs.flag && lhs.consumed == rhs.consumed;}
+	bool same(const FactValue& lhs, const FactValue& rhs) {return lhs.value == rhs.value && lhs.consumed == rhs.consumed;}
+	bool same(const FactVector& lhs, const FactVector& rhs) {return lhs.value == rhs.value && lhs.consumed == rhs.consumed;}
+
+	void writeSlot(BitWriter& writer, bool flag) 
+	{
+		writer.write(flag ? 1 : 0, 1);
+	}
+
+	void writeSlot(BitWriter& writer, float value) 
+	{
+		writer.writeFloat(value);
+	}
+
+	void writeSlot(BitWriter& writer, const Math::Vector3& vector)
+	{
+		writer.writeFloat(vector.x);
+		writer.writeFloat(vector.y);
+		writer.writeFloat(vector.z);
+	}
+
+	void writeSlot(BitWriter& writer, const FactFlag& fact)
+	{
+		writeSlot(writer, fact.flag);
+		writeSlot(writer, fact.consumed);
+	}
+
+	void writeSlot(BitWriter& writer, const FactValue& fact)
+	{
+		writeSlot(writer, fact.value);
+		writeSlot(writer, fact.consumed);
+	}
+
+	void writeSlot(BitWriter& writer, const FactVector& fact)
+	{
+		writeSlot(writer, fact.value);
+		writeSlot(writer, fact.consumed);
+	}
+
+	void readSlot(BitReader& reader, bool& flag)
+	{
+		flag = reader.read(1) != 0;
+	}
+
+	void readSlot(BitReader& reader, float& value)
+	{
+		value = reader.readFloat();
+	}
+
+	void readSlot(BitReader& reader, Math::Vector3& vector)
+	{
+		vector.x = reader.readFloat();
+		vector.y = reader.readFloat();
+		vector.z = reader.readFloat();
+	}
+
+	void readSlot(BitReader& reader, FactFlag& fact)
+	{
+		readSlot(reader, fact.flag);
+		readSlot(reader, fact.consumed);
+	}
+
+	void readSlot(BitReader& reader, FactValue& fact)
+	{
+		readSlot(reader, fact.value);
+		readSlot(reader, fact.consumed);
+	}
+
+	void readSlot(BitReader& reader, FactVector& fact)
+	{
+		readSlot(reader, fact.value);
+		readSlot(reader, fact.consumed);
+	}
+
+	template<typename Key, typename Value, int Count>
+	std::uint32_t diffSlots(const EnumMap<Key, Value, Count>& from, const EnumMap<Key, Value, Count>& to)
+	{
+		std::uint32_t changed {0};
+
+		for (int i = 0; i < Count; i++)
+		{
+			auto key = static_cast<Key>(i);
+			auto present = to.contains(key);
+
+			if (present != from.contains(key) || (present && !same(from.at(key), to.at(key))))
+			{
+				changed |= 1u << i;
+			}
+		}
+
+		return changed;
+	}
+
+	StateMask diffState(const State& fromState, const Facts& fromFacts, const State& toState, const Facts& toFacts)
+	{
+		return {diffSlots(fromState.flags, toState.flags), diffSlots(fromState.values, toState.values),
+			diffSlots(fromState.vectors, toState.vectors), diffSlots(fromFacts.flags, toFacts.flags),
+			diffSlots(fromFacts.values, toFacts.values), diffSlots(fromFacts.vectors, toFacts.vectors)};
+	}
+
+	//a bit saying whether any changed, then which ones did, then each one's presence and value
+	template<typename Key, typename Value, int Count>
+	void writeSlots(BitWriter& writer, const EnumMap<Key, Value, Count>& map, std::uint32_t changed)
+	{
+		writer.write(changed != 0 ? 1 : 0, 1);
+
+		if (changed == 0)
+			return;
+
+		writer.write(changed, Count);
+
+		for (int i = 0; i < Count; i++)
+		{
+			if ((changed & (1u << i)) == 0)
+				continue;
+
+			auto key = static_cast<Key>(i);
+			auto present = map.contains(key);
+			writer.write(present ? 1 : 0, 1);
+
+			if (present)
+			{
+				writeSlot(writer, map.at(key));
+			}
+		}
+	}
+
+	template<typename Key, typename Value, int Count>
+	void readSlots(BitReader& reader, EnumMap<Key, Value, Count>& map)
+	{
+		if (reader.read(1) == 0)
+			return;
+
+		auto changed = reader.read(Count);
+
+		for (int i = 0; i < Count && !reader.failed(); i++)
+		{
+			if ((changed & (1u << i)) == 0)
+				continue;
+
+			auto key = static_cast<Key>(i);
+
+			if (reader.read(1) != 0)
+			{
+				readSlot(reader, map[key]);
+			}
+			else
+			{
+				map.erase(key);
+			}
+		}
+	}
+
+	std::uint32_t StateDeltaEncoder::encode(const WorldState& state, BitWriter& writer)
+	{
+		auto sequence = nextSequence++;
+		auto& baseline = history[acknowledged % DeltaHistorySize];
+		//the client forgets baselines at the same rate, past that start again from nothing
+		auto useBaseline = acknowledged != 0 && baseline.sequence == acknowledged 
+			&& sequence - acknowledged < static_cast<std::uint32_t>(DeltaHistorySize);
+
+		static const DeltaBaseline empty {};
+		auto& from = useBaseline ? baseline : empty;
+		auto changed = diffState(from.current, from.facts, state.current, state.facts);
+
+		writer.write(sequence, 32);
+		writer.write(from.sequence, 32);
+		writeSlots(writer, state.current.flags, changed.flags);
+		writeSlots(writer, state.current.values, changed.values);
+		writeSlots(writer, state.current.vectors, changed.vectors);
+		writeSlots(writer, state.facts.flags, changed.factFlags);
+		writeSlots(writer, state.facts.values, changed.factValues);
+		writeSlots(writer, state.facts.vectors, changed.factVectors);
+
+		auto& sent = history[sequence % DeltaHistorySize];
+		sent.sequence = sequence;
+		sent.current = state.current;
+		sent.facts = state.facts;
+
+		return sequence;
+	}
+
+	void StateDeltaEncoder::acknowledge(std::uint32_t sequence)
+	{
+		if (sequence > acknowledged && sequence < nextSequence)
+		{
+			acknowledged = sequence;
+		}
+	}
+
+	std::uint32_t StateDeltaDecoder::apply(BitReader& reader, WorldState& state)
+	{
+		auto sequence = reader.read(32);
+		auto baselineSequence = reader.read(32);
+
+		if (reader.failed() || sequence == 0)
+			return 0;
+
+		//decoded into a scratch copy so a bad packet leaves everything alone
+		DeltaBaseline decoded;
+
+		if (baselineSequence != 0)
+		{
+			auto& baseline = history[baselineSequence % DeltaHistorySize];
+
+			if (baseline.sequence != baselineSequence)
+				return 0;
+
+			decoded = baseline;
+		}
+
+		decoded.sequence = sequence;
+		readSlots(reader, decoded.current.flags);
+		readSlots(reader, decoded.current.values);
+		readSlots(reader, decoded.current.vectors);
+		readSlots(reader, decoded.facts.flags);
+		readSlots(reader, decoded.facts.values);
+		readSlots(reader, decoded.facts.vectors);
+
+		if (reader.failed())
+			return 0;
+
+		history[sequence % DeltaHistorySize] = decoded;
+
+		if (sequence > newest)
+		{
+			newest = sequence;
+			auto changed = diffState(state.current, state.facts, decoded.current, decoded.facts);
+			state.current = decoded.current;
+			state.facts = decoded.facts;
+			state.rehash();
+			state.markChanged(changed);
+		}
+
+		return sequence;
+	}
+
+	void LoopbackChannel::send(const std::vector<std::uint8_t>& packet)
+	{
+		sent++;
+
+		if (dropEvery > 0 && sent % dropEvery == 0)
+			return;
+
+		inFlight.push_back({now + latency, packet});
+	}
+
+	bool LoopbackChannel::receive(std::vector<std::uint8_t>& packet)
+	{
+		if (inFlight.empty() || inFlight.front().arrivesAt > now)
+			return false;
+
+		packet = std::move(inFlight.front().packet);
+		inFlight.pop_front();
+
+		return true;
+	}
+
+	void LoopbackChannel::tick()
+	{
+		now++;
+	}
+}
@@ -0,0 +1,168 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/*
+Per tick deltas of an agent's State and Facts for replicating them to clients. The server
+encodes each tick against the newest state the client acknowledged, so only slots that
+changed since then are sent, and lost packets just mean later deltas are against an older
+baseline. Each delta is bit packed: a mask of the changed slots per kind, then per slot a
+presence bit and, if present, 1 bit for a flag, 32 for a value and 96 for a vector, plus a
+consumed bit for facts.
+*/
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include "WorldState.h"
+
+namespace AI
+{
+	class BitWriter
+	{
+	public:
+
+		//starts a new packet, keeping the buffer's capacity
+		void begin();
+
+		//writes the low count bits of bits, count is at most 32
+		void write(std::uint32_t bits, int count);
+		void writeFloat(float x);
+
+		//pads the last byte and returns the packet
+		const std::vector<std::uint8_t>& finish();
+
+	private:
+
+		std::vector<std::uint8_t> bytes;
+		std::uint64_t pending {0};
+		int pendingBits {0};
+	};
+
+	class BitReader
+	{
+	public:
+
+		BitReader(const std::uint8_t* data, std::size_t size)
+			: data{data}, size{size} {}
+
+		explicit BitReader(const std::vector<std::uint8_t>& packet)
+			: BitReader(packet.data(), packet.size()) {}
+
+		//reading past the end gives 0s and sets failed
+		std::uint32_t read(int count);
+		float readFloat();
+
+		bool failed() const {return hasFailed;}
+
+	private:
+
+		const std::uint8_t* data;
+		std::size_t size;
+		std::size_t offset {0};
+		std::uint64_t pending {0};
+		int pendingBits {0};
+		bool hasFailed {false};
+	};
+
+	//the slots whose presence or value differ between the two
+	StateMask diffState(const State& fromState, const Facts& fromFacts, const State& toState, const Facts& toFacts);
+
+	//how many sent/received states are kept to encode against and decode from
+	const int DeltaHistorySize {32};
+
+	struct DeltaBaseline
+	{
+		std::uint32_t sequence {0};
+		State current;
+		Facts facts;
+	};
+
+	class StateDeltaEncoder
+	{
+	public:
+
+		//encodes state against the newest acknowledged state, returns the sequence it was sent as
+		std::uint32_t encode(const WorldState& state, BitWriter& writer);
+
+		//acknowledgements older than the newest one are ignored
+		void acknowledge(std::uint32_t sequence);
+
+	private:
+
+		DeltaBaseline history[DeltaHistorySize];
+		std::uint32_t nextSequence {1};
+		std::uint32_t acknowledged {0};
+	};
+
+	class StateDeltaDecoder
+	{
+	public:
+
+		/*
+		Applies a delta to state, telling its subscribers which slots changed, and returns the
+		sequence to acknowledge. Returns 0 if the packet is malformed or its baseline has been
+		forgotten. Deltas older than the last applied one are remembered as baselines but
+		don't overwrite state
+		*/
+		std::uint32_t apply(BitReader& reader, WorldState& state);
+
+	private:
+
+		DeltaBaseline history[DeltaHistorySize];
+		std::uint32_t newest {0};
+	};
+
+	/*
+	An in process stand in for a connection, for testing replication without a network.
+	Packets arrive latency ticks after they're sent, and every dropEvery'th one is lost
+	*/
+	class LoopbackChannel
+	{
+	public:
+
+		explicit LoopbackChannel(int latency = 0, int dropEvery = 0)
+			: latency{latency}, dropEvery{dropEvery} {}
+
+		void send(const std::vector<std::uint8_t>& packet);
+		//false once there are no more packets due this tick
+		bool receive(std::vector<std::uint8_t>& packet);
+		void tick();
+
+	private:
+
+		struct InFlight
+		{
+			int arrivesAt;
+			std::vector<std::uint8_t> packet;
+		};
+
+		int latency;
+		int dropEvery;
+		int now {0};
+		int sent {0};
+		std::deque<InFlight> inFlight;
+	};
+}
@@ -26,11 +26,13 @@ SOFTWARE.
 #include "ConditionOpSatisfies.h"
 #include <algorithm>
 #include "Utility.h"
+#include "UtilityBatch.h"
 #include <iostream>
 #include "Animations.h"
 #include "WorldQuerySystem/EnvironmentQueries.h"
 #include "Barker.h"
 #include "HierarchicalTaskNetworkComponent.h"
+#include "log.h"
 
 using namespace Math;
 
@@ -52,7 +54,7 @@ namespace AI
 		Task wait {"wait"};		
 		wait.action = Action::Wait;
 		wait.parameters.vectors.resize(1);
-		wait.setup = [=](Task& task, const WorldState& state, const WorldQuerier&)
+		wait.setup = [=](TaskInstance& task, const WorldState& state, const WorldQuerier&)
 		{
 			//parameters.vectors[0] is {current alarm time, total alarm time, UNUSED}
 			task.parameters.vectors[0].x = 0;
@@ -82,7 +84,7 @@ namespace AI
 		playMontage.parameters.values[0] = static_cast<float>(montage);
 		playMontage.parameters.values[1] = 0; //0 = needs to be started, 1 = already started
 		playMontage.parameters.values[2] = 0; //elapsed time
-		playMontage.setup = [](Task& task, const WorldState& state, const WorldQuerier&)
+		playMontage.setup = [](TaskInstance& task, const WorldState& state, const WorldQuerier&)
 		{
 			//parameters.vectors[0] is {current alarm time, total alarm time, UNUSED}
 			task.parameters.vectors[0].x = 0;
@@ -125,7 +127,7 @@ namespace AI
 		
 		playAnimation.parameters.vectors[2] = {0.f, 0.f, 0.f};
 
-		playAnimation.setup = [](Task& task, const WorldState& state, const WorldQuerier&)
+		playAnimation.setup = [](TaskInstance& task, const WorldState& state, const WorldQuerier&)
 		{
 			task.parameters.vectors[0].x = 0;
 			task.parameters.vectors[0].y = 1;
@@ -141,10 +143,10 @@ namespace AI
 		auto playAnimation = create_PlayAnimation(animation, EAnimationType::BlendSpace);
 		playAnimation.parameters.vectors[0] = {static_cast<float>(worldStateIdX), static_cast<float>(worldStateIdY), 0};
 
-		playAnimation.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		playAnimation.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
-			task.parameters.vectors[1].x = state.current.values[static_cast<WorldStateIdentifier>(FMath::FloorToInt(task.parameters.vectors[0].x))];
-			task.parameters.vectors[1].y = state.current.values[static_cast<WorldStateIdentifier>(FMath::FloorToInt(task.parameters.vectors[0].y))];
+			task.parameters.vectors[1].x = state.current.values.at(static_cast<WorldStateIdentifier>(FMath::FloorToInt(task.parameters.vectors[0].x)));
+			task.parameters.vectors[1].y = state.current.values.at(static_cast<WorldStateIdentifier>(FMath::FloorToInt(task.parameters.vectors[0].y)));
 		};
 
 		return playAnimation;
@@ -154,12 +156,12 @@ namespace AI
 	auto create_PlayBlendAnimation_SourceCalculate(EAnimationId animation, bool calculateOnce, Func&& calculate) -> Task
 	{
 		auto playAnimation = create_PlayAnimation(animation, EAnimationType::BlendSpace);
-		playAnimation.loop = [calculate = std::forward<Func>(calculate), calculateOnce](WorldState& state, WorldQuerier const& worldQuerySystem, Task& task)
+		playAnimation.loop = [calculate = std::forward<Func>(calculate), calculateOnce](WorldState& state, WorldQuerier const& worldQuerySystem, TaskInstance& task)
 		{
 			task.parameters.vectors[2] = calculate(state, worldQuerySystem, task);
 			
 			if (calculateOnce)
-				task.loop = nullptr;
+				task.loopFinished = true;
 		};
 
 		return playAnimation;
@@ -270,7 +272,7 @@ namespace AI
 		auto bark = create_Bark(Bark::RegainedSightOfPlayer);
 		auto move = create_MoveToPlayer();
 
-		move.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		move.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
 			/*auto& target = state.current.vectors[WorldStateIdentifier::PlayerPosition];
 			auto& start = state.current.vectors[WorldStateIdentifier::CurrentPosition];
@@ -312,11 +314,11 @@ namespace AI
 
 		auto moveToLastKnownLocation = create_MoveToDestination(320.f, {0.f, 1.f, 0.f});
 		moveToLastKnownLocation.preconditions.consumableVectors.push_back(ConsumableFact::Player_LastKnownLocation);
-		moveToLastKnownLocation.setup = [=](Task& task, WorldState& state, const WorldQuerier&)
+		moveToLastKnownLocation.setup = [=](TaskInstance& task, WorldState& state, const WorldQuerier&)
 		{
-			state.current.vectors[WorldStateIdentifier::Destination] = state.facts.vectors[ConsumableFact::Player_LastKnownLocation].value;
+			state.setVector(WorldStateIdentifier::Destination, state.facts.vectors.at(ConsumableFact::Player_LastKnownLocation).value);
 		};
-		moveToLastKnownLocation.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		moveToLastKnownLocation.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
 			/*auto& target = state.current.vectors[WorldStateIdentifier::PlayerPosition];
 			auto& start = state.current.vectors[WorldStateIdentifier::CurrentPosition];
@@ -329,7 +331,7 @@ namespace AI
 			*/
 		};
 
-		moveToLastKnownLocation.finish = [](WorldState& state, Task& task)
+		moveToLastKnownLocation.finish = [](WorldState& state, TaskInstance& task)
 		{
 			state.consumeFactVector(ConsumableFact::Player_LastKnownLocation);
 		};
@@ -365,17 +367,17 @@ namespace AI
 		moveAlongHeading.parameters.vectors.push_back({0.f, 0.f, 1.f});
 		moveAlongHeading.preconditions.consumableVectors.push_back(ConsumableFact::Player_ForwardVector);
 		moveAlongHeading.action = Action::MoveToDestination;		
-		moveAlongHeading.setup = [=](Task& task, WorldState& state, const WorldQuerier&)
+		moveAlongHeading.setup = [=](TaskInstance& task, WorldState& state, const WorldQuerier&)
 		{
-			auto& currentPosition = state.current.vectors[WorldStateIdentifier::CurrentPosition];
-			auto playerForwardVector = state.facts.vectors[ConsumableFact::Player_ForwardVector].value;
+			auto& currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
+			auto playerForwardVector = state.facts.vectors.at(ConsumableFact::Player_ForwardVector).value;
 
 			auto destination = currentPosition + playerForwardVector * task.parameters.values[1];
-			state.current.vectors[WorldStateIdentifier::Destination] = destination;
+			state.setVector(WorldStateIdentifier::Destination, destination);
 		};
 
 		moveAlongHeading.postconditions.satisfiedPredicates.push_back({SatisfiablePredicateIdentifier::NearDestination, -1});
-		moveAlongHeading.finish = [](WorldState& state, Task& task)
+		moveAlongHeading.finish = [](WorldState& state, TaskInstance& task)
 		{
 			state.consumeFactVector(ConsumableFact::Player_ForwardVector);
 		};
@@ -398,13 +400,9 @@ namespace AI
 		auto chasePosition = create_ChaseLastKnownPosition();
 		auto chaseHeading = create_ChaseLastKnownHeading();
 
-		tasks.addTask(TaskIdentifier::ChaseSight, chaseSight);
-		tasks.addTask(TaskIdentifier::ChaseLastKnownPosition, chasePosition);
-		//tasks.addTask(TaskIdentifier::ChaseLastKnownHeading, chaseHeading);
-
-		tasks.abstractTaskImplementations[TaskIdentifier::Chase].push_back(chaseSight);
-		tasks.abstractTaskImplementations[TaskIdentifier::Chase].push_back(chasePosition);
-		//tasks.abstractTaskImplementations[TaskIdentifier::Chase].push_back(chaseHeading);
+		tasks.addImplementation(TaskIdentifier::Chase, tasks.addTask(TaskIdentifier::ChaseSight, chaseSight));
+		tasks.addImplementation(TaskIdentifier::Chase, tasks.addTask(TaskIdentifier::ChaseLastKnownPosition, chasePosition));
+		//tasks.addImplementation(TaskIdentifier::Chase, tasks.addTask(TaskIdentifier::ChaseLastKnownHeading, chaseHeading));
 
 		return chase;		
 	}
@@ -510,13 +508,13 @@ namespace AI
 
 		Task lookAt {"lookAt"};
 		lookAt.action = Action::LookAt;		
-		lookAt.setup = [=](Task& task, WorldState& state, const WorldQuerier&)
+		lookAt.setup = [=](TaskInstance& task, WorldState& state, const WorldQuerier&)
 		{
-			auto position = state.current.vectors[WorldStateIdentifier::CurrentPosition];
-			auto noiseDisturbance = state.facts.vectors[ConsumableFact::NoiseDisturbance];
+			auto position = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
+			auto noiseDisturbance = state.facts.vectors.at(ConsumableFact::NoiseDisturbance);
 			noiseDisturbance.value.z = position.z;
 
-			unsigned int locusId = state.facts.values[ConsumableFact::NoiseDisturbance].value;
+			unsigned int locusId = state.facts.values.at(ConsumableFact::NoiseDisturbance).value;
 			auto it = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
 				[=](const FocusLocus& f){return f.id == locusId;});
 
@@ -534,7 +532,7 @@ namespace AI
 		//auto stare = create_Stare();
 		/*auto playMontage = create_PlayMontage(Montage::Stare);
 
-		playMontage.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		playMontage.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
 			auto& curiosity = state.current.values[WorldStateIdentifier::Curiosity];
 			curiosity = FMath::Clamp(curiosity - 0.01f, 0.f, 100.f);
@@ -560,20 +558,20 @@ namespace AI
 		auto bark = create_Bark(Bark::BeginInvestigation);
 
 		auto moveToSound = create_MoveToDestination(200.f, {0.f, 1.f, 0.f});//, 1.f, true, true, 1);
-		moveToSound.setup = [=](Task& task, WorldState& state, const WorldQuerier&)
+		moveToSound.setup = [=](TaskInstance& task, WorldState& state, const WorldQuerier&)
 		{
-			auto currentPosition = state.current.vectors[WorldStateIdentifier::CurrentPosition];
-			unsigned int locusId = state.facts.values[ConsumableFact::Lead].value;
+			auto currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
+			unsigned int locusId = state.facts.values.at(ConsumableFact::Lead).value;
 			auto it = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
 				[=](const FocusLocus& f){return f.id == locusId;});
 
 			if (it != end(state.memory.focusLocus))
 			{
-					state.current.vectors[WorldStateIdentifier::Destination] = Math::Vector3 {it->engrams.back().stimulus.x, it->engrams.back().stimulus.y, currentPosition.z};
+					state.setVector(WorldStateIdentifier::Destination, Math::Vector3 {it->engrams.back().stimulus.x, it->engrams.back().stimulus.y, currentPosition.z});
 			}
 			else
 			{
-				state.current.vectors[WorldStateIdentifier::Destination] = currentPosition;
+				state.setVector(WorldStateIdentifier::Destination, currentPosition);
 				state.consumeFactValue(ConsumableFact::Lead);
 			}
 		};
@@ -583,16 +581,16 @@ namespace AI
 
 		Task lookAround {"lookAround"};
 		lookAround.parameters.vectors.push_back({});
-		lookAround.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		lookAround.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{		
 			/*auto requestId = state.animationDriver->reactionDriver->addReaction({EReactionType::Sight, 50.f, 0.f});
 			task.parameters.vectors[0].x = requestId;*/						
 		};
 
-		lookAround.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		lookAround.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
-			auto& curiosity = state.current.values[WorldStateIdentifier::Curiosity];
-			curiosity = clamp(curiosity - 10.f / 30.f, 0.f, 100.f);
+			auto curiosity = state.current.values.at(WorldStateIdentifier::Curiosity);
+			state.setValue(WorldStateIdentifier::Curiosity, clamp(curiosity - 10.f / 30.f, 0.f, 100.f));
 		};
 
 		lookAround.finally = [](WorldState& state)
@@ -635,10 +633,10 @@ namespace AI
 			state.produceFactFlag(ConsumableFact::HasLead, true);
 		};
 
-		followPath.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		followPath.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
 			//figure out how many repeats we'll need
-			int locusId = state.facts.values[ConsumableFact::NoiseDisturbance].value;
+			int locusId = state.facts.values.at(ConsumableFact::NoiseDisturbance).value;
 			auto it = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
 				[=](const FocusLocus& f){return f.id == locusId;});
 
@@ -681,7 +679,7 @@ namespace AI
 					segments.push_back({ids[i], ids[i+1]});
 				}
 
-				auto currentPosition = state.current.vectors[WorldStateIdentifier::CurrentPosition];
+				auto currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
 
 				auto closestSegment = std::min_element(begin(segments), end(segments),
 					[&](const LineSegment& first, const LineSegment& second)
@@ -717,7 +715,7 @@ namespace AI
 					}
 				}
 
-				state.current.vectors[WorldStateIdentifier::Destination] = {it->engrams[closestSegment->end].stimulus.x, it->engrams[closestSegment->end].stimulus.y, currentPosition.z};
+				state.setVector(WorldStateIdentifier::Destination, {it->engrams[closestSegment->end].stimulus.x, it->engrams[closestSegment->end].stimulus.y, currentPosition.z});
 			}
 		};
 
@@ -737,7 +735,7 @@ namespace AI
 		selectSeat.identifier = TaskIdentifier::FindSeat_PickNearbySeat;
 		selectSeat.parameters.values.push_back(static_cast<float>(DestinationType::AnyNearbySeat));		
 		selectSeat.parameters.vectors.push_back({false, 0, 0});
-		selectSeat.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		selectSeat.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			worldQuerySystem.queryEnvironment(EEnvironmentQueryId::FindNearbySeat, EEnvQueryRunMode::Type::RandomBest25Pct,
 				FQueryFinishedSignature::CreateLambda([&](std::shared_ptr<FEnvQueryResult>& queryResult)
@@ -778,7 +776,7 @@ namespace AI
 		searchArea.parameters.vectors.push_back({false, 0, 0});
 		searchArea.breakConditions.satisfiedPredicates.push_back({SatisfiablePredicateIdentifier::ParameterFlag, 1});//TODO: parameterflag should be customizable by having an index
 
-		searchArea.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		searchArea.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			//std::swap(task.parameters.values[0], task.parameters.values[1]);
 			std::vector<FEnvironmentQueryParameter> parameters;
@@ -788,12 +786,12 @@ namespace AI
 			worldQuerySystem.queryEnvironment(EEnvironmentQueryId::PickRandomLocation, EEnvQueryRunMode::Type::RandomBest25Pct, parameters,			
 				FQueryFinishedSignature::CreateLambda([&](std::shared_ptr<FEnvQueryResult>& queryResult)
 			{
-				state.current.vectors[WorldStateIdentifier::Destination] = queryResult->GetItemAsLocation(0);
+				state.setVector(WorldStateIdentifier::Destination, queryResult->GetItemAsLocation(0));
 				//std::swap(task.parameters.values[0], task.parameters.values[1]);
 			}));
 		};
 
-		searchArea.loop = [](WorldState& state, WorldQuerier const& worldQuerySystem, Task& task)
+		searchArea.loop = [](WorldState& state, WorldQuerier const& worldQuerySystem, TaskInstance& task)
 		{
 			/*worldQuerySystem.queryEnvironmentWithBlackboard(EEnvironmentQueryId::FindNearbySeat, EBlackboardKey::Seat, EEnvQueryRunMode::Type::RandomBest25Pct,
 				[&](std::shared_ptr<FEnvQueryResult>& queryResult)*/
@@ -838,11 +836,8 @@ namespace AI
 		auto pickNearbySeat = create_pickNearbySeat();
 		auto searchAreaForSeat = create_searchAreaForSeat();
 
-		tasks.addTask(TaskIdentifier::FindSeat_PickNearbySeat, pickNearbySeat);
-		tasks.addTask(TaskIdentifier::FindSeat_SearchAreaForSeat, searchAreaForSeat);
-
-		tasks.abstractTaskImplementations[TaskIdentifier::FindSeat].push_back(pickNearbySeat);
-		tasks.abstractTaskImplementations[TaskIdentifier::FindSeat].push_back(searchAreaForSeat);
+		tasks.addImplementation(TaskIdentifier::FindSeat, tasks.addTask(TaskIdentifier::FindSeat_PickNearbySeat, pickNearbySeat));
+		tasks.addImplementation(TaskIdentifier::FindSeat, tasks.addTask(TaskIdentifier::FindSeat_SearchAreaForSeat, searchAreaForSeat));
 
 		findSeat.postconditions.consumableFlags.push_back(ConsumableFact::HasPickedSeat);
 
@@ -861,13 +856,13 @@ namespace AI
 		auto moveToSeat = create_MoveToDestination(70.f, {0.f, 0.5f, 0.5f}, 1.f, false, true, 1);
 		moveToSeat.parameters.vectors.push_back({80.f, 0.f, 0.f});
 		
-		moveToSeat.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		moveToSeat.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			auto seat = Cast<USceneComponent>(state.blackboard->GetValueAsObject(FName {*UEnum::GetValueAsString(TEXT("/Script/WoodenSphere.EBlackboardKey"), EBlackboardKey::Seat)}));
-			state.current.vectors[WorldStateIdentifier::Destination] = seat->GetComponentLocation();
+			state.setVector(WorldStateIdentifier::Destination, seat->GetComponentLocation());
 		};
 
-		moveToSeat.loop = [](WorldState& state, WorldQuerier const& worldQuerySystem, Task& task) 
+		moveToSeat.loop = [](WorldState& state, WorldQuerier const& worldQuerySystem, TaskInstance& task) 
 		{
 			auto& currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition_Feet);
 			auto& destination = state.current.vectors.at(WorldStateIdentifier::Destination);
@@ -909,7 +904,7 @@ namespace AI
 
 		//auto sitDown = create_PlayAnimation(EAnimationId::SitDown, EAnimationType::Animation);
 		Task sitDown;
-		sitDown.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		sitDown.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			state.animationDriver->isSitting = true;
 		};
@@ -932,9 +927,9 @@ namespace AI
 		//relax.addSubtask(sitDown);
 
 		auto m = create_MoveToDestination(70.f, {0.f, 0.5f, 0.5f});
-		m.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		m.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
-			state.current.vectors[WorldStateIdentifier::Destination] = Math::Vector3{4000.f, -4000.f, 20.f};
+			state.setVector(WorldStateIdentifier::Destination, Math::Vector3{4000.f, -4000.f, 20.f});
 		};
 		//relax.addSubtask(m);
 
@@ -959,7 +954,7 @@ namespace AI
 		Task react {"reactDismiss"};
 		react.action = Action::Reaction;		
 		react.parameters.vectors.push_back({});
-		react.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		react.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			auto requestId = state.animationDriver->reactionDriver->addReaction({EReactionType::Dismiss});
 			task.parameters.vectors[0].x = requestId;
@@ -970,7 +965,7 @@ namespace AI
 			}
 		};
 
-		react.finish = [](WorldState& state, Task& task)
+		react.finish = [](WorldState& state, TaskInstance& task)
 		{
 			state.consumeFactFlag(ConsumableFact::LostLead);//HasLead);
 			state.animationDriver->reactionDriver->tracker->stop();
@@ -995,12 +990,12 @@ namespace AI
 		Task react {"foundPlayer"};
 		react.action = Action::Reaction;
 		react.parameters.vectors.push_back({});
-		react.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		react.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{			
 			auto requestId = state.animationDriver->reactionDriver->addReaction({EReactionType::FoundPlayer, FMath::RandBool() ? 25.f : 0.f, 0.f});
 			task.parameters.vectors[0].x = requestId;
 
-			auto& playerLocation = state.current.vectors[WorldStateIdentifier::PlayerPosition];
+			auto& playerLocation = state.current.vectors.at(WorldStateIdentifier::PlayerPosition);
 			auto faceDirectionArgs = calculateFaceDirectionArgs(playerLocation.x, playerLocation.y, worldQuerySystem);
 			state.animationDriver->faceDirection(std::get<0>(faceDirectionArgs), std::get<1>(faceDirectionArgs));
 
@@ -1010,10 +1005,10 @@ namespace AI
 			}
 		};
 
-		react.loop = [](WorldState& state, WorldQuerier const&, Task& task)
+		react.loop = [](WorldState& state, WorldQuerier const&, TaskInstance& task)
 		{
-			auto& target = state.current.vectors[WorldStateIdentifier::PlayerPosition];
-			auto& start = state.current.vectors[WorldStateIdentifier::CurrentPosition];
+			auto& target = state.current.vectors.at(WorldStateIdentifier::PlayerPosition);
+			auto& start = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
 			auto xAxis = target - start;
 			xAxis.normalize();
 			
@@ -1048,7 +1043,7 @@ namespace AI
 		Task react {"lostPlayer"};
 		react.action = Action::Reaction;
 		react.parameters.vectors.push_back({});
-		react.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		react.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{				
 			auto& tracker = state.valueTrackers[WorldStateIdentifier::Alertness];
 			float energy = tracker.maxValue >= 80.f ?
@@ -1059,7 +1054,7 @@ namespace AI
 			task.parameters.vectors[0].x = requestId;
 		};
 
-		react.finally = [](WorldState& state)//, Task& task)
+		react.finally = [](WorldState& state)//, TaskInstance& task)
 		{
 			state.consumeFactFlag(ConsumableFact::HasLead);
 			state.animationDriver->reactionDriver->tracker->stop();
@@ -1084,7 +1079,7 @@ namespace AI
 		Task react {"reactSight"};
 		react.action = Action::Reaction;
 		react.parameters.vectors.push_back({});
-		react.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		react.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			//TODO: change to react task
 			//abort reaction, face, wait for face to end
@@ -1094,7 +1089,7 @@ namespace AI
 			task.parameters.vectors[0].x = requestId;			
 			
 			auto locus = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
-				[id = FMath::RoundToInt(state.facts.values[ConsumableFact::Glimpse].value)]
+				[id = FMath::RoundToInt(state.facts.values.at(ConsumableFact::Glimpse).value)]
 				(auto& l) {return l.id == id;});
 			
 			auto faceDirectionArgs = calculateFaceDirectionArgs(locus->engrams[0].saw.x, locus->engrams[0].saw.y, worldQuerySystem);
@@ -1135,7 +1130,7 @@ namespace AI
 		Task react {"reactSound"};
 		react.action = Action::Reaction;
 		react.parameters.vectors.push_back({});
-		react.setup = [](Task& task, WorldState& state, WorldQuerier const& worldQuerySystem)
+		react.setup = [](TaskInstance& task, WorldState& state, WorldQuerier const& worldQuerySystem)
 		{
 			/*
 			figure out the direction the sound came from, convert it to use the reaction blendspace's range of 0-100
@@ -1153,7 +1148,7 @@ namespace AI
 			*/
 			
 			auto locus = std::find_if(begin(state.memory.focusLocus), end(state.memory.focusLocus), 
-				[id = FMath::RoundToInt(state.facts.values[ConsumableFact::NoiseDisturbance].value)]
+				[id = FMath::RoundToInt(state.facts.values.at(ConsumableFact::NoiseDisturbance).value)]
 			(auto& l) {return l.id == id;});
 			
 			if (locus == end(state.memory.focusLocus) || locus->engrams.empty())
@@ -1205,10 +1200,10 @@ namespace AI
 		Task trackHead {"trackHead"};
 		trackHead.preconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
 
-		trackHead.loop = [](WorldState& state, WorldQuerier const& worldQuerySystem, Task& task)
+		trackHead.loop = [](WorldState& state, WorldQuerier const& worldQuerySystem, TaskInstance& task)
 		{
-			auto& target = state.current.vectors[WorldStateIdentifier::PlayerPosition];
-			auto& start = state.current.vectors[WorldStateIdentifier::CurrentPosition];
+			auto& target = state.current.vectors.at(WorldStateIdentifier::PlayerPosition);
+			auto& start = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
 			auto xAxis = target - start;
 			xAxis.normalize();
 			
@@ -1246,7 +1241,7 @@ namespace AI
 		//tasks.satisfiablePredicates.reserve(numberOfPredicates);
 
 		tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::NearPlayer,
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
 			auto& currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition);
 			auto& destination = state.current.vectors.at(WorldStateIdentifier::PlayerPosition);
@@ -1255,7 +1250,7 @@ namespace AI
 		}});
 
 		tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::NearDestination,
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
 			auto& currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition_Feet);
 			auto& destination = state.current.vectors.at(WorldStateIdentifier::Destination);
@@ -1264,58 +1259,58 @@ namespace AI
 
 			if (parameterIndex != -1)
 			{
-				minimumDistance = task.parameters.vectors[parameterIndex].x;
+				minimumDistance = parameters.vectors[parameterIndex].x;
 			}
 			
 			return distanceSquared(currentPosition, destination) < minimumDistance;
 		}});
 
 		/*tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::NearActor,
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
 			auto& currentPosition = state.current.vectors.at(WorldStateIdentifier::CurrentPosition_Feet);
 
-			auto& parameters = task.parameters.vectors[parameterIndex];
-			EBlackboardKey blackboardKey {static_cast<EBlackboardKey>(FMath::RoundToInt(parameters.x))};
+			auto& vector = parameters.vectors[parameterIndex];
+			EBlackboardKey blackboardKey {static_cast<EBlackboardKey>(FMath::RoundToInt(vector.x))};
 			auto destination = Cast<Actor>(state.blackboard->GetValueAsObject({*UEnum::GetValueAsString(TEXT("/Script/WoodenSphere.EBlackboardKey"), blackboardKey)}))->GetActorLocation();
 
 			float minimumDistance = 50000.f;
 
 			if (parameterIndex != -1)
 			{
-				minimumDistance = task.parameters.vectors[parameterIndex].y;
+				minimumDistance = parameters.vectors[parameterIndex].y;
 			}
 			
 			return distanceSquared(currentPosition, destination) < minimumDistance;
 		}});*/
 
 		tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::TimeElapsed,			
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
-			auto& parameters = task.parameters.vectors[parameterIndex];
-			return parameters.x >= parameters.y;
+			auto& vector = parameters.vectors[parameterIndex];
+			return vector.x >= vector.y;
 		}});
 
 		tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::ParameterFlag,
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
-			auto& parameters = task.parameters.vectors[parameterIndex];
-			return parameters.x != 0;
+			auto& vector = parameters.vectors[parameterIndex];
+			return vector.x != 0;
 		}});
 
 		/*tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::Blackboard_ValueNotNull,
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
-			auto& parameters = task.parameters.vectors[parameterIndex];
-			EBlackboardKey blackboardKey {static_cast<EBlackboardKey>(FMath::RoundToInt(parameters.x))};
+			auto& vector = parameters.vectors[parameterIndex];
+			EBlackboardKey blackboardKey {static_cast<EBlackboardKey>(FMath::RoundToInt(vector.x))};
 			return state.blackboard->GetValueAsObject({*UEnum::GetValueAsString(TEXT("/Script/WoodenSphere.EBlackboardKey"), blackboardKey)}) != nullptr;
 		}});*/
 
 		/*tasks.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::ReactionFinished,
-			[](const WorldState& state, const Task& task, int parameterIndex)
+			[](const WorldState& state, const TaskParameters& parameters, int parameterIndex)
 		{
-			auto& parameters = task.parameters.vectors[parameterIndex];
-			return state.animationDriver->reactionDriver->tracker->getRequestId() == FMath::RoundToInt(parameters.x)
+			auto& vector = parameters.vectors[parameterIndex];
+			return state.animationDriver->reactionDriver->tracker->getRequestId() == FMath::RoundToInt(vector.x)
 				&& state.animationDriver->reactionDriver->tracker->reactionHasFinished();
 		}});*/
 
@@ -1323,7 +1318,7 @@ namespace AI
 
 	bool operator==(const TaskVertex& lhs, const TaskVertex& rhs)
 	{
-		return lhs.identifier == rhs.identifier;
+		return lhs.id == rhs.id;
 	}
 
 	bool areAdjacent(Task& a, Task& b)
@@ -1428,34 +1423,270 @@ namespace AI
 		return false;
 	}
 
-	void TaskDatabase::addTask(TaskIdentifier identifier, Task task)
+	//subtasks are copied into plans along with their parent, so their conditions get compiled too
+	void compileConditions(Task& task, const std::vector<SatisfiablePredicate>& satisfiablePredicates)
+	{
+		task.preconditions.compile(satisfiablePredicates);
+		task.postconditions.compile(satisfiablePredicates);
+		task.breakConditions.compile(satisfiablePredicates);
+
+		for (auto& subtask : task.subtasks)
+		{
+			compileConditions(subtask, satisfiablePredicates);
+		}
+	}
+
+	bool hasTooManyParameters(const Task& task)
+	{
+		if (task.parameters.overflowed())
+		{
+			log("[TaskDatabase] ", "ERROR: ", task.debugName, " has more than ", MaxTaskParameters, " parameters of one kind");
+			return true;
+		}
+
+		return std::any_of(begin(task.subtasks), end(task.subtasks), hasTooManyParameters);
+	}
+
+	int TaskDatabase::addTask(TaskIdentifier identifier, Task task)
 	{
+		//its parameters were truncated, running it would read the wrong ones
+		if (hasTooManyParameters(task))
+		{
+			return -1;
+		}
+
 		task.identifier = identifier;
+		task.vertexId = taskGraph.size();
+		task.preconditions.pack();
+		task.postconditions.pack();
+		task.breakConditions.pack();
+		compileConditions(task, satisfiablePredicates);
 
-		tasks[identifier] = task;
-		//TODO: add unique vertex id here
 		TaskVertex newVertex;
 		newVertex.identifier = identifier;
+		newVertex.id = task.vertexId;
 
 		for(auto& vertex : taskGraph)
 		{
-			if (areAdjacent(tasks[vertex.identifier], task))
+			if (areAdjacent(taskInstances[vertex.id], task))
 			{
-				vertex.adjacentTasks.push_back(task.identifier);
+				vertex.adjacentTasks.push_back(newVertex.id);
 			}
 
-			if (areAdjacent(task, tasks[vertex.identifier]))
+			if (areAdjacent(task, taskInstances[vertex.id]))
 			{
-				newVertex.adjacentTasks.push_back(vertex.identifier);
+				newVertex.adjacentTasks.push_back(vertex.id);
 			}
 		}
 
+		TaskRequirements requirements {task.preconditions.packed.requirementMask(), task.postconditions.packed.requirementMask()};
+
+		for (auto& flag : task.modifiedFlags)
+		{
+			requirements.modifiedFlags |= 1u << static_cast<int>(flag.first);
+		}
+
+		for (auto& value : task.modifiedValues)
+		{
+			requirements.modifiedValues |= 1u << static_cast<int>(value.first);
+		}
+
+		taskRequirements.push_back(requirements);
+		tasks[identifier] = task;
+		taskInstances.push_back(std::move(task));
 		taskGraph.push_back(newVertex);
+		revision++;
+
+		return newVertex.id;
+	}
+
+	void TaskDatabase::addImplementation(TaskIdentifier abstractTask, int vertexId)
+	{
+		if (vertexId < 0)
+		{
+			return;
+		}
+
+		abstractTaskImplementations[abstractTask].push_back(taskInstances[vertexId]);
+		revision++;
 	}
 
-	TaskDatabase setupTasks()
+	void TaskDatabase::bakeResponseCurves(float maxError)
+	{
+		for (auto& taskConsiderations : considerations)
+		{
+			for (auto& consideration : taskConsiderations.second)
+			{
+				consideration.bakedFunction = bakeResponseCurve(consideration.function, maxError);
+			}
+		}
+	}
+
+	void TaskDatabase::findConsiderationInputs()
+	{
+		considerationInputs.clear();
+
+		for (auto& taskConsiderations : considerations)
+		{
+			auto& taskInputs = considerationInputs[taskConsiderations.first];
+
+			for (auto& consideration : taskConsiderations.second)
+			{
+				consideration.inputs = findInputs(consideration);
+				taskInputs = taskInputs | consideration.inputs;
+			}
+		}
+	}
+
+	ConsiderationInputs findInputs(const Consideration& consideration)
+	{
+		ConsiderationInputs inputs;
+		auto bit = [](auto key) {return 1u << static_cast<int>(key);};
+
+		switch (consideration.type)
+		{
+			case ConsiderationType::Repeat: inputs.sources = inputs.sources | InputSource::TaskHistory; break;
+			case ConsiderationType::Scalar: inputs.slots.values = bit(consideration.scalar.identifier); break;
+			case ConsiderationType::Flag: inputs.slots.flags = bit(consideration.flag.identifier); break;
+			case ConsiderationType::Distance:
+			{
+				inputs.slots.vectors = bit(consideration.distance.from) | bit(consideration.distance.to);
+				break;
+			}
+			case ConsiderationType::ConsumableFlag: inputs.slots.factFlags = bit(consideration.consumableFlag.fact); break;
+			case ConsiderationType::ConsumableValue: inputs.slots.factValues = bit(consideration.consumableValue.fact); break;
+			case ConsiderationType::ConsumableVector: inputs.slots.factVectors = bit(consideration.consumableVector.fact); break;
+			//always scores 0 for now
+			case ConsiderationType::AuditoryStimulus: break;
+			case ConsiderationType::Predicate: inputs.sources = inputs.sources | InputSource::Always; break;
+			case ConsiderationType::ValueOverTimeTracker: inputs.sources = inputs.sources | InputSource::ValueTrackers; break;
+			case ConsiderationType::LocusImportance:
+			{
+				inputs.slots.factValues = bit(consideration.locusImportance.factContainingLocusId);
+				inputs.sources = inputs.sources | InputSource::FocusLoci;
+				break;
+			}
+			case ConsiderationType::LocusAge:
+			{
+				inputs.slots.factValues = bit(consideration.locusAge.factContainingLocusId);
+				inputs.sources = inputs.sources | InputSource::FocusLoci;
+				break;
+			}
+		}
+
+		return inputs;
+	}
+
+	void TaskDatabase::boundResponses()
+	{
+		for (auto& taskConsiderations : considerations)
+		{
+			for (auto& consideration : taskConsiderations.second)
+			{
+				auto inputs = inputBounds(consideration);
+				consideration.bounds = responseBounds(consideration.function, inputs.min, inputs.max, &consideration.bakedFunction);
+			}
+		}
+	}
+
+	void TaskDatabase::buildRelaxedGraph()
+	{
+		auto vertexCount = static_cast<int>(taskGraph.size());
+		relaxedGraph.vertices.clear();
+		relaxedGraph.stepsToAbstract.assign(vertexCount, std::numeric_limits<int>::max());
+		relaxedGraph.achievable = 0;
+
+		//the search runs from a vertex to its adjacent tasks, so steps spread the other way
+		std::vector<std::vector<int>> predecessors(vertexCount);
+		//breadth first from every abstract task at once
+		std::vector<int> queue;
+
+		for (int vertex = 0; vertex < vertexCount; vertex++)
+		{
+			for (auto adjacentVertex : taskGraph[vertex].adjacentTasks)
+			{
+				predecessors[adjacentVertex].push_back(vertex);
+			}
+
+			if (abstractTaskImplementations.count(taskInstances[vertex].identifier) > 0)
+			{
+				relaxedGraph.stepsToAbstract[vertex] = 0;
+				queue.push_back(vertex);
+			}
+
+			if (!taskInstances[vertex].preconditions.packed.contradictory)
+			{
+				relaxedGraph.vertices.push_back(vertex);
+				relaxedGraph.achievable |= taskRequirements[vertex].postconditions;
+			}
+		}
+
+		for (std::size_t i = 0; i < queue.size(); i++)
+		{
+			auto steps = relaxedGraph.stepsToAbstract[queue[i]] + 1;
+
+			for (auto vertex : predecessors[queue[i]])
+			{
+				if (steps < relaxedGraph.stepsToAbstract[vertex])
+				{
+					relaxedGraph.stepsToAbstract[vertex] = steps;
+					queue.push_back(vertex);
+				}
+			}
+		}
+
+		relaxedGraph.revision = revision;
+	}
+
+	float trackerInput(const ValueOverTimeTracker& tracker, ValueOverTimeTracker_Property property)
+	{
+		switch (property)
+		{
+			case ValueOverTimeTracker_Property::MaxValue: return tracker.maxValue;
+			case ValueOverTimeTracker_Property::DurationBelowValue: return tracker.durationBelowValue;
+			case ValueOverTimeTracker_Property::Reacted: return tracker.reacted ? 1.f : 0.f;
+			case ValueOverTimeTracker_Property::DurationExceedsExtension: return tracker.durationExceedsExtension() ? 1.f : 0.f;
+			default: return 0.f;
+		}
+	}
+
+	ScoreBounds inputBounds(const Consideration& consideration)
+	{
+		switch (consideration.type)
+		{
+			//taskHistory holds at most 10 tasks (see updateTaskHistory), scaled down by 10
+			case ConsiderationType::Repeat: return {0.1f, 1.f};
+			case ConsiderationType::Flag: 
+			case ConsiderationType::ConsumableFlag:
+			case ConsiderationType::ConsumableValue:
+			case ConsiderationType::ConsumableVector:
+			case ConsiderationType::Predicate:
+				return {0.f, 1.f};
+			case ConsiderationType::AuditoryStimulus: return {0.f, 0.f};
+			case ConsiderationType::Distance: return {0.f, std::numeric_limits<float>::infinity()};
+			case ConsiderationType::ValueOverTimeTracker:
+			{
+				auto property = consideration.valueTracker.trackerProperty;
+
+				if (property == ValueOverTimeTracker_Property::Reacted
+					|| property == ValueOverTimeTracker_Property::DurationExceedsExtension)
+				{
+					return {0.f, 1.f};
+				}
+
+				return {};
+			}
+			default: 
+				return {};
+		}
+	}
+
+	TaskDatabase setupTasks(float bakedCurveMaxError)
 	{
 		TaskDatabase tasks;
+
+		//before any tasks so their conditions are compiled with the predicates' functions
+		setupPredicates(tasks);
 		
 		tasks.addTask(TaskIdentifier::Browse, create_Browse());
 		tasks.addTask(TaskIdentifier::Wander, create_Wander());
@@ -1477,8 +1708,10 @@ namespace AI
 		tasks.addTask(TaskIdentifier::Null, create_Null());
 
 		//copyConsiderations(availableUTasks, tasks);
-		
-		setupPredicates(tasks);
+		tasks.bakeResponseCurves(bakedCurveMaxError);
+		tasks.findConsiderationInputs();
+		tasks.boundResponses();
+		tasks.buildRelaxedGraph();
 
 		return tasks;
 
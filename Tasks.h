@@ -111,15 +111,86 @@ namespace AI
 		Recursive
 	};
 
+	/*
+	A vector that never allocates, it holds at most Capacity elements. Tasks only ever store
+	a handful of parameters, keeping them inline lets a plan copy a task's parameters without
+	touching the heap. Anything past Capacity is dropped and overflowed is set, TaskDatabase::addTask
+	refuses tasks whose parameters overflowed
+	*/
+	template<typename T, int Capacity>
+	struct FixedVector
+	{
+		T elements[Capacity] {};
+		int count {0};
+		bool overflowed {false};
+
+		void push_back(const T& value)
+		{
+			if (count == Capacity)
+			{
+				overflowed = true;
+				return;
+			}
+
+			elements[count++] = value;
+		}
+
+		//new elements are value initialized
+		void resize(int size)
+		{
+			if (size > Capacity)
+			{
+				overflowed = true;
+				size = Capacity;
+			}
+
+			for (int i = count; i < size; i++)
+			{
+				elements[i] = T {};
+			}
+
+			count = size;
+		}
+
+		int size() const {return count;}
+		bool empty() const {return count == 0;}
+
+		T& operator[](int index) {return elements[index];}
+		const T& operator[](int index) const {return elements[index];}
+
+		T* begin() {return elements;}
+		T* end() {return elements + count;}
+		const T* begin() const {return elements;}
+		const T* end() const {return elements + count;}
+	};
+
+	const int MaxTaskParameters = 4;
+
 	//stores instance specific parameters for Tasks
 	//eg you can define a Walk task, and create two copies of it with different speed parameters
 	struct TaskParameters
 	{
-		std::vector<Math::Vector3> vectors;
-		std::vector<float> values;
-		std::vector<bool> flags;
+		FixedVector<Math::Vector3, MaxTaskParameters> vectors;
+		FixedVector<float, MaxTaskParameters> values;
+		FixedVector<bool, MaxTaskParameters> flags;
+
+		//true if a task definition tried to store more than MaxTaskParameters of something
+		bool overflowed() const {return vectors.overflowed || values.overflowed || flags.overflowed;}
 	};	
 
+	/*
+	The parts of a Task that change while it runs. Tasks in a plan are shared between every agent
+	using that plan, so each Plan keeps one of these per task and the callbacks only get to modify it
+	*/
+	struct TaskInstance
+	{
+		TaskParameters parameters;
+		int remainingRepeats {0};
+		bool failed {false};
+		//set by a loop that only needs to run once
+		bool loopFinished {false};
+	};
+
 	struct Task
 	{		
 		Task(std::string debugName, TaskType type = TaskType::Simple)
@@ -140,9 +211,10 @@ namespace AI
 		std::vector<Task> subtasks;
 		
 		int parentTaskIndex {-1};
+		//the vertex this task was added as by TaskDatabase::addTask, -1 if it wasn't
+		int vertexId {-1};
 		//how many times we can repeat this task(and its subtasks) in a loop
 		int maxRepeats{ 0 };		
-		int remainingRepeats{ 0 };
 
 		std::map<WorldStateIdentifier, bool> modifiedFlags;
 		std::map<WorldStateIdentifier, float> modifiedValues;
@@ -152,28 +224,28 @@ namespace AI
 		TaskIdentifier identifier {TaskIdentifier::Null};
 
 		//called once when starting this task		
-		std::function<void(Task&, WorldState&, class WorldQuerier const&)> setup;
+		std::function<void(TaskInstance&, WorldState&, class WorldQuerier const&)> setup;
 		
 		//called once when the task successfully finishes
-		std::function<void(WorldState&, Task&)> finish;	
+		std::function<void(WorldState&, TaskInstance&)> finish;	
 
 		//guaranteed to called once when switching away from this task, either
 		//because it finished or failed
 		std::function<void(WorldState&)> finally;
 
 		//called once per frame
-		std::function<void(WorldState&, WorldQuerier const&, Task&)> loop;
+		std::function<void(WorldState&, WorldQuerier const&, TaskInstance&)> loop;
 
 		std::string debugName;
 
 		bool isImmediate{ false };
 		bool isLastInCompound{ false };
-		bool failed {false};
 
 		void addSubtask(Task& task);
 
 		//store instance specitic task params here.
 		//eg: for a walk task, speed could be stored here
+		//these are the starting values, a running task reads and writes its TaskInstance's copy
 		TaskParameters parameters;
 	};
 
@@ -182,19 +254,40 @@ namespace AI
 	struct TaskVertex
 	{
 		TaskIdentifier identifier;
-		std::vector<TaskIdentifier> adjacentTasks;
+		//dense index into TaskDatabase::taskGraph and taskInstances, every added task gets its own
+		//so several instances can share a TaskIdentifier
+		int id {-1};
+		//ids of the adjacent vertices
+		std::vector<int> adjacentTasks;
 	};
 
 	bool operator==(const TaskVertex& lhs, const TaskVertex& rhs);
 
+	/*
+	Holds the predicates of every FMergedCondition made during a search, so extending
+	a chain appends to one buffer instead of allocating per node. Reset between searches.
+	*/
+	struct MergedPredicateArena
+	{
+		std::vector<MergedSatisfiablePredicateParams> predicates;
+
+		void reset();
+	};
+
+	/*
+	The requirements left over while the planner works backwards from a goal,
+	ie the preconditions of a chain of tasks minus whatever the chain satisfies itself
+	*/
 	struct FMergedCondition
 	{
-		Condition condition;
+		PackedCondition condition;
 
-		std::vector<MergedSatisfiablePredicateParams> satisfiedPredicates;
-		std::vector<Task> tasks;
+		//the predicates in condition.predicates, as a range of MergedPredicateArena::predicates
+		int firstPredicate {0};
+		int predicateCount {0};
 
-		bool isTrue(const WorldState& state, const Task& task, const std::vector<SatisfiablePredicate>& satisfiablePredicates);
+		bool isTrue(const WorldState& state, const MergedPredicateArena& arena, const std::vector<Task>& taskInstances, 
+			const std::vector<SatisfiablePredicate>& satisfiablePredicates) const;
 	};
 
 }
\ No newline at end of file
@@ -23,6 +23,14 @@ SOFTWARE.
 */
 
 #include "UE_Replacements.h"
+#include "Planner.h"
+#include "PlanWorkers.h"
+#include "AgentStateTable.h"
+#include "Recording.h"
+#include "SquadBlackboard.h"
+#include <thread>
+#include <algorithm>
+#include <random>
 #include "log.h"
 
 using namespace Math;
@@ -60,6 +68,16 @@ namespace AI
         return {transform.m[4], transform.m[5], transform.m[6]};
     }
 
+    void Actor::setActorTransform(const Math::Transform& newTransform)
+    {
+        if (auto recorder = world->getAuthGameMode()->getRecorder())
+        {
+            recorder->recordTransform(id, newTransform);
+        }
+
+        transform = newTransform;
+    }
+
     std::string Actor::getName() const
     {
         return name;
@@ -100,11 +118,27 @@ namespace AI
         return raw;
     }
 
+    Actor* World::findActor(int id)
+    {
+        auto it = std::find_if(actors.begin(), actors.end(), [=](auto& actor) {return actor->getId() == id;});
+
+        return it != actors.end() ? it->get() : nullptr;
+    }
+
     GameMode::GameMode()
+        : planCache{std::make_unique<PlanCache>()},
+          agentStates{std::make_unique<AgentStateTable>()},
+          seed{std::random_device{}()}
     {
         taskDatabase = setupTasks();
+
+        //leave a core for the game thread
+        auto threadCount = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+        planWorkers = std::make_unique<PlanWorkerPool>(std::max(0, threadCount));
     }
 
+    GameMode::~GameMode() = default;
+
     void GameMode::registerForFixedTicks(IFixedTickable* tickable)
     {
         tickables.push_back(tickable);
@@ -115,23 +149,99 @@ namespace AI
         return taskDatabase;
     }
     
+    PlanCache& GameMode::getPlanCache()
+    {
+        return *planCache;
+    }
+
+    PlanWorkerPool& GameMode::getPlanWorkers()
+    {
+        return *planWorkers;
+    }
+
+    AgentStateTable& GameMode::getAgentStates()
+    {
+        return *agentStates;
+    }
+
     SoundMap& GameMode::getSoundMap()
     {
         return soundMap;
     }
         
+    SquadBlackboard& GameMode::getSquadBlackboard(int squad)
+    {
+        while (static_cast<int>(squadBlackboards.size()) <= squad)
+        {
+            squadBlackboards.push_back(std::make_unique<SquadBlackboard>());
+        }
+
+        return *squadBlackboards[squad];
+    }
+
     std::string GameMode::getBarkString(enum Bark bark)
     {
         return "";
     }
 
-    void GameMode::tick()
+    void GameMode::injectSound(Math::Vector2<float> position, float intensity, AuditoryTag tag)
+    {
+        if (recorder)
+        {
+            recorder->recordSound(position, intensity, tag);
+        }
+
+        soundMap.injectSound(position, intensity, tag);
+    }
+
+    void GameMode::setSeed(std::uint32_t newSeed)
+    {
+        seed = newSeed;
+        seedsMade = 0;
+    }
+
+    std::uint32_t GameMode::makeSeed()
+    {
+        std::seed_seq sequence {seed, seedsMade++};
+        std::uint32_t made;
+        sequence.generate(&made, &made + 1);
+
+        return made;
+    }
+
+    void GameMode::setPlanWorkerCount(int threadCount)
+    {
+        planWorkers = std::make_unique<PlanWorkerPool>(threadCount);
+    }
+
+    void GameMode::setBakedCurveMaxError(float maxError)
+    {
+        taskDatabase.bakeResponseCurves(maxError);
+        taskDatabase.boundResponses();
+    }
+
+    void GameMode::startRecording()
+    {
+        setPlanWorkerCount(0);
+        recorder = std::make_unique<TickRecorder>();
+        recorder->begin(seed);
+    }
+
+    void GameMode::tick(float dt)
     {
         //TODO: fixed ticking
 
+        //every agent's emotional state is updated together, each agent picks up its row when it ticks
+        agentStates->tickEmotionalState(dt);
+
         for(auto& tickable : tickables)
         {
-            tickable->fixedTick(1.f/60.f);
+            tickable->fixedTick(dt);
+        }
+
+        if (recorder)
+        {
+            recorder->recordTick(dt, agentStates->checksum());
         }
     }
 
@@ -34,6 +34,9 @@ SOFTWARE.
 
 namespace AI
 {
+    class TickRecorder;
+    class SquadBlackboard;
+
     /*
     Replaces AActor
     */
@@ -53,13 +56,31 @@ namespace AI
         std::string getName() const;
         int getId() const {return id;}
 
+        //records the move if the game mode is recording
+        void setActorTransform(const Math::Transform& newTransform);
+
         //takes ownership of the component
         class Component* addComponent(std::unique_ptr<Component> component);
 
+        //the first component of type T, nullptr if there isn't one
+        template<typename T>
+        T* findComponent()
+        {
+            for (auto& component : components)
+            {
+                if (auto found = dynamic_cast<T*>(component.get()))
+                {
+                    return found;
+                }
+            }
+
+            return nullptr;
+        }
+
     private:
 
         World* world;
-        Math::Transform transform;
+        Math::Transform transform {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
         int id;
         std::string name;
         std::vector<std::unique_ptr<Component>> components;
@@ -70,6 +91,7 @@ namespace AI
     public:
 
         Component(Actor* owner);
+        virtual ~Component() = default;
 
         class World* getWorld();
 
@@ -96,6 +118,8 @@ namespace AI
         WorldIterator end() {return actors.end();}
 
         Actor* createActor();
+        //nullptr if there's no actor with that id
+        Actor* findActor(int id);
 
         Actor* getPlayer() {return player;}
 
@@ -103,7 +127,7 @@ namespace AI
 
         GameMode* authGameMode;
         std::vector<std::unique_ptr<Actor>> actors;
-        Actor* player;
+        Actor* player {nullptr};
         int nextActorId {0};
     };
 
@@ -115,19 +139,56 @@ namespace AI
     public:
 
         GameMode();
+        ~GameMode();
 
         void registerForFixedTicks(IFixedTickable* thing);
         TaskDatabase& getAvailableTasks();
+        class PlanCache& getPlanCache();
+        class PlanWorkerPool& getPlanWorkers();
+        class AgentStateTable& getAgentStates();
         SoundMap& getSoundMap();
+        //made on first use, which isn't thread safe, get every squad's blackboard while setting up
+        class SquadBlackboard& getSquadBlackboard(int squad);
         std::string getBarkString(enum Bark bark);
 
-        void tick();
+        //SoundMap::injectSound, recorded if recording
+        void injectSound(Math::Vector2<float> position, float intensity, AuditoryTag tag);
+
+        /*
+        Every agent's random engine is seeded from makeSeed, which is repeatable for a given seed.
+        The seed is random unless set, set it before making any agents
+        */
+        std::uint32_t getSeed() const {return seed;}
+        void setSeed(std::uint32_t newSeed);
+        std::uint32_t makeSeed();
+
+        //0 plans on the game thread
+        void setPlanWorkerCount(int threadCount);
+
+        //scores curves from tables within maxError of their formulas, 0 (the default) scores them exactly.
+        //Scores agents already cached keep the old curves until their inputs change, set it before making agents
+        void setBakedCurveMaxError(float maxError);
+
+        //records every tick from now on, see Recording.h. Switches planning to the game thread
+        void startRecording();
+        //nullptr when not recording
+        class TickRecorder* getRecorder() {return recorder.get();}
+
+        void tick(float dt = 1.f/60.f);
 
     private:
 
         std::vector<IFixedTickable*> tickables;
         TaskDatabase taskDatabase;
+        std::unique_ptr<PlanCache> planCache;
+        //declared after planCache so the workers are stopped before the cache goes away
+        std::unique_ptr<PlanWorkerPool> planWorkers;
+        std::unique_ptr<AgentStateTable> agentStates;
         SoundMap soundMap;
+        std::vector<std::unique_ptr<SquadBlackboard>> squadBlackboards;
+        std::uint32_t seed;
+        std::uint32_t seedsMade {0};
+        std::unique_ptr<TickRecorder> recorder;
     };
 
     /*
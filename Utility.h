@@ -29,11 +29,50 @@ SOFTWARE.
 
 namespace AI
 {
+	/*
+	A task's conditions as requirement masks (see RequirementCount), together these
+	make the relaxed planning graph the planner's heuristic is computed from.
+	The modified masks have bit n set if the task's modifiedFlags/modifiedValues
+	write WorldStateIdentifier n
+	*/
+	struct TaskRequirements
+	{
+		std::uint64_t preconditions {0};
+		std::uint64_t postconditions {0};
+		std::uint32_t modifiedFlags {0};
+		std::uint32_t modifiedValues {0};
+	};
+
+	/*
+	What the RelaxedMaxCost heuristic needs from the task graph that doesn't depend on the state,
+	see TaskDatabase::buildRelaxedGraph. Covers every task rather than only those reachable from
+	some goal, which can only make the estimates lower
+	*/
+	struct RelaxedTaskGraph
+	{
+		//vertices whose preconditions aren't contradictory, the only ones that can ever run
+		std::vector<int> vertices;
+		/*
+		per vertex, the fewest tasks before a chain from it reaches an abstract task, whose
+		implementation's preconditions start over. std::numeric_limits<int>::max() if it never does
+		*/
+		std::vector<int> stepsToAbstract;
+		//requirements some task's postconditions can make true
+		std::uint64_t achievable {0};
+		//the TaskDatabase revision this was built for
+		int revision {-1};
+	};
+
 	struct TaskDatabase
 	{
+		//the most recently added task for each identifier
 		std::map<TaskIdentifier, Task> tasks;
+		//every task ever added, indexed by vertex id
+		std::vector<Task> taskInstances;
 		std::map<TaskIdentifier, std::vector<Task>> abstractTaskImplementations;
 		std::map<TaskIdentifier, std::vector<Consideration>> considerations;
+		//what each task's considerations read between them, see findConsiderationInputs
+		std::map<TaskIdentifier, ConsiderationInputs> considerationInputs;
 		std::vector<SatisfiablePredicate> satisfiablePredicates;
 
 		/*
@@ -41,10 +80,54 @@ namespace AI
 		a postcondition in B
 		*/
 		std::vector<TaskVertex> taskGraph;
+		//indexed by vertex id
+		std::vector<TaskRequirements> taskRequirements;
+		RelaxedTaskGraph relaxedGraph;
+
+		/*
+		bumped every time the database changes, anything derived from the tasks
+		(eg cached plans) compares against this to know when its stale
+		*/
+		int revision {0};
 
-		void addTask(TaskIdentifier identifier, Task task);
+		/*
+		returns the id of the vertex created for task, or -1 if the task isn't added because it
+		or one of its subtasks has more than MaxTaskParameters of some kind of parameter
+		*/
+		int addTask(TaskIdentifier identifier, Task task);
+
+		//registers an already added task as an implementation of abstractTask, ignores a vertexId of -1
+		void addImplementation(TaskIdentifier abstractTask, int vertexId);
+
+		/*
+		bakes every consideration's curve into a table within maxError of it, see bakeResponseCurve.
+		0 drops the tables so every curve is scored from its formula. Call boundResponses afterwards
+		*/
+		void bakeResponseCurves(float maxError);
+
+		//fills in each consideration's inputs and considerationInputs, call once considerations are added
+		void findConsiderationInputs();
+
+		//fills in each consideration's bounds, call after bakeResponseCurves
+		void boundResponses();
+
+		/*
+		fills in relaxedGraph, call once tasks are added. Searches using RelaxedMaxCost fall back to
+		UnsatisfiedCount while it's out of date
+		*/
+		void buildRelaxedGraph();
 	};
 
-	TaskDatabase setupTasks();
+	//what consideration's input is read from, see gatherConsiderationInput
+	ConsiderationInputs findInputs(const Consideration& consideration);
+
+	//the range of inputs gatherConsiderationInput can give consideration
+	ScoreBounds inputBounds(const Consideration& consideration);
+
+	//the input a ValueOverTimeTracker consideration reads from tracker
+	float trackerInput(const ValueOverTimeTracker& tracker, ValueOverTimeTracker_Property property);
+
+	//curves are only baked if bakedCurveMaxError isn't 0, see TaskDatabase::bakeResponseCurves
+	TaskDatabase setupTasks(float bakedCurveMaxError = 0.f);
 }
 
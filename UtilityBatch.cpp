@@ -0,0 +1,638 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "UtilityBatch.h"
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace AI
+{
+#ifdef __SSE2__
+
+	//Cephes' expf: e^x = 2^n * e^r with |r| <= ln(2)/2, e^r from a degree 5 polynomial
+	inline __m128 exp4(__m128 x)
+	{
+		auto one = _mm_set1_ps(1.f);
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3f)), _mm_set1_ps(88.3f));
+
+		//n = floor(x / ln(2) + 0.5)
+		auto fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+		auto truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+		fx = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, fx), one));
+
+		//ln(2) split in two so r keeps its precision
+		x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+		auto y = _mm_set1_ps(1.9875691500e-4f);
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, one));
+
+		//2^n built straight into the exponent bits
+		auto n = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127));
+		auto pow2n = _mm_castsi128_ps(_mm_slli_epi32(n, 23));
+
+		return _mm_mul_ps(y, pow2n);
+	}
+
+	/*
+	Runs curve over count inputs 4 at a time with the stretches and offsets applied around it,
+	handing each 4 outputs to store along with how many of them are real. The tail is padded
+	out so every input goes through the same kernel
+	*/
+	template<typename Curve, typename Store>
+	void forEach4(const FunctionDefinition& function, const float* inputs, int count, Curve curve, Store store)
+	{
+		auto horizontalStretch = _mm_set1_ps(function.horizontalStretch);
+		auto horizontalOffset = _mm_set1_ps(function.horizontalOffset);
+		auto verticalStretch = _mm_set1_ps(function.verticalStretch);
+		auto verticalOffset = _mm_set1_ps(function.verticalOffset);
+
+		auto evaluate = [&](__m128 in)
+		{
+			auto x = _mm_mul_ps(horizontalStretch, _mm_add_ps(in, horizontalOffset));
+			return _mm_add_ps(_mm_mul_ps(verticalStretch, curve(x)), verticalOffset);
+		};
+
+		int i = 0;
+
+		for (; i + 4 <= count; i += 4)
+		{
+			store(i, evaluate(_mm_loadu_ps(inputs + i)), 4);
+		}
+
+		if (i < count)
+		{
+			float tail[4] = {0.f, 0.f, 0.f, 0.f};
+			std::memcpy(tail, inputs + i, sizeof(float) * (count - i));
+			store(i, evaluate(_mm_loadu_ps(tail)), count - i);
+		}
+	}
+
+	//forEach4 with function's curve picked once up front, false if the curve has to be done one at a time
+	template<typename Store>
+	bool forEachCurve4(const FunctionDefinition& function, const float* inputs, int count, Store store)
+	{
+		switch (function.type)
+		{
+			case FunctionType::Logistic:
+			{
+				auto L = _mm_set1_ps(function.logistic.L);
+				auto k = _mm_set1_ps(-function.logistic.k);
+				auto x0 = _mm_set1_ps(function.logistic.x0);
+				auto one = _mm_set1_ps(1.f);
+
+				forEach4(function, inputs, count, [=](__m128 x) {
+					return _mm_div_ps(L, _mm_add_ps(one, exp4(_mm_mul_ps(k, _mm_sub_ps(x, x0)))));
+				}, store);
+
+				return true;
+			}
+			case FunctionType::Quadratic:
+			{
+				auto a = _mm_set1_ps(function.quadratic.a);
+				auto b = _mm_set1_ps(function.quadratic.b);
+				auto c = _mm_set1_ps(function.quadratic.c);
+
+				forEach4(function, inputs, count, [=](__m128 x) {
+					return _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(a, x), b), x), c);
+				}, store);
+
+				return true;
+			}
+			case FunctionType::Exponential:
+			{
+				//a^x = e^(x ln(a)), which doesn't hold for a <= 0
+				if (!(function.exponential.a > 0.f))
+					return false;
+
+				auto logA = _mm_set1_ps(std::log(function.exponential.a));
+
+				forEach4(function, inputs, count, [=](__m128 x) {
+					return exp4(_mm_mul_ps(x, logA));
+				}, store);
+
+				return true;
+			}
+			case FunctionType::Gaussian:
+			{
+				auto a = _mm_set1_ps(function.gaussian.a);
+				auto b = _mm_set1_ps(function.gaussian.b);
+				auto width = 2 * function.gaussian.c;
+				auto c = _mm_set1_ps(-(width * width));
+
+				forEach4(function, inputs, count, [=](__m128 x) {
+					auto offset = _mm_sub_ps(x, b);
+					return _mm_mul_ps(a, exp4(_mm_div_ps(_mm_mul_ps(offset, offset), c)));
+				}, store);
+
+				return true;
+			}
+			case FunctionType::Step:
+			{
+				auto crossover = _mm_set1_ps(function.step.crossover);
+				auto one = _mm_set1_ps(1.f);
+
+				forEach4(function, inputs, count, [=](__m128 x) {
+					return _mm_and_ps(_mm_cmpge_ps(x, crossover), one);
+				}, store);
+
+				return true;
+			}
+			case FunctionType::Linear:
+			{
+				forEach4(function, inputs, count, [](__m128 x) {return x;}, store);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+#endif
+
+	float evaluateCurve(const FunctionDefinition& function, float x)
+	{
+		switch (function.type)
+		{
+			case FunctionType::Logistic:
+				return function.logistic.L / (1 + std::exp(-function.logistic.k * (x - function.logistic.x0)));
+			case FunctionType::Quadratic:
+				return function.quadratic.a * x * x + function.quadratic.b * x + function.quadratic.c;
+			case FunctionType::Exponential:
+				return std::pow(function.exponential.a, x);
+			case FunctionType::Gaussian:
+			{
+				auto b = x - function.gaussian.b;
+				auto c = 2 * function.gaussian.c;
+				return function.gaussian.a * std::exp(-(b * b) / (c * c));
+			}
+			case FunctionType::Step:
+				return x >= function.step.crossover;
+			case FunctionType::Linear:
+				break;
+		}
+
+		return x;
+	}
+
+	//the whole function, stretches and offsets included
+	float evaluateFunction(const FunctionDefinition& function, float x)
+	{
+		x = function.horizontalStretch * (x + function.horizontalOffset);
+		return function.verticalStretch * evaluateCurve(function, x) + function.verticalOffset;
+	}
+
+	void evaluateResponseCurve(const FunctionDefinition& function, const float* inputs, float* outputs, int count)
+	{
+#ifdef __SSE2__
+		auto vectorized = forEachCurve4(function, inputs, count, [=](int i, __m128 y, int lanes)
+		{
+			if (lanes == 4)
+			{
+				_mm_storeu_ps(outputs + i, y);
+			}
+			else
+			{
+				float tail[4];
+				_mm_storeu_ps(tail, y);
+				std::memcpy(outputs + i, tail, sizeof(float) * lanes);
+			}
+		});
+
+		if (vectorized)
+			return;
+#endif
+
+		for (int i = 0; i < count; i++)
+		{
+			outputs[i] = evaluateFunction(function, inputs[i]);
+		}
+	}
+
+	//interpolates between the samples either side of x, false if x is outside the table
+	bool lookUp(const CurveTable& table, float x, float& y)
+	{
+		auto t = (x - table.min) * table.scale;
+		auto last = static_cast<int>(table.samples.size()) - 1;
+
+		if (!(t >= 0.f && t <= last))
+			return false;
+
+		auto i = std::min(static_cast<int>(t), last - 1);
+		auto fraction = t - i;
+		y = table.samples[i] + fraction * (table.samples[i + 1] - table.samples[i]);
+
+		return true;
+	}
+
+	CurveTable bakeResponseCurve(const FunctionDefinition& function, float maxError, float min, float max, int maxSamples)
+	{
+		CurveTable table;
+
+		auto transcendental = function.type == FunctionType::Logistic 
+			|| function.type == FunctionType::Exponential 
+			|| function.type == FunctionType::Gaussian;
+
+		if (!transcendental || maxError <= 0.f || !(max > min))
+			return table;
+
+		table.min = min;
+		table.max = max;
+		table.maxError = maxError;
+
+		for (int intervals = 16; intervals < maxSamples; intervals *= 2)
+		{
+			table.scale = intervals / (max - min);
+			table.samples.resize(intervals + 1);
+
+			for (int i = 0; i <= intervals; i++)
+			{
+				table.samples[i] = evaluateFunction(function, min + i / table.scale);
+			}
+
+			//the error peaks between samples, probe each interval at a few points
+			auto worst = 0.f;
+
+			for (int i = 0; i < intervals * 4; i++)
+			{
+				auto x = min + (i + 0.5f) / (4 * table.scale);
+				float y {0.f};
+				lookUp(table, x, y);
+				worst = std::max(worst, std::abs(y - evaluateFunction(function, x)));
+			}
+
+			if (worst <= maxError)
+				return table;
+		}
+
+		return {};
+	}
+
+	/*
+	The curve at x, where x may be infinite. Formulas that would give NaN there (inf - inf, 0 * inf)
+	are replaced by their limits
+	*/
+	float evaluateCurveAtLimit(const FunctionDefinition& function, float x)
+	{
+		const auto infinity = std::numeric_limits<float>::infinity();
+
+		if (std::isfinite(x))
+			return evaluateCurve(function, x);
+
+		switch (function.type)
+		{
+			case FunctionType::Logistic:
+				return function.logistic.k == 0.f ? function.logistic.L / 2.f : evaluateCurve(function, x);
+			case FunctionType::Quadratic:
+			{
+				auto& q = function.quadratic;
+
+				if (q.a != 0.f)
+					return std::copysign(infinity, q.a);
+				if (q.b != 0.f)
+					return std::copysign(infinity, q.b * x);
+
+				return q.c;
+			}
+			default:
+				return evaluateCurve(function, x);
+		}
+	}
+
+	ScoreBounds responseBounds(const FunctionDefinition& function, float min, float max, const CurveTable* table)
+	{
+		const ScoreBounds unbounded;
+
+		//x = horizontalStretch * (input + horizontalOffset), where a zero stretch gives 0 even for infinite inputs
+		auto stretch = [&](float input) 
+		{
+			return function.horizontalStretch == 0.f ? 0.f : function.horizontalStretch * (input + function.horizontalOffset);
+		};
+
+		auto from = stretch(min);
+		auto to = stretch(max);
+
+		if (from > to)
+			std::swap(from, to);
+
+		float ys[3] {evaluateCurveAtLimit(function, from), evaluateCurveAtLimit(function, to), 0.f};
+		int count {2};
+
+		//the curves that aren't monotonic peak (or dip) in between
+		switch (function.type)
+		{
+			case FunctionType::Quadratic:
+			{
+				auto& q = function.quadratic;
+
+				if (q.a != 0.f)
+				{
+					auto vertex = -q.b / (2 * q.a);
+
+					if (vertex > from && vertex < to)
+						ys[count++] = evaluateCurve(function, vertex);
+				}
+
+				break;
+			}
+			case FunctionType::Exponential:
+			{
+				if (!(function.exponential.a > 0.f))
+					return unbounded;
+
+				break;
+			}
+			case FunctionType::Gaussian:
+			{
+				if (function.gaussian.c == 0.f)
+					return unbounded;
+
+				if (function.gaussian.b > from && function.gaussian.b < to)
+					ys[count++] = function.gaussian.a;
+
+				break;
+			}
+			default:
+				break;
+		}
+
+		ScoreBounds curve {ys[0], ys[0]};
+
+		for (int i = 0; i < count; i++)
+		{
+			if (std::isnan(ys[i]))
+				return unbounded;
+
+			curve.min = std::min(curve.min, ys[i]);
+			curve.max = std::max(curve.max, ys[i]);
+		}
+
+		ScoreBounds bounds {function.verticalOffset, function.verticalOffset};
+
+		if (function.verticalStretch != 0.f)
+		{
+			bounds = ScoreBounds{function.verticalStretch, function.verticalStretch} * curve;
+			bounds.min += function.verticalOffset;
+			bounds.max += function.verticalOffset;
+		}
+
+		//exp4 is within about 1e-7, a table within its maxError where it was probed
+		auto slack = [&](float y)
+		{
+			auto error = 1e-5f * std::max(1.f, std::abs(y));
+			return table != nullptr && !table->samples.empty() ? error + 2 * table->maxError : error;
+		};
+
+		bounds.min -= slack(bounds.min);
+		bounds.max += slack(bounds.max);
+
+		return bounds;
+	}
+
+	ScoreBounds operator*(const ScoreBounds& lhs, const ScoreBounds& rhs)
+	{
+		//0 * inf is 0 here, a factor that's exactly 0 zeroes the product whatever the other is
+		auto multiply = [](float a, float b) {return a == 0.f || b == 0.f ? 0.f : a * b;};
+
+		float products[] {multiply(lhs.min, rhs.min), multiply(lhs.min, rhs.max), 
+			multiply(lhs.max, rhs.min), multiply(lhs.max, rhs.max)};
+
+		return {*std::min_element(std::begin(products), std::end(products)), 
+			*std::max_element(std::begin(products), std::end(products))};
+	}
+
+	ScoreBounds taskBounds(const std::vector<Consideration>& considerations, const ScoreBounds* responses)
+	{
+		ScoreBounds groups[MaxConsiderationGroups];
+		bool usingSubsetMax[MaxConsiderationGroups] {};
+		std::fill(std::begin(groups), std::end(groups), ScoreBounds{1.f, 1.f});
+
+		for (std::size_t i = 0; i < considerations.size(); i++)
+		{
+			auto group = considerations[i].group;
+			groups[group] = groups[group] * responses[i];
+			usingSubsetMax[group] = considerations[i].useSubsetMax;
+		}
+
+		if (std::find(std::begin(usingSubsetMax), std::end(usingSubsetMax), true) == std::end(usingSubsetMax))
+			return groups[0];
+
+		//same as finishTask, the subset max starts at 0
+		ScoreBounds subsetMax {0.f, 0.f};
+
+		for (int group = 0; group < MaxConsiderationGroups; group++)
+		{
+			if (!usingSubsetMax[group])
+				continue;
+
+			subsetMax.min = std::max(subsetMax.min, groups[group].min);
+			subsetMax.max = std::max(subsetMax.max, groups[group].max);
+		}
+
+		return groups[0] * subsetMax;
+	}
+
+	void evaluateCurveTable(const CurveTable& table, const FunctionDefinition& function, const float* inputs, float* outputs, int count)
+	{
+		int i = 0;
+
+#ifdef __SSE2__
+		//SSE2 has no gather, but the index math and interpolation still go 4 at a time
+		auto samples = table.samples.data();
+		auto min = _mm_set1_ps(table.min);
+		auto scale = _mm_set1_ps(table.scale);
+		auto last = _mm_set1_ps(static_cast<float>(table.samples.size() - 1));
+		auto lastInterval = _mm_set1_epi32(static_cast<int>(table.samples.size()) - 2);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			auto t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(inputs + i), min), scale);
+			auto inside = _mm_and_ps(_mm_cmpge_ps(t, _mm_setzero_ps()), _mm_cmple_ps(t, last));
+			t = _mm_and_ps(t, inside);
+
+			//min(floor(t), last interval), t is non-negative here so truncating floors
+			auto index = _mm_cvttps_epi32(t);
+			auto beyond = _mm_cmpgt_epi32(index, lastInterval);
+			index = _mm_or_si128(_mm_and_si128(beyond, lastInterval), _mm_andnot_si128(beyond, index));
+			auto fraction = _mm_sub_ps(t, _mm_cvtepi32_ps(index));
+
+			alignas(16) std::int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+
+			auto left = _mm_setr_ps(samples[indices[0]], samples[indices[1]], samples[indices[2]], samples[indices[3]]);
+			auto right = _mm_setr_ps(samples[indices[0] + 1], samples[indices[1] + 1], samples[indices[2] + 1], samples[indices[3] + 1]);
+			_mm_storeu_ps(outputs + i, _mm_add_ps(left, _mm_mul_ps(fraction, _mm_sub_ps(right, left))));
+
+			auto outside = ~_mm_movemask_ps(inside) & 0xf;
+
+			for (int lane = 0; outside != 0; lane++, outside >>= 1)
+			{
+				if (outside & 1)
+				{
+					outputs[i + lane] = evaluateFunction(function, inputs[i + lane]);
+				}
+			}
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			if (!lookUp(table, inputs[i], outputs[i]))
+			{
+				outputs[i] = evaluateFunction(function, inputs[i]);
+			}
+		}
+	}
+
+	void UtilityBatch::begin(int count)
+	{
+		agentCount = count;
+		paddedCount = (count + 3) & ~3;
+
+		for (auto& group : groups)
+		{
+			group.resize(paddedCount);
+		}
+
+		responses.resize(paddedCount);
+	}
+
+	void UtilityBatch::beginTask()
+	{
+		for (auto& group : groups)
+		{
+			std::fill(group.begin(), group.end(), 1.f);
+		}
+
+		std::fill(std::begin(usingSubsetMax), std::end(usingSubsetMax), false);
+	}
+
+	void UtilityBatch::score(const Consideration& consideration, const float* inputs)
+	{
+		usingSubsetMax[consideration.group] = consideration.useSubsetMax;
+		auto group = groups[consideration.group].data();
+
+		//a narrow batch wastes most of the vector kernel's lanes, wider ones are faster with it than with the table
+		if (agentCount < 4 && !consideration.bakedFunction.samples.empty())
+		{
+			evaluateCurveTable(consideration.bakedFunction, consideration.function, inputs, responses.data(), agentCount);
+		}
+		else
+		{
+#ifdef __SSE2__
+			//groups are padded, so the tail's padding lanes can be written too
+			auto vectorized = forEachCurve4(consideration.function, inputs, agentCount, [=](int i, __m128 y, int)
+			{
+				_mm_storeu_ps(group + i, _mm_mul_ps(_mm_loadu_ps(group + i), y));
+			});
+
+			if (vectorized)
+				return;
+#endif
+
+			evaluateResponseCurve(consideration.function, inputs, responses.data(), agentCount);
+		}
+
+		for (int i = 0; i < agentCount; i++)
+		{
+			group[i] *= responses[i];
+		}
+	}
+
+	void UtilityBatch::evaluate(const Consideration& consideration, const float* inputs, float* responses) const
+	{
+		if (agentCount < 4 && !consideration.bakedFunction.samples.empty())
+		{
+			evaluateCurveTable(consideration.bakedFunction, consideration.function, inputs, responses, agentCount);
+		}
+		else
+		{
+			evaluateResponseCurve(consideration.function, inputs, responses, agentCount);
+		}
+	}
+
+	void UtilityBatch::scoreResponses(const Consideration& consideration, const float* responses)
+	{
+		usingSubsetMax[consideration.group] = consideration.useSubsetMax;
+		auto group = groups[consideration.group].data();
+
+		for (int i = 0; i < agentCount; i++)
+		{
+			group[i] *= responses[i];
+		}
+	}
+
+	void UtilityBatch::finishTask(float* scores)
+	{
+		auto base = groups[0].data();
+		auto anySubsetMax = std::find(std::begin(usingSubsetMax), std::end(usingSubsetMax), true) != std::end(usingSubsetMax);
+
+		if (!anySubsetMax)
+		{
+			std::copy(base, base + agentCount, scores);
+			return;
+		}
+
+		//reuses responses to hold the max of the subset max groups
+		auto subsetMax = responses.data();
+		std::fill(responses.begin(), responses.end(), 0.f);
+
+		for (int group = 0; group < MaxConsiderationGroups; group++)
+		{
+			if (!usingSubsetMax[group])
+				continue;
+
+			auto scoresInGroup = groups[group].data();
+			int i = 0;
+
+#ifdef __SSE2__
+			for (; i < paddedCount; i += 4)
+			{
+				_mm_storeu_ps(subsetMax + i, _mm_max_ps(_mm_loadu_ps(subsetMax + i), _mm_loadu_ps(scoresInGroup + i)));
+			}
+#endif
+
+			for (; i < paddedCount; i++)
+			{
+				subsetMax[i] = std::max(subsetMax[i], scoresInGroup[i]);
+			}
+		}
+
+		for (int i = 0; i < agentCount; i++)
+		{
+			scores[i] = base[i] * subsetMax[i];
+		}
+	}
+}
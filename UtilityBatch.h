@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include "Consideration.h"
+
+/*
+Utility scoring for many agents at once. The caller gathers one consideration's input for
+every agent, then the response curve is evaluated for all of them in one SSE pass and
+multiplied into the consideration's group. Once a task's considerations are all scored,
+finishTask reduces the groups into each agent's score for the task, the same way for every
+agent: group 0 times the max of the groups using subset max.
+
+A single agent is just a batch of one, so everything scores through the same kernels. Batches
+too small to fill an SSE register look baked curves up from their table instead, which is
+faster there than exp but slower than the vector kernel once lanes are full.
+*/
+
+namespace AI
+{
+	//group 0 is the base score, the rest can be combined with useSubsetMax
+	const int MaxConsiderationGroups {5};
+
+	/*
+	outputs[i] = verticalStretch * curve(horizontalStretch * (inputs[i] + horizontalOffset)) + verticalOffset
+	exp is approximated to about 1e-7 relative error when SSE2 is available
+	*/
+	void evaluateResponseCurve(const FunctionDefinition& function, const float* inputs, float* outputs, int count);
+
+	/*
+	Samples function over [min, max], doubling the number of samples until interpolating between
+	them stays within maxError of the formula. Only curves that need exp/pow are baked, the table
+	is left empty for the rest, and for curves that still aren't within maxError at maxSamples
+	*/
+	CurveTable bakeResponseCurve(const FunctionDefinition& function, float maxError, 
+		float min = 0.f, float max = 1.f, int maxSamples = 4096);
+
+	//evaluateResponseCurve from the table, inputs outside its range use the formula
+	void evaluateCurveTable(const CurveTable& table, const FunctionDefinition& function, 
+		const float* inputs, float* outputs, int count);
+
+	//a reasonable bound for bakeResponseCurves, when trading exactness for speed is wanted
+	const float BakedCurveMaxError {0.001f};
+
+	/*
+	The range of function (stretches and offsets included) for inputs in [min, max], either end
+	may be infinite. Curves without a bound there (eg a quadratic over every input) are unbounded.
+	Widened a little to cover exp's approximation, and a baked table's error if one is given
+	*/
+	ScoreBounds responseBounds(const FunctionDefinition& function, float min, float max, const CurveTable* table = nullptr);
+
+	//what multiplying anything within lhs by anything within rhs can give
+	ScoreBounds operator*(const ScoreBounds& lhs, const ScoreBounds& rhs);
+
+	/*
+	Bounds a task's score the way finishTask combines its considerations, from bounds on each
+	consideration's response. An evaluated response is just bounds with min == max
+	*/
+	ScoreBounds taskBounds(const std::vector<Consideration>& considerations, const ScoreBounds* responses);
+
+	class UtilityBatch
+	{
+	public:
+
+		//scores agentCount agents from here on, keeping the buffers' capacity
+		void begin(int agentCount);
+		int size() const {return agentCount;}
+
+		void beginTask();
+		//inputs[agent] is the consideration's input for each agent
+		void score(const Consideration& consideration, const float* inputs);
+		//writes each agent's score for the task
+		void finishTask(float* scores);
+
+		/*
+		score split in two so responses can be cached: evaluate writes responses[agent] without
+		scoring it, scoreResponses multiplies already evaluated responses into the task
+		*/
+		void evaluate(const Consideration& consideration, const float* inputs, float* responses) const;
+		void scoreResponses(const Consideration& consideration, const float* responses);
+
+	private:
+
+		int agentCount {0};
+		//rounded up to a multiple of the SIMD width so the kernels never need a scalar tail
+		int paddedCount {0};
+		std::vector<float> groups[MaxConsiderationGroups];
+		bool usingSubsetMax[MaxConsiderationGroups];
+		std::vector<float> responses;
+	};
+}
@@ -31,6 +31,17 @@ ValueOverTimeTracker::ValueOverTimeTracker()
 	maxValue = 0.f;
 	durationBelowValue = 0.f;
 	reacted = false;
+	hasExtension = false;
+}
+
+bool ValueOverTimeTracker::exceedsExtension(float maxValue, float durationBelowValue)
+{
+	return durationBelowValue > maxValue / 8.f;
+}
+
+bool ValueOverTimeTracker::durationExceedsExtension() const
+{
+	return hasExtension && exceedsExtension(maxValue, durationBelowValue);
 }
 
 void ValueOverTimeTracker::update(float value, float dt)
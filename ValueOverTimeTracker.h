@@ -28,8 +28,6 @@ SOFTWARE.
 Tracks how long a float value was below some given threshold, up to a maximum duration
 */
 
-#include <functional>
-
 struct ValueOverTimeTracker
 {
 	ValueOverTimeTracker();
@@ -48,7 +46,13 @@ struct ValueOverTimeTracker
 
 	static const float maximumDurationToTrack;
 
-	std::function<bool(ValueOverTimeTracker&)> durationExceedsExtension;
+	//whether durationExceedsExtension applies to this tracker, only alertness and curiosity's do
+	bool hasExtension;
+
+	//true once values have been below maxValue for longer than an eighth of it
+	static bool exceedsExtension(float maxValue, float durationBelowValue);
+
+	bool durationExceedsExtension() const;
 
 	/*
 	called once per frame with the current value of the thing a user wants to track.
@@ -24,123 +24,442 @@ SOFTWARE.
 
 #include "WorldState.h"
 #include "Tasks.h"
+#include <cmath>
 
 namespace AI
 {
-	FactFlag WorldState::consumeFactFlag(ConsumableFact fact)
+	bool StateMask::any() const
 	{
-		auto it = facts.flags.find(fact);
+		return (flags | values | vectors | factFlags | factValues | factVectors) != 0;
+	}
 
-		if (it == end(facts.flags) || it->second.consumed)
-		{
-			return {};
-		}
-		else
+	StateMask operator|(const StateMask& lhs, const StateMask& rhs)
+	{
+		return {lhs.flags | rhs.flags, lhs.values | rhs.values, lhs.vectors | rhs.vectors,
+			lhs.factFlags | rhs.factFlags, lhs.factValues | rhs.factValues, lhs.factVectors | rhs.factVectors};
+	}
+
+	StateMask operator&(const StateMask& lhs, const StateMask& rhs)
+	{
+		return {lhs.flags & rhs.flags, lhs.values & rhs.values, lhs.vectors & rhs.vectors,
+			lhs.factFlags & rhs.factFlags, lhs.factValues & rhs.factValues, lhs.factVectors & rhs.factVectors};
+	}
+
+	//a StateMask with just the given slot's bit set
+	template<typename Key>
+	StateMask slotMask(std::uint32_t StateMask::* slots, Key key)
+	{
+		StateMask mask;
+		mask.*slots = 1u << static_cast<int>(key);
+		return mask;
+	}
+
+	//how far apart values have to be to hash differently, in WorldStateIdentifier order
+	const float StateQuantization[] = 
+	{
+		1.f,	//Alertness
+		1.f,	//Boredom
+		1.f,	//Curiosity
+		1.f,	//PlayerIdentified
+		10.f,	//Destination
+		10.f,	//CurrentPosition
+		10.f,	//CurrentPosition_Feet
+		10.f,	//PlayerPosition
+		1.f		//Stance
+	};
+
+	//in ConsumableFact order
+	const float FactQuantization[] = 
+	{
+		10.f,	//Player_LastKnownLocation
+		0.05f,	//Player_ForwardVector
+		1.f,	//NoiseDisturbance
+		1.f,	//Glimpse
+		1.f,	//HasLead
+		1.f,	//LostLead
+		1.f,	//Lead
+		1.f,	//PlayerRecentlyIdentified
+		1.f,	//HasPickedSeat
+		1.f		//IsPositionedToSit
+	};
+
+	static_assert(sizeof(StateQuantization) / sizeof(float) == WorldStateIdentifierCount, "update StateQuantization when changing WorldStateIdentifier");
+	static_assert(sizeof(FactQuantization) / sizeof(float) == ConsumableFactCount, "update FactQuantization when changing ConsumableFact");
+
+	float quantizationStep(WorldStateIdentifier identifier)
+	{
+		return StateQuantization[static_cast<int>(identifier)];
+	}
+
+	float quantizationStep(ConsumableFact fact)
+	{
+		return FactQuantization[static_cast<int>(fact)];
+	}
+
+	//splitmix64's finalizer, every input bit affects every output bit
+	std::uint64_t mix(std::uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	std::uint64_t quantize(float x, float step)
+	{
+		return static_cast<std::uint64_t>(static_cast<std::int64_t>(std::floor(x / step + 0.5f)));
+	}
+
+	/*
+	slots are numbered (kind * 32 + identifier), kinds 0-2 being current's flags/values/vectors
+	and 3-5 the facts'
+	*/
+	std::uint64_t entryKey(int slot, float step, float value)
+	{
+		return mix(mix(slot) ^ quantize(value, step));
+	}
+
+	std::uint64_t entryKey(int slot, float step, Math::Vector3 vector)
+	{
+		return mix(mix(mix(mix(slot) ^ quantize(vector.x, step)) ^ quantize(vector.y, step)) ^ quantize(vector.z, step));
+	}
+
+	//the key an entry contributes to the hash, 0 if it isn't present
+	std::uint64_t entryHash(const State& state, StateSlot slot, WorldStateIdentifier identifier)
+	{
+		auto n = static_cast<int>(identifier);
+		auto step = quantizationStep(identifier);
+
+		switch (slot)
 		{
-			it->second.consumed = true;
-			return it->second;
+			case StateSlot::Flag:
+				return state.flags.contains(identifier) ? entryKey(n, 1.f, state.flags.at(identifier) ? 1.f : 0.f) : 0;
+			case StateSlot::Value:
+				return state.values.contains(identifier) ? entryKey(32 + n, step, state.values.at(identifier)) : 0;
+			case StateSlot::Vector:
+				return state.vectors.contains(identifier) ? entryKey(64 + n, step, state.vectors.at(identifier)) : 0;
 		}
+
+		return 0;
 	}
 
-	FactValue WorldState::consumeFactValue(ConsumableFact fact)
+	template<typename Map>
+	bool isUnconsumed(const Map& map, ConsumableFact fact)
 	{
-		auto it = facts.values.find(fact);
+		return map.contains(fact) && !map.at(fact).consumed;
+	}
 
-		if (it == end(facts.values) || it->second.consumed)
+	std::uint64_t entryHash(const Facts& facts, StateSlot slot, ConsumableFact fact)
+	{
+		auto n = static_cast<int>(fact);
+		auto step = quantizationStep(fact);
+
+		switch (slot)
 		{
-			return {};
+			case StateSlot::Flag:
+				return isUnconsumed(facts.flags, fact) ? entryKey(96 + n, 1.f, facts.flags.at(fact).flag ? 1.f : 0.f) : 0;
+			case StateSlot::Value:
+				return isUnconsumed(facts.values, fact) ? entryKey(128 + n, step, facts.values.at(fact).value) : 0;
+			case StateSlot::Vector:
+				return isUnconsumed(facts.vectors, fact) ? entryKey(160 + n, step, facts.vectors.at(fact).value) : 0;
 		}
-		else
+
+		return 0;
+	}
+
+	std::uint64_t computeHash(const State& state, const Facts& facts)
+	{
+		std::uint64_t hash {0};
+
+		for (auto slot : {StateSlot::Flag, StateSlot::Value, StateSlot::Vector})
 		{
-			it->second.consumed = true;
-			return it->second;
+			for (int n = 0; n < WorldStateIdentifierCount; n++)
+			{
+				hash ^= entryHash(state, slot, static_cast<WorldStateIdentifier>(n));
+			}
+
+			for (int n = 0; n < ConsumableFactCount; n++)
+			{
+				hash ^= entryHash(facts, slot, static_cast<ConsumableFact>(n));
+			}
 		}
+
+		return hash;
 	}
 
-	FactVector WorldState::consumeFactVector(ConsumableFact fact)
+	void WorldState::rehash()
 	{
-		auto it = facts.vectors.find(fact);
+		hash = computeHash(current, facts);
+	}
 
-		if (it == end(facts.vectors) || it->second.consumed)
-		{
+	FactFlag WorldState::consumeFactFlag(ConsumableFact fact)
+	{
+		if (!isUnconsumed(facts.flags, fact))
 			return {};
-		}
-		else
-		{
-			it->second.consumed = true;
-			return it->second;
-		}
+
+		hash ^= entryHash(facts, StateSlot::Flag, fact);
+		markChanged(slotMask(&StateMask::factFlags, fact));
+
+		auto& entry = facts.flags.at(fact);
+		entry.consumed = true;
+
+		return entry;
+	}
+
+	FactValue WorldState::consumeFactValue(ConsumableFact fact)
+	{
+		if (!isUnconsumed(facts.values, fact))
+			return {};
+
+		hash ^= entryHash(facts, StateSlot::Value, fact);
+		markChanged(slotMask(&StateMask::factValues, fact));
+
+		auto& entry = facts.values.at(fact);
+		entry.consumed = true;
+
+		return entry;
+	}
+
+	FactVector WorldState::consumeFactVector(ConsumableFact fact)
+	{
+		if (!isUnconsumed(facts.vectors, fact))
+			return {};
+
+		hash ^= entryHash(facts, StateSlot::Vector, fact);
+		markChanged(slotMask(&StateMask::factVectors, fact));
+
+		auto& entry = facts.vectors.at(fact);
+		entry.consumed = true;
+
+		return entry;
 	}
 
 	void WorldState::produceFactFlag(ConsumableFact fact, bool flag)
 	{
+		hash ^= entryHash(facts, StateSlot::Flag, fact);
 		facts.flags[fact] = {flag, false};
+		hash ^= entryHash(facts, StateSlot::Flag, fact);
+		markChanged(slotMask(&StateMask::factFlags, fact));
 	}
 	
 	void WorldState::produceFactValue(ConsumableFact fact, float value)
 	{
-		facts.values[fact] = {value, false};		
+		hash ^= entryHash(facts, StateSlot::Value, fact);
+		facts.values[fact] = {value, false};
+		hash ^= entryHash(facts, StateSlot::Value, fact);
+		markChanged(slotMask(&StateMask::factValues, fact));
 	}
 
 	void WorldState::produceFactVector(ConsumableFact fact, Math::Vector3 vector)
 	{
-		facts.vectors[fact] = FactVector{vector, false};		
+		hash ^= entryHash(facts, StateSlot::Vector, fact);
+		facts.vectors[fact] = FactVector{vector, false};
+		hash ^= entryHash(facts, StateSlot::Vector, fact);
+		markChanged(slotMask(&StateMask::factVectors, fact));
 	}
 
-	void WorldState::pushChanges(Task& task)
+	//what slot holds now, so rewindJournal can put it back
+	JournalEntry journalEntry(const State& state, StateSlot slot, WorldStateIdentifier identifier)
 	{
-		auto copiedFlags = task.modifiedFlags;
-		auto copiedValues = task.modifiedValues;
-		auto copiedVectors = task.modifiedVectors;
+		switch (slot)
+		{
+			case StateSlot::Flag:
+				return {slot, identifier, state.flags.contains(identifier), {state.flags.at(identifier) ? 1.f : 0.f, 0.f, 0.f}};
+			case StateSlot::Value:
+				return {slot, identifier, state.values.contains(identifier), {state.values.at(identifier), 0.f, 0.f}};
+			case StateSlot::Vector:
+				return {slot, identifier, state.vectors.contains(identifier), state.vectors.at(identifier)};
+		}
 
-		for (auto& flag : task.modifiedFlags)
-		{			
-			std::swap(copiedFlags[flag.first], current.flags[flag.first]);
+		return {};
+	}
+
+	std::uint32_t StateMask::* changedSlots(StateSlot slot)
+	{
+		switch (slot)
+		{
+			case StateSlot::Flag: return &StateMask::flags;
+			case StateSlot::Value: return &StateMask::values;
+			case StateSlot::Vector: return &StateMask::vectors;
 		}
 
-		for (auto& value : task.modifiedValues)
-		{			
-			std::swap(copiedValues[value.first], current.values[value.first]);
+		return &StateMask::flags;
+	}
+
+	//sets map[identifier], returns true if that changed anything
+	template<typename Map, typename Value>
+	bool assign(Map& map, WorldStateIdentifier identifier, Value value)
+	{
+		bool changed = !map.contains(identifier) || map.at(identifier) != value;
+		map[identifier] = value;
+
+		return changed;
+	}
+
+	//the journaling, hashing and change tracking shared by the setters
+	template<typename Map, typename Value>
+	void set(WorldState& state, Map& map, StateSlot slot, WorldStateIdentifier identifier, Value value)
+	{
+		if (state.openJournalMarks > 0)
+		{
+			state.journal.push_back(journalEntry(state.current, slot, identifier));
 		}
 
-		for (auto& vector : task.modifiedVectors)
+		state.hash ^= entryHash(state.current, slot, identifier);
+
+		if (assign(map, identifier, value))
 		{
-			std::swap(copiedVectors[vector.first], current.vectors[vector.first]);
+			state.markChanged(slotMask(changedSlots(slot), identifier));
 		}
 
-		StateChanges changed;
-		changed.state.flags = std::move(copiedFlags);
-		changed.state.values = std::move(copiedValues);
-		changed.state.vectors = std::move(copiedVectors);
+		state.hash ^= entryHash(state.current, slot, identifier);
+	}
+
+	void WorldState::setFlag(WorldStateIdentifier identifier, bool flag)
+	{
+		set(*this, current.flags, StateSlot::Flag, identifier, flag);
+	}
 
-		changes.emplace_back(changed);
+	void WorldState::setValue(WorldStateIdentifier identifier, float value)
+	{
+		set(*this, current.values, StateSlot::Value, identifier, value);
 	}
 
-	void WorldState::popChanges()
+	void WorldState::setVector(WorldStateIdentifier identifier, Math::Vector3 vector)
 	{
-		auto poppedChanges = changes[changes.size() - 1];
-		changes.pop_back();
+		set(*this, current.vectors, StateSlot::Vector, identifier, vector);
+	}
 
-		for (auto& flag : poppedChanges.state.flags)
+	void WorldState::remove(StateSlot slot, WorldStateIdentifier identifier)
+	{
+		auto entry = journalEntry(current, slot, identifier);
+
+		if (!entry.wasPresent)
+			return;
+
+		if (openJournalMarks > 0)
 		{
-			current.flags[flag.first] = flag.second;
+			journal.push_back(entry);
 		}
 
-		for (auto& value : poppedChanges.state.values)
+		hash ^= entryHash(current, slot, identifier);
+
+		switch (slot)
 		{
-			current.values[value.first] = value.second;
+			case StateSlot::Flag: current.flags.erase(identifier); break;
+			case StateSlot::Value: current.values.erase(identifier); break;
+			case StateSlot::Vector: current.vectors.erase(identifier); break;
 		}
 
-		for (auto& value : poppedChanges.valuesAddedOrRemoved)
+		markChanged(slotMask(changedSlots(slot), identifier));
+	}
+
+	int WorldState::markJournal()
+	{
+		openJournalMarks++;
+		return static_cast<int>(journal.size());
+	}
+
+	template<typename Map, typename Value>
+	void restore(Map& map, const JournalEntry& entry, Value value)
+	{
+		if (entry.wasPresent)
 		{
-			if (value.second)
-			{
-				current.values[value.first];
-			}
-			else
+			map[entry.identifier] = value;
+		}
+		else
+		{
+			map.erase(entry.identifier);
+		}
+	}
+
+	void WorldState::rewindJournal(int mark)
+	{
+		StateMask restored;
+
+		//newest first, so a slot written several times ends up with its oldest value
+		for (int i = static_cast<int>(journal.size()) - 1; i >= mark; i--)
+		{
+			auto& entry = journal[i];
+			auto bit = 1u << static_cast<int>(entry.identifier);
+			hash ^= entryHash(current, entry.slot, entry.identifier);
+
+			switch (entry.slot)
 			{
-				current.values.erase(value.first);
+				case StateSlot::Flag:
+				{
+					restore(current.flags, entry, entry.previous.x != 0.f);
+					restored.flags |= bit;
+					break;
+				}
+				case StateSlot::Value:
+				{
+					restore(current.values, entry, entry.previous.x);
+					restored.values |= bit;
+					break;
+				}
+				case StateSlot::Vector:
+				{
+					restore(current.vectors, entry, entry.previous);
+					restored.vectors |= bit;
+					break;
+				}
 			}
+
+			hash ^= entryHash(current, entry.slot, entry.identifier);
+		}
+
+		journal.resize(mark);
+		openJournalMarks--;
+		markChanged(restored);
+	}
+
+	void WorldState::pushChanges(const Task& task)
+	{
+		changes.push_back(markJournal());
+
+		for (auto& flag : task.modifiedFlags)
+		{
+			setFlag(flag.first, flag.second);
+		}
+
+		for (auto& value : task.modifiedValues)
+		{
+			setValue(value.first, value.second);
+		}
+
+		for (auto& vector : task.modifiedVectors)
+		{
+			setVector(vector.first, vector.second);
+		}
+	}
+
+	void WorldState::popChanges()
+	{
+		rewindJournal(changes.back());
+		changes.pop_back();
+	}
+
+	int WorldState::subscribe(StateMask slots)
+	{
+		subscriptions.push_back(slots);
+		pendingChanges.push_back({});
+
+		return static_cast<int>(subscriptions.size()) - 1;
+	}
+
+	StateMask WorldState::takeChanges(int subscriber)
+	{
+		auto changed = pendingChanges[subscriber];
+		pendingChanges[subscriber].clear();
+
+		return changed;
+	}
+
+	void WorldState::markChanged(const StateMask& changed)
+	{
+		for (std::size_t i = 0; i < subscriptions.size(); i++)
+		{
+			pendingChanges[i] = pendingChanges[i] | (changed & subscriptions[i]);
 		}
 	}
-}
\ No newline at end of file
+}
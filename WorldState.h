@@ -30,6 +30,7 @@ SOFTWARE.
 #include "ValueOverTimeTracker.h"
 #include "Barker.h"
 #include "Math.h"
+#include "EnumMap.h"
 
 class UBarker;
 
@@ -56,6 +57,9 @@ enum class WorldStateIdentifier
 	Invalid
 };
 
+//number of valid WorldStateIdentifiers, used to size anything indexed by one
+const int WorldStateIdentifierCount = static_cast<int>(WorldStateIdentifier::Invalid);
+
 //update Consideration.h::ConsumableFact when changing this!
 enum class ConsumableFact
 {
@@ -71,19 +75,41 @@ enum class ConsumableFact
 	IsPositionedToSit
 };
 
+//number of ConsumableFacts, keep in sync with the last entry above
+const int ConsumableFactCount = static_cast<int>(ConsumableFact::IsPositionedToSit) + 1;
+
 namespace AI
 {	
+	template<typename Value>
+	using StateMap = EnumMap<WorldStateIdentifier, Value, WorldStateIdentifierCount>;
+
+	template<typename Value>
+	using FactMap = EnumMap<ConsumableFact, Value, ConsumableFactCount>;
+
 	struct State
 	{
-		std::map<WorldStateIdentifier, bool> flags;
-		std::map<WorldStateIdentifier, float> values;
-		std::map<WorldStateIdentifier, Math::Vector3> vectors;
+		StateMap<bool> flags;
+		StateMap<float> values;
+		StateMap<Math::Vector3> vectors;
 	};
 
-	struct StateChanges
+	enum class StateSlot : std::uint8_t
 	{
-		State state;
-		std::map<WorldStateIdentifier, bool> valuesAddedOrRemoved; //true = added, false = removed
+		Flag,
+		Value,
+		Vector
+	};
+
+	/*
+	One entry of WorldState's undo journal, what a state slot held before it was overwritten.
+	Flags and values are kept in previous.x
+	*/
+	struct JournalEntry
+	{
+		StateSlot slot;
+		WorldStateIdentifier identifier;
+		bool wasPresent;
+		Math::Vector3 previous;
 	};
 
 	/*
@@ -114,11 +140,41 @@ namespace AI
 
 	struct Facts
 	{
-		std::map<ConsumableFact, FactFlag> flags;
-		std::map<ConsumableFact, FactValue> values;
-		std::map<ConsumableFact, FactVector> vectors;
+		FactMap<FactFlag> flags;
+		FactMap<FactValue> values;
+		FactMap<FactVector> vectors;
 	};
 
+	/*
+	A set of WorldState slots, bit n of each mask stands for WorldStateIdentifier n
+	(or ConsumableFact n for the fact masks)
+	*/
+	struct StateMask
+	{
+		std::uint32_t flags {0};
+		std::uint32_t values {0};
+		std::uint32_t vectors {0};
+		std::uint32_t factFlags {0};
+		std::uint32_t factValues {0};
+		std::uint32_t factVectors {0};
+
+		bool any() const;
+		void clear() {*this = {};}
+	};
+
+	StateMask operator|(const StateMask& lhs, const StateMask& rhs);
+	StateMask operator&(const StateMask& lhs, const StateMask& rhs);
+
+	/*
+	How finely each value/vector is told apart by WorldState::hash, values within the same step
+	hash the same so eg a few centimetres of jitter in a position doesn't change it
+	*/
+	float quantizationStep(WorldStateIdentifier identifier);
+	float quantizationStep(ConsumableFact fact);
+
+	//hash of every present entry in state and every unconsumed fact, what WorldState::hash is kept equal to
+	std::uint64_t computeHash(const State& state, const Facts& facts);
+
 	struct WorldState
 	{
 		State current;
@@ -142,10 +198,53 @@ namespace AI
 		void produceFactValue(ConsumableFact fact, float value);
 		void produceFactVector(ConsumableFact fact, Math::Vector3 vector);
 
-		void pushChanges(struct Task& task);
+		/*
+		A Zobrist style fingerprint of current and facts: the XOR of a 64 bit key per present entry,
+		made from the entry's slot and its quantized value. Consumed facts are left out since conditions
+		treat them the same as missing ones. The setters, remove, produce/consume and rewinding the journal
+		all keep it up to date with a couple of XORs, after writing to current or facts directly call rehash
+		*/
+		std::uint64_t hash {0};
+		void rehash();
+
+		/*
+		pushChanges applies a task's modified flags/values/vectors to current, remembering the old
+		values in the journal. popChanges undoes the most recent push
+		*/
+		void pushChanges(const struct Task& task);
 		void popChanges();
 
-		std::vector<StateChanges> changes;
+		/*
+		Writes to current that tell subscribers when a slot changes. While a journal mark is held
+		the old values are also journaled, rewind to the mark to put current back the way it was.
+		The journal's buffer is reused so this doesn't allocate once it has grown
+		*/
+		void setFlag(WorldStateIdentifier identifier, bool flag);
+		void setValue(WorldStateIdentifier identifier, float value);
+		void setVector(WorldStateIdentifier identifier, Math::Vector3 vector);
+		void remove(StateSlot slot, WorldStateIdentifier identifier);
+
+		//every markJournal has to be matched by a rewindJournal, marks nest
+		int markJournal();
+		void rewindJournal(int mark);
+
+		/*
+		Subscribers are told about changes to the slots they subscribed to, made through the setters above
+		or by producing/consuming facts. Writing to current directly isn't seen.
+		subscribe returns the id to pass to takeChanges
+		*/
+		int subscribe(StateMask slots);
+		//the subscribed slots that changed since the last call
+		StateMask takeChanges(int subscriber);
+		void markChanged(const StateMask& changed);
+
+		std::vector<JournalEntry> journal;
+		//journal marks taken by pushChanges
+		std::vector<int> changes;
+		//marks that haven't been rewound yet, nothing is journaled when there aren't any
+		int openJournalMarks {0};
+		std::vector<StateMask> subscriptions;
+		std::vector<StateMask> pendingChanges;
 		std::map<WorldStateIdentifier, ValueOverTimeTracker> valueTrackers;
 		std::vector<Actor*> actorsToIgnore;
 		bool actorsToIgnoreChanged {false};
@@ -0,0 +1,577 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Planner benchmarks over synthetic task graphs. Each result is printed as one JSON object
+per line so runs can be diffed or loaded by a script to track regressions.
+
+usage: aitu_bench [--sizes=10,100,1000,10000] [--branching=4] [--fanout=2] [--density=1]
+                  [--deadends=0] [--repeats=100] [--seed=1]
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "../Planner.h"
+#include "../UE_Replacements.h"
+
+using namespace AI;
+
+namespace
+{
+    //every allocation made through operator new, see the replacements below
+    std::atomic<long> allocationCount {0};
+}
+
+void* operator new(std::size_t size)
+{
+    allocationCount++;
+
+    if (auto memory = std::malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /*
+    The shape of a synthetic TaskDatabase. Tasks are laid out in layers, a task in layer L
+    requires Progress == L and sets Progress to L + 1, so branching is how many tasks
+    could satisfy any one precondition
+    */
+    struct GraphShape
+    {
+        int taskCount {100};
+        int branching {4};
+        //implementations per abstract task, 0 to leave out abstract tasks
+        int abstractFanOut {2};
+        //extra flag requirements per precondition, all of them true in the starting state
+        int conditionDensity {1};
+        /*
+        how long a ladder of tasks hangs off every layer that looks like another way to get there
+        but can never start, 0 to leave them out. Deep ones are where RelaxedMaxCost pays off
+        */
+        int deadEndDepth {0};
+        unsigned int seed {1};
+    };
+
+    struct SyntheticGraph
+    {
+        TaskDatabase database;
+        int goalVertex {-1};
+        WorldState start;
+        //how long each addTask call took, and how many allocations they made in total
+        std::vector<long> addTaskLatencies;
+        long addTaskAllocations {0};
+    };
+
+    const WorldStateIdentifier Progress {WorldStateIdentifier::Alertness};
+
+    /*
+    false in the starting state and only made true by abstract tasks, the goal requires it
+    so every plan has an abstract task for fixFailedPlan to work on. Every other flag pads out conditions
+    */
+    const WorldStateIdentifier AbstractToken {WorldStateIdentifier::Stance};
+
+    //each layer's dead end climbs its own range of values of this, and the top needs -1 which nothing sets
+    const WorldStateIdentifier DeadEndRung {WorldStateIdentifier::Boredom};
+
+    //each abstract task needs its own identifier since implementations are looked up by identifier
+    const TaskIdentifier AbstractIdentifiers[] {TaskIdentifier::Chase, TaskIdentifier::FindSeat, TaskIdentifier::Search,
+        TaskIdentifier::InvestigateSound, TaskIdentifier::FaceSound, TaskIdentifier::Bother};
+    const int AbstractIdentifierCount = 6;
+
+    void addPadding(Condition& condition, int density, std::mt19937& engine)
+    {
+        std::uniform_int_distribution<int> flag {0, WorldStateIdentifierCount - 1};
+
+        for (int i = 0; i < density; i++)
+        {
+            auto id = static_cast<WorldStateIdentifier>(flag(engine));
+
+            if (id != AbstractToken)
+            {
+                condition.requiredFlags.push_back({id, true});
+            }
+        }
+    }
+
+    Task makeLayerTask(std::string name, int layer, int density, std::mt19937& engine)
+    {
+        Task task {name};
+        task.preconditions.requiredValues.push_back({Progress, ConditionOp::EqualTo, static_cast<float>(layer)});
+        task.postconditions.requiredValues.push_back({Progress, ConditionOp::EqualTo, static_cast<float>(layer + 1)});
+        addPadding(task.preconditions, density, engine);
+
+        //tasks commonly finish on a predicate (eg TimeElapsed), this one's always true
+        task.parameters.vectors.push_back({1.f, 0.f, 0.f});
+        task.postconditions.satisfiedPredicates.push_back({SatisfiablePredicateIdentifier::ParameterFlag, 0});
+
+        return task;
+    }
+
+    int addTimed(SyntheticGraph& graph, TaskIdentifier identifier, Task task)
+    {
+        auto allocations = allocationCount.load();
+        auto begin = Clock::now();
+        auto vertex = graph.database.addTask(identifier, std::move(task));
+        graph.addTaskLatencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+        graph.addTaskAllocations += allocationCount.load() - allocations;
+
+        return vertex;
+    }
+
+    /*
+    a task that would finish layer, if only the ladder of depth tasks it needs could start. Every rung looks
+    like progress to an unsatisfied count
+    */
+    void addDeadEnd(SyntheticGraph& graph, int layer, int depth, int density, std::mt19937& engine)
+    {
+        auto offset = layer * depth;
+        auto task = makeLayerTask("deadEnd", layer, density, engine);
+        task.preconditions.requiredValues.push_back({DeadEndRung, ConditionOp::EqualTo, static_cast<float>(offset + 1)});
+        addTimed(graph, TaskIdentifier::Wander, task);
+
+        for (int rung = 1; rung <= depth; rung++)
+        {
+            Task step {"rung"};
+            step.postconditions.requiredValues.push_back({DeadEndRung, ConditionOp::EqualTo, static_cast<float>(offset + rung)});
+            step.preconditions.requiredValues.push_back({DeadEndRung, ConditionOp::EqualTo, 
+                rung < depth ? static_cast<float>(offset + rung + 1) : -1.f});
+            addTimed(graph, TaskIdentifier::FollowPath, step);
+        }
+    }
+
+    std::unique_ptr<SyntheticGraph> generateGraph(const GraphShape& shape)
+    {
+        auto graph = std::make_unique<SyntheticGraph>();
+        std::mt19937 engine {shape.seed};
+
+        graph->database.satisfiablePredicates.push_back({SatisfiablePredicateIdentifier::ParameterFlag,
+            [](const WorldState&, const TaskParameters& parameters, int parameterIndex)
+            {
+                return parameters.vectors[parameterIndex].x != 0;
+            }});
+
+        auto branching = std::max(1, shape.branching);
+        auto fanOut = std::max(0, shape.abstractFanOut);
+        auto deadEndDepth = std::max(0, shape.deadEndDepth);
+        //every abstract task brings its implementations along, and every dead end its ladder
+        auto tasksPerLayer = branching + fanOut + (deadEndDepth > 0 ? 1 + deadEndDepth : 0);
+        auto layers = std::max(1, (shape.taskCount - 1) / tasksPerLayer);
+        auto abstractEvery = std::max(1, layers / AbstractIdentifierCount);
+        int abstractTasks {0};
+
+        for (int layer = 0; layer < layers; layer++)
+        {
+            for (int slot = 0; slot < branching; slot++)
+            {
+                bool isAbstract = fanOut > 0 && slot == 0 && layer % abstractEvery == 0
+                    && abstractTasks < AbstractIdentifierCount;
+
+                if (isAbstract)
+                {
+                    /*
+                    an implementation runs right before its abstract task, which checks its own preconditions
+                    again once Progress has moved on, so the abstract task only requires the padding
+                    */
+                    Task abstractTask {"abstract", TaskType::Abstract};
+                    abstractTask.postconditions.requiredValues.push_back({Progress, ConditionOp::EqualTo, static_cast<float>(layer + 1)});
+                    abstractTask.postconditions.requiredFlags.push_back({AbstractToken, true});
+                    addPadding(abstractTask.preconditions, shape.conditionDensity, engine);
+
+                    auto identifier = AbstractIdentifiers[abstractTasks++];
+                    addTimed(*graph, identifier, abstractTask);
+
+                    for (int i = 0; i < fanOut; i++)
+                    {
+                        auto vertex = addTimed(*graph, TaskIdentifier::ChaseSight, makeLayerTask("implementation", layer, 
+                            shape.conditionDensity, engine));
+                        graph->database.addImplementation(identifier, vertex);
+                    }
+                }
+                else
+                {
+                    addTimed(*graph, TaskIdentifier::Wander, makeLayerTask("task", layer, shape.conditionDensity, engine));
+                }
+            }
+
+            if (deadEndDepth > 0)
+            {
+                addDeadEnd(*graph, layer, deadEndDepth, shape.conditionDensity, engine);
+            }
+        }
+
+        Task goal {"goal"};
+        goal.preconditions.requiredValues.push_back({Progress, ConditionOp::EqualTo, static_cast<float>(layers)});
+
+        if (abstractTasks > 0)
+        {
+            goal.preconditions.requiredFlags.push_back({AbstractToken, true});
+        }
+
+        graph->goalVertex = addTimed(*graph, TaskIdentifier::Relax, goal);
+        graph->database.buildRelaxedGraph();
+
+        for (int i = 0; i < WorldStateIdentifierCount; i++)
+        {
+            graph->start.current.flags[static_cast<WorldStateIdentifier>(i)] = true;
+        }
+
+        graph->start.current.flags[AbstractToken] = false;
+        graph->start.current.values[Progress] = 0.f;
+        graph->start.current.values[DeadEndRung] = 0.f;
+
+        return graph;
+    }
+
+    struct Samples
+    {
+        std::vector<long> latencies;
+        long allocations {0};
+
+        template<typename Func>
+        void measure(Func f)
+        {
+            auto allocationsBefore = allocationCount.load();
+            auto begin = Clock::now();
+            f();
+            latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+            allocations += allocationCount.load() - allocationsBefore;
+        }
+    };
+
+    long percentile(std::vector<long> sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+
+        return sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+    }
+
+    //discards everything, the planner logs every task it starts and that would drown out the results
+    struct NullBuffer : std::streambuf
+    {
+        int overflow(int c) override {return c;}
+    };
+
+    class Reporter
+    {
+    public:
+
+        Reporter(std::ostream& output, const GraphShape& shape)
+            : output {output}, shape {shape}
+            {}
+
+        void report(const std::string& benchmark, const std::vector<long>& latencies, long allocations,
+            const std::string& extra = "")
+        {
+            auto sorted = latencies;
+            std::sort(begin(sorted), end(sorted));
+
+            long total {0};
+
+            for (auto latency : sorted)
+            {
+                total += latency;
+            }
+
+            auto count = static_cast<double>(sorted.size());
+
+            output << "{\"benchmark\":\"" << benchmark << "\""
+                << ",\"tasks\":" << shape.taskCount
+                << ",\"branching\":" << shape.branching
+                << ",\"fanOut\":" << shape.abstractFanOut
+                << ",\"density\":" << shape.conditionDensity
+                << ",\"deadEndDepth\":" << shape.deadEndDepth
+                << ",\"seed\":" << shape.seed
+                << ",\"samples\":" << sorted.size()
+                << ",\"opsPerSecond\":" << (total > 0 ? count * 1e9 / total : 0.0)
+                << ",\"p50Ns\":" << percentile(sorted, 0.5)
+                << ",\"p90Ns\":" << percentile(sorted, 0.9)
+                << ",\"p99Ns\":" << percentile(sorted, 0.99)
+                << ",\"maxNs\":" << (sorted.empty() ? 0 : sorted.back())
+                << ",\"allocationsPerOp\":" << (sorted.empty() ? 0.0 : allocations / count)
+                << extra
+                << "}" << std::endl;
+        }
+
+        void report(const std::string& benchmark, const Samples& samples, const std::string& extra = "")
+        {
+            report(benchmark, samples.latencies, samples.allocations, extra);
+        }
+
+    private:
+
+        std::ostream& output;
+        GraphShape shape;
+    };
+
+    void perform(const Task& task, WorldState& state)
+    {
+        for (auto& flag : task.postconditions.requiredFlags)
+        {
+            state.current.flags[flag.id] = flag.flag;
+        }
+
+        for (auto& value : task.postconditions.requiredValues)
+        {
+            state.current.values[value.id] = value.value;
+        }
+    }
+
+    /*
+    makes the postconditions of the plan's current task true, as if it had been performed. An implementation
+    is what carries out its abstract task, so it makes the abstract task's postconditions true too
+    */
+    void perform(const Plan& plan, WorldState& state)
+    {
+        auto& task = plan.getCurrentTask();
+        perform(task, state);
+
+        if (task.parentTaskIndex != -1 && plan.getTask(task.parentTaskIndex).type == TaskType::Abstract)
+        {
+            perform(plan.getTask(task.parentTaskIndex), state);
+        }
+    }
+
+    void runBenchmarks(const GraphShape& shape, int repeats, const WorldQuerier& querier, Reporter& reporter)
+    {
+        auto graph = generateGraph(shape);
+        auto& database = graph->database;
+        auto& goal = database.taskInstances[graph->goalVertex];
+        TaskParameters parameters;
+
+        reporter.report("addTask", graph->addTaskLatencies, graph->addTaskAllocations);
+
+        /*
+        every task's pre and postconditions against the starting state, once through the interpreter
+        and once through the compiled program. Each sample is a pass over the whole database
+        */
+        for (bool compiled : {false, true})
+        {
+            Samples conditions;
+            int trueCount {0};
+
+            for (int i = 0; i < repeats; i++)
+            {
+                conditions.measure([&]
+                {
+                    for (auto& task : database.taskInstances)
+                    {
+                        for (auto condition : {&task.preconditions, &task.postconditions})
+                        {
+                            auto result = compiled
+                                ? condition->isTrue(graph->start, task.parameters, database.satisfiablePredicates)
+                                : condition->interpret(graph->start, task.parameters, database.satisfiablePredicates);
+                            trueCount += result ? 1 : 0;
+                        }
+                    }
+                });
+            }
+
+            reporter.report(compiled ? "conditionCompiled" : "conditionInterpreted", conditions,
+                ",\"conditionsPerSample\":" + std::to_string(2 * database.taskInstances.size())
+                + ",\"trueConditions\":" + std::to_string(trueCount / std::max(1, repeats)));
+        }
+
+        Samples planning;
+        Plan plan;
+
+        for (int i = 0; i < repeats; i++)
+        {
+            auto state = graph->start;
+            planning.measure([&] {plan = generatePlan(goal, state, querier, parameters, database);});
+        }
+
+        reporter.report("generatePlan", planning, ",\"planLength\":" + std::to_string(plan.size())
+            + ",\"failed\":" + (plan.failed ? "true" : "false"));
+
+        //each heuristic on its own, the time includes building RelaxedMaxCost's table at the start
+        for (auto heuristic : {SearchHeuristic::UnsatisfiedCount, SearchHeuristic::RelaxedMaxCost})
+        {
+            PlanSearch search;
+            search.setHeuristic(heuristic);
+            Samples searching;
+
+            for (int i = 0; i < repeats; i++)
+            {
+                searching.measure([&]
+                {
+                    search.start(goal, graph->start, database);
+                    search.run();
+                });
+            }
+
+            auto result = search.takeResult();
+            reporter.report(heuristic == SearchHeuristic::RelaxedMaxCost ? "searchRelaxedMaxCost" : "searchUnsatisfiedCount",
+                searching, ",\"expanded\":" + std::to_string(search.getExpandedCount())
+                + ",\"planLength\":" + std::to_string(result.size()));
+        }
+
+        PlanCache cache;
+        Samples cached;
+
+        for (int i = 0; i < repeats; i++)
+        {
+            auto state = graph->start;
+            cached.measure([&] {generatePlan(goal, state, querier, parameters, database, cache);});
+        }
+
+        reporter.report("generatePlanCached", cached);
+
+        if (plan.failed)
+        {
+            return;
+        }
+
+        /*
+        runs the plan to completion, repairing a copy of it at the first task that's an
+        implementation of an abstract task
+        */
+        Samples evaluating;
+        Samples fixing;
+
+        for (int i = 0; i < repeats; i++)
+        {
+            auto state = graph->start;
+            auto running = instantiatePlan(plan, state, querier);
+            running.start();
+            bool repaired {false};
+
+            //every task finishes in one evaluation, the limit is just a guard against a plan that doesn't
+            for (int step = 0; step < 4 * running.size() && !running.finished && !running.failed; step++)
+            {
+                auto& task = running.getCurrentTask();
+
+                if (!repaired && task.parentTaskIndex != -1
+                    && running.getTask(task.parentTaskIndex).type == TaskType::Abstract)
+                {
+                    auto broken = running;
+                    auto brokenState = state;
+                    broken.failed = true;
+                    fixing.measure([&] {fixFailedPlan(broken, brokenState, parameters, database);});
+                    repaired = true;
+                }
+
+                perform(running, state);
+                evaluating.measure([&] {evaluatePlan(running, state, querier, parameters, database.satisfiablePredicates);});
+            }
+        }
+
+        reporter.report("evaluatePlan", evaluating);
+        reporter.report("fixFailedPlan", fixing);
+    }
+
+    std::vector<int> parseList(const std::string& list)
+    {
+        std::vector<int> values;
+        std::size_t start {0};
+
+        while (start < list.size())
+        {
+            auto end = list.find(',', start);
+
+            if (end == std::string::npos)
+            {
+                end = list.size();
+            }
+
+            values.push_back(std::stoi(list.substr(start, end - start)));
+            start = end + 1;
+        }
+
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> sizes {10, 100, 1000, 10000};
+    GraphShape shape;
+    int repeats {100};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument {argv[i]};
+        auto equals = argument.find('=');
+        auto name = argument.substr(0, equals);
+        auto value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        if (name == "--sizes") sizes = parseList(value);
+        else if (name == "--branching") shape.branching = std::stoi(value);
+        else if (name == "--fanout") shape.abstractFanOut = std::stoi(value);
+        else if (name == "--density") shape.conditionDensity = std::stoi(value);
+        else if (name == "--deadends") shape.deadEndDepth = std::stoi(value);
+        else if (name == "--repeats") repeats = std::stoi(value);
+        else if (name == "--seed") shape.seed = static_cast<unsigned int>(std::stoul(value));
+        else
+        {
+            std::cerr << "unknown argument: " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostream results {std::cout.rdbuf()};
+    NullBuffer discard;
+    std::cout.rdbuf(&discard);
+
+    GameMode mode;
+    World world {&mode};
+    WorldQuerier querier;
+    querier.setup(&world, world.createActor());
+
+    for (auto size : sizes)
+    {
+        shape.taskCount = size;
+        Reporter reporter {results, shape};
+        runBenchmarks(shape, repeats, querier, reporter);
+    }
+
+    std::cout.rdbuf(results.rdbuf());
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Utility scoring benchmarks: every agent scoring a fixed set of tasks, as one batch, as one
+batch with the curves baked into tables, and as a batch of one per agent (what evaluateNeeds does). Each result is printed as one
+JSON object per line, same as the planner benchmarks.
+
+usage: aitu_utility_bench [--agents=100,1000,5000,10000] [--repeats=100]
+*/
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "../UtilityBatch.h"
+
+using namespace AI;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int TaskCount {10};
+    const int ConsiderationsPerTask {4};
+
+    //a mix of every curve, with a subset max group on every other task
+    std::vector<std::vector<Consideration>> makeTasks()
+    {
+        std::vector<std::vector<Consideration>> tasks(TaskCount);
+        int curve {0};
+
+        for (int task = 0; task < TaskCount; task++)
+        {
+            for (int i = 0; i < ConsiderationsPerTask; i++)
+            {
+                Consideration consideration;
+                consideration.type = ConsiderationType::Scalar;
+                consideration.function.type = static_cast<FunctionType>(curve++ % 6);
+                consideration.function.logistic = {1.f, 10.f, 0.5f};
+                consideration.group = task % 2 == 1 && i > 1 ? i - 1 : 0;
+                consideration.useSubsetMax = consideration.group != 0;
+                tasks[task].push_back(consideration);
+            }
+        }
+
+        return tasks;
+    }
+
+    long percentile(std::vector<long> sorted, double p)
+    {
+        std::sort(sorted.begin(), sorted.end());
+        return sorted.empty() ? 0 : sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+    }
+
+    void report(const std::string& benchmark, int agents, const std::vector<long>& latencies)
+    {
+        auto p50 = percentile(latencies, 0.5);
+
+        std::cout << "{\"benchmark\":\"" << benchmark << "\""
+            << ",\"agents\":" << agents
+            << ",\"tasks\":" << TaskCount
+            << ",\"considerationsPerTask\":" << ConsiderationsPerTask
+            << ",\"samples\":" << latencies.size()
+            << ",\"p50Ns\":" << p50
+            << ",\"p99Ns\":" << percentile(latencies, 0.99)
+            << ",\"p50NsPerAgent\":" << static_cast<double>(p50) / agents
+            << "}" << std::endl;
+    }
+
+    std::vector<int> parseList(const std::string& list)
+    {
+        std::vector<int> values;
+        std::size_t start {0};
+
+        while (start < list.size())
+        {
+            auto comma = list.find(',', start);
+            values.push_back(std::stoi(list.substr(start, comma - start)));
+            start = comma == std::string::npos ? list.size() : comma + 1;
+        }
+
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> agentCounts {100, 1000, 5000, 10000};
+    int repeats {100};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument {argv[i]};
+        auto equals = argument.find('=');
+        auto name = argument.substr(0, equals);
+        auto value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        if (name == "--agents") agentCounts = parseList(value);
+        else if (name == "--repeats") repeats = std::stoi(value);
+        else
+        {
+            std::cerr << "unknown argument: " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    auto tasks = makeTasks();
+    auto bakedTasks = tasks;
+
+    for (auto& task : bakedTasks)
+    {
+        for (auto& consideration : task)
+        {
+            consideration.bakedFunction = bakeResponseCurve(consideration.function, BakedCurveMaxError);
+        }
+    }
+
+    std::mt19937 engine {1};
+    std::uniform_real_distribution<float> input {0.f, 1.f};
+    float checksum {0.f};
+
+    for (auto agents : agentCounts)
+    {
+        //inputs[consideration][agent], as if gathered from every agent's state
+        std::vector<std::vector<float>> inputs(TaskCount * ConsiderationsPerTask, std::vector<float>(agents));
+
+        for (auto& column : inputs)
+        {
+            std::generate(column.begin(), column.end(), [&] {return input(engine);});
+        }
+
+        std::vector<float> scores(agents);
+        std::vector<long> batched, baked, oneAtATime, bakedOneAtATime;
+        UtilityBatch batch;
+
+        auto scoreAll = [&](const std::vector<std::vector<Consideration>>& taskSet)
+        {
+            auto start = Clock::now();
+            batch.begin(agents);
+
+            for (int task = 0; task < TaskCount; task++)
+            {
+                batch.beginTask();
+
+                for (int i = 0; i < ConsiderationsPerTask; i++)
+                {
+                    batch.score(taskSet[task][i], inputs[task * ConsiderationsPerTask + i].data());
+                }
+
+                batch.finishTask(scores.data());
+                checksum += scores[0];
+            }
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        };
+
+        auto scoreEach = [&](const std::vector<std::vector<Consideration>>& taskSet)
+        {
+            auto start = Clock::now();
+            batch.begin(1);
+
+            for (int agent = 0; agent < agents; agent++)
+            {
+                for (int task = 0; task < TaskCount; task++)
+                {
+                    batch.beginTask();
+
+                    for (int i = 0; i < ConsiderationsPerTask; i++)
+                    {
+                        batch.score(taskSet[task][i], &inputs[task * ConsiderationsPerTask + i][agent]);
+                    }
+
+                    batch.finishTask(&scores[agent]);
+                }
+            }
+
+            checksum += scores[0];
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        };
+
+        for (int repeat = 0; repeat < repeats; repeat++)
+        {
+            batched.push_back(scoreAll(tasks));
+            baked.push_back(scoreAll(bakedTasks));
+            oneAtATime.push_back(scoreEach(tasks));
+            bakedOneAtATime.push_back(scoreEach(bakedTasks));
+        }
+
+        report("utilityBatch", agents, batched);
+        report("utilityBatchBaked", agents, baked);
+        report("utilityOneAtATime", agents, oneAtATime);
+        report("utilityOneAtATimeBaked", agents, bakedOneAtATime);
+    }
+
+    //keeps the scoring from being optimized away
+    std::cerr << "checksum " << checksum << std::endl;
+
+    return 0;
+}
@@ -25,12 +25,21 @@ SOFTWARE.
 #pragma once
 
 #include <iostream>
+#include <mutex>
 
 namespace AI
 {
+    //plan searches run on worker threads too, so lines are written one at a time
+    inline std::mutex& logMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
     template<typename... Params>
     void log(Params... params)
     {
+        std::lock_guard<std::mutex> lock {logMutex()};
         (std::cout << ... << params) << '\n';
     }
 }
\ No newline at end of file
@@ -23,23 +23,113 @@ SOFTWARE.
 */
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <algorithm>
 #include "Utility.h"
 #include "UE_Replacements.h"
 #include "HierarchicalTaskNetworkComponent.h"
+#include "Recording.h"
 
 using namespace AI;
 
-int main()
+void setupWorld(World& world)
 {
-    GameMode mode;
-    World world{&mode};
-
     auto actor = world.createActor();
     auto component = actor->addComponent(std::make_unique<HierarchicalTaskNetworkComponent>(actor));
     component->initializeComponent();
+}
+
+/*
+aitu [--ticks=N] [--record=file]
+    runs N ticks (default 1), optionally recording them
+aitu --replay=file
+    replays a recording as fast as possible, reporting where it diverged and the slowest ticks
+*/
+int main(int argc, char** argv)
+{
+    int ticks {1};
+    std::string recordPath;
+    std::string replayPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg {argv[i]};
+
+        if (arg.compare(0, 8, "--ticks=") == 0)
+        {
+            ticks = std::stoi(arg.substr(8));
+        }
+        else if (arg.compare(0, 9, "--record=") == 0)
+        {
+            recordPath = arg.substr(9);
+        }
+        else if (arg.compare(0, 9, "--replay=") == 0)
+        {
+            replayPath = arg.substr(9);
+        }
+    }
+
+    GameMode mode;
+    World world{&mode};
+
+    if (!replayPath.empty())
+    {
+        std::ifstream file {replayPath, std::ios::binary};
+        TickReplayer replayer {{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}}};
+
+        if (!replayer.begin())
+        {
+            std::cerr << replayPath << " isn't a recording" << std::endl;
+            return 1;
+        }
+
+        mode.setSeed(replayer.getSeed());
+        mode.setPlanWorkerCount(0);
+        setupWorld(world);
+
+        while (replayer.step(mode, world)) {}
+
+        auto& times = replayer.getTickMilliseconds();
+        auto slowest = std::max_element(times.begin(), times.end());
+
+        std::cout << "replayed " << replayer.getTickCount() << " ticks";
+
+        if (slowest != times.end())
+        {
+            std::cout << ", slowest was tick " << (slowest - times.begin()) << " at " << *slowest << "ms";
+        }
+
+        std::cout << std::endl;
+
+        if (replayer.getFirstMismatch() != -1)
+        {
+            std::cout << "diverged from the recording at tick " << replayer.getFirstMismatch() << std::endl;
+        }
+
+        return replayer.failed() || replayer.getFirstMismatch() != -1 ? 1 : 0;
+    }
+
+    if (!recordPath.empty())
+    {
+        mode.startRecording();
+    }
+
+    setupWorld(world);
+
+    for (int i = 0; i < ticks; i++)
+    {
+        mode.tick();
+    }
 
-    mode.tick();
+    if (!recordPath.empty())
+    {
+        auto& log = mode.getRecorder()->getLog();
+        std::ofstream file {recordPath, std::ios::binary};
+        file.write(reinterpret_cast<const char*>(log.data()), log.size());
+    }
 
     return 0;
 }
\ No newline at end of file
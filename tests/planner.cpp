@@ -0,0 +1,482 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "catch.hpp"
+
+#include "../Planner.h"
+#include "../PlanWorkers.h"
+#include "../Consideration.h"
+
+using namespace AI;
+
+namespace
+{
+    WorldState makeState(bool playerIdentified, float alertness)
+    {
+        WorldState state;
+        state.current.flags[WorldStateIdentifier::PlayerIdentified] = playerIdentified;
+        state.current.values[WorldStateIdentifier::Alertness] = alertness;
+        state.current.vectors[WorldStateIdentifier::CurrentPosition] = {};
+        state.current.vectors[WorldStateIdentifier::PlayerPosition] = {1000.f, 1000.f, 1000.f};
+        state.facts.vectors[ConsumableFact::Player_LastKnownLocation] = {};
+
+        return state;
+    }
+}
+
+TEST_CASE("plan cache", "[planner]") {
+    auto tasks = setupTasks();
+    PlanCache cache;
+    WorldQuerier querier;
+    TaskParameters parameters;
+
+    SECTION("the second request for the same goal is a hit") {
+        auto state = makeState(false, 0.f);
+        auto first = generatePlan(tasks.tasks[TaskIdentifier::Wander], state, querier, parameters, tasks, cache);
+        auto second = generatePlan(tasks.tasks[TaskIdentifier::Wander], state, querier, parameters, tasks, cache);
+
+        REQUIRE(cache.getMisses() == 1);
+        REQUIRE(cache.getHits() == 1);
+        REQUIRE(first.size() == second.size());
+        REQUIRE(second.currentTask == 0);
+        REQUIRE(first.planTemplate == second.planTemplate);
+    }
+
+    SECTION("states that agree on every condition read share a plan") {
+        auto alert = makeState(true, 100.f);
+        auto lessAlert = makeState(true, 90.f);
+        auto calm = makeState(true, 10.f);
+
+        auto chase = generatePlan(tasks.tasks[TaskIdentifier::Chase], alert, querier, parameters, tasks, cache);
+        REQUIRE(!chase.failed);
+
+        generatePlan(tasks.tasks[TaskIdentifier::Chase], lessAlert, querier, parameters, tasks, cache);
+        REQUIRE(cache.getHits() == 1);
+
+        auto failed = generatePlan(tasks.tasks[TaskIdentifier::Chase], calm, querier, parameters, tasks, cache);
+        REQUIRE(cache.getMisses() == 2);
+        REQUIRE(failed.failed);
+    }
+
+    SECTION("changing the task database invalidates the cache") {
+        auto state = makeState(false, 0.f);
+        generatePlan(tasks.tasks[TaskIdentifier::Wander], state, querier, parameters, tasks, cache);
+
+        tasks.addTask(TaskIdentifier::Relax, Task{"relax"});
+        generatePlan(tasks.tasks[TaskIdentifier::Wander], state, querier, parameters, tasks, cache);
+
+        REQUIRE(cache.getHits() == 0);
+        REQUIRE(cache.getMisses() == 2);
+    }
+
+    SECTION("plans are only shared between searches with the same settings") {
+        auto state = makeState(true, 100.f);
+
+        auto search = [&](bool simulateEffects)
+        {
+            PlanSearch search;
+            search.setSimulateEffects(simulateEffects);
+            search.start(tasks.tasks[TaskIdentifier::Chase], state, tasks, &cache);
+            while (!search.step(64)) {}
+            return search.takePlan(state, querier);
+        };
+
+        search(false);
+        search(true);
+
+        REQUIRE(cache.getHits() == 0);
+        REQUIRE(cache.getMisses() == 2);
+
+        search(false);
+        search(true);
+
+        REQUIRE(cache.getHits() == 2);
+    }
+}
+
+TEST_CASE("task instances sharing an identifier", "[planner]") {
+    TaskDatabase tasks;
+    WorldQuerier querier;
+    TaskParameters parameters;
+
+    Task identify {"identify"};
+    identify.postconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+
+    Task lookAway {"lookAway"};
+    lookAway.postconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, false});
+
+    Task goal {"goal"};
+    goal.preconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+
+    auto first = tasks.addTask(TaskIdentifier::Stare, identify);
+    auto second = tasks.addTask(TaskIdentifier::Stare, lookAway);
+    tasks.addTask(TaskIdentifier::Search, goal);
+
+    REQUIRE(first != second);
+
+    auto state = makeState(false, 0.f);
+    auto plan = generatePlan(tasks.tasks[TaskIdentifier::Search], state, querier, parameters, tasks);
+
+    REQUIRE(!plan.failed);
+    REQUIRE(plan.size() == 2);
+    REQUIRE(plan.getTask(0).debugName == "identify");
+    REQUIRE(plan.getTask(1).debugName == "goal");
+}
+
+TEST_CASE("tasks with too many parameters", "[planner]") {
+    TaskDatabase tasks;
+
+    Task relax {"relax"};
+    relax.parameters.values.resize(MaxTaskParameters);
+    REQUIRE(tasks.addTask(TaskIdentifier::Relax, relax) == 0);
+
+    SECTION("are refused") {
+        relax.parameters.values.push_back(1.f);
+
+        REQUIRE(relax.parameters.values.size() == MaxTaskParameters);
+        REQUIRE(tasks.addTask(TaskIdentifier::Relax, relax) == -1);
+        REQUIRE(tasks.taskInstances.size() == 1);
+    }
+
+    SECTION("are refused as subtasks") {
+        Task parent {"parent", TaskType::Compound};
+        relax.parameters.vectors.resize(MaxTaskParameters + 1);
+        parent.subtasks.push_back(relax);
+
+        REQUIRE(tasks.addTask(TaskIdentifier::Browse, parent) == -1);
+    }
+}
+
+TEST_CASE("packed conditions", "[planner]") {
+    Condition condition;
+    condition.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::GreaterThan, 50.f});
+    condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::LessEqual, 90.f});
+    condition.pack();
+
+    REQUIRE(condition.packed.count() == 2);
+    REQUIRE(!condition.packed.contradictory);
+
+    SECTION("ranges are intersected") {
+        REQUIRE(condition.packed.isTrue(makeState(true, 90.f)));
+        REQUIRE(!condition.packed.isTrue(makeState(true, 50.f)));
+        REQUIRE(!condition.packed.isTrue(makeState(true, 95.f)));
+        REQUIRE(!condition.packed.isTrue(makeState(false, 60.f)));
+    }
+
+    SECTION("impossible requirements are contradictory") {
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::LessThan, 10.f});
+        condition.pack();
+
+        REQUIRE(condition.packed.contradictory);
+        REQUIRE(!condition.packed.isTrue(makeState(true, 60.f)));
+    }
+
+    SECTION("every excluded value is kept") {
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 70.f});
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 80.f});
+        condition.pack();
+
+        REQUIRE(!condition.packed.contradictory);
+        REQUIRE(condition.packed.excludedCounts[static_cast<int>(WorldStateIdentifier::Alertness)] == 2);
+        REQUIRE(condition.packed.isTrue(makeState(true, 60.f)));
+        REQUIRE(!condition.packed.isTrue(makeState(true, 70.f)));
+        REQUIRE(!condition.packed.isTrue(makeState(true, 80.f)));
+    }
+
+    SECTION("exclusions outside the range are dropped") {
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 10.f});
+        condition.pack();
+
+        REQUIRE(!condition.packed.contradictory);
+        REQUIRE(!(condition.packed.excludedMask & (1u << static_cast<int>(WorldStateIdentifier::Alertness))));
+    }
+
+    SECTION("excluding the only allowed value is contradictory") {
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::EqualTo, 70.f});
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 80.f});
+        condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 70.f});
+        condition.pack();
+
+        REQUIRE(condition.packed.contradictory);
+    }
+}
+
+TEST_CASE("compiled conditions", "[planner]") {
+    std::vector<SatisfiablePredicate> predicates;
+    predicates.push_back({SatisfiablePredicateIdentifier::ParameterFlag,
+        [](const WorldState&, const TaskParameters& parameters, int parameterIndex)
+        {
+            return parameters.vectors[parameterIndex].x != 0;
+        }});
+
+    Condition condition;
+    condition.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::GreaterThan, 50.f});
+    condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 70.f});
+    condition.requiredValues.push_back({WorldStateIdentifier::Alertness, ConditionOp::NotEqualTo, 80.f});
+    condition.consumableVectors.push_back(ConsumableFact::Player_LastKnownLocation);
+    condition.satisfiedPredicates.push_back({SatisfiablePredicateIdentifier::ParameterFlag, 0});
+    condition.compile(predicates);
+
+    TaskParameters parameters;
+    parameters.vectors.push_back({1.f, 0.f, 0.f});
+
+    REQUIRE(condition.program.size() == 6);
+    REQUIRE(condition.program.back().code == ConditionOpCode::Predicate);
+    REQUIRE(condition.getPredicate(0) != nullptr);
+
+    for (auto alertness : {10.f, 60.f, 70.f, 80.f, 90.f})
+    {
+        for (auto playerIdentified : {false, true})
+        {
+            auto state = makeState(playerIdentified, alertness);
+            state.produceFactVector(ConsumableFact::Player_LastKnownLocation, {});
+            REQUIRE(condition.isTrue(state, parameters, predicates) == condition.interpret(state, parameters, predicates));
+        }
+    }
+
+    auto state = makeState(true, 60.f);
+    state.produceFactVector(ConsumableFact::Player_LastKnownLocation, {});
+    REQUIRE(condition.isTrue(state, parameters, predicates));
+
+    SECTION("predicates are skipped for merged conditions") {
+        parameters.vectors[0].x = 0.f;
+
+        REQUIRE(!condition.isTrue(state, parameters, predicates));
+        REQUIRE(condition.isTrue(state, parameters, predicates, true));
+    }
+
+    SECTION("consumed facts are false") {
+        state.consumeFactVector(ConsumableFact::Player_LastKnownLocation);
+
+        REQUIRE(!condition.isTrue(state, parameters, predicates));
+        REQUIRE(!condition.interpret(state, parameters, predicates));
+    }
+}
+
+TEST_CASE("plan search can be stepped", "[planner]") {
+    auto tasks = setupTasks();
+    WorldQuerier querier;
+    TaskParameters parameters;
+    auto state = makeState(true, 100.f);
+
+    auto expected = generatePlan(tasks.tasks[TaskIdentifier::Chase], state, querier, parameters, tasks);
+
+    PlanSearch search;
+    search.start(tasks.tasks[TaskIdentifier::Chase], state, tasks);
+
+    int steps = 0;
+    while (!search.step(1))
+    {
+        steps++;
+        REQUIRE(search.isRunning());
+    }
+
+    REQUIRE(steps + 1 == search.getExpandedCount());
+
+    auto plan = search.takePlan(state, querier);
+
+    REQUIRE(plan.failed == expected.failed);
+    REQUIRE(plan.getPlanPath() == expected.getPlanPath());
+}
+
+TEST_CASE("plan workers", "[planner]") {
+    auto tasks = setupTasks();
+    WorldQuerier querier;
+    TaskParameters parameters;
+    PlanCache cache;
+    auto state = makeState(true, 100.f);
+
+    auto expected = generatePlan(tasks.tasks[TaskIdentifier::Chase], state, querier, parameters, tasks);
+
+    PlanWorkerPool workers {2};
+    std::vector<std::future<Plan>> results;
+
+    for (int i = 0; i < 8; i++)
+    {
+        results.push_back(workers.submit(tasks.tasks[TaskIdentifier::Chase], state, tasks, &cache));
+    }
+
+    for (auto& result : results)
+    {
+        auto plan = instantiatePlan(result.get(), state, querier);
+
+        REQUIRE(plan.failed == expected.failed);
+        REQUIRE(plan.getPlanPath() == expected.getPlanPath());
+    }
+
+    REQUIRE(cache.getHits() + cache.getMisses() == 8);
+
+    SECTION("destroying the pool finishes what's queued") {
+        std::vector<std::future<Plan>> queued;
+
+        {
+            PlanWorkerPool pool {1};
+
+            for (int i = 0; i < 16; i++)
+            {
+                queued.push_back(pool.submit(tasks.tasks[TaskIdentifier::Chase], state, tasks));
+            }
+        }
+
+        for (auto& result : queued)
+        {
+            REQUIRE(result.valid());
+            REQUIRE(result.get().getPlanPath() == expected.getPlanPath());
+        }
+    }
+}
+
+TEST_CASE("relaxed heuristic", "[planner]") {
+    //the goal can be reached in four tasks, or through a ladder of consumable facts
+    //that looks just as promising to an unsatisfied count but bottoms out at a flag nothing sets
+    TaskDatabase tasks;
+
+    Task goal {"goal"};
+    goal.preconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    auto goalVertex = tasks.addTask(TaskIdentifier::Search, goal);
+
+    Task decoy {"decoy"};
+    decoy.postconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    decoy.preconditions.consumableFlags.push_back(ConsumableFact::Player_LastKnownLocation);
+    tasks.addTask(TaskIdentifier::Stare, decoy);
+
+    for (int i = 0; i < ConsumableFactCount; i++)
+    {
+        Task rung {"rung"};
+        rung.postconditions.consumableFlags.push_back(static_cast<ConsumableFact>(i));
+
+        if (i + 1 < ConsumableFactCount)
+        {
+            rung.preconditions.consumableFlags.push_back(static_cast<ConsumableFact>(i + 1));
+        }
+        else
+        {
+            rung.preconditions.requiredFlags.push_back({WorldStateIdentifier::Stance, true});
+        }
+
+        tasks.addTask(TaskIdentifier::FollowPath, rung);
+    }
+
+    Task identify {"identify"};
+    identify.postconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    identify.preconditions.requiredFlags.push_back({WorldStateIdentifier::Boredom, true});
+    tasks.addTask(TaskIdentifier::Stare, identify);
+
+    Task bore {"bore"};
+    bore.postconditions.requiredFlags.push_back({WorldStateIdentifier::Boredom, true});
+    bore.preconditions.requiredFlags.push_back({WorldStateIdentifier::Curiosity, true});
+    tasks.addTask(TaskIdentifier::Wander, bore);
+
+    Task intrigue {"intrigue"};
+    intrigue.postconditions.requiredFlags.push_back({WorldStateIdentifier::Curiosity, true});
+    tasks.addTask(TaskIdentifier::Browse, intrigue);
+    tasks.buildRelaxedGraph();
+
+    WorldState state;
+    state.current.flags[WorldStateIdentifier::PlayerIdentified] = false;
+    state.current.flags[WorldStateIdentifier::Boredom] = false;
+    state.current.flags[WorldStateIdentifier::Curiosity] = false;
+    state.current.flags[WorldStateIdentifier::Stance] = false;
+
+    auto search = [&](SearchHeuristic heuristic)
+    {
+        PlanSearch search;
+        search.setHeuristic(heuristic);
+        search.start(tasks.taskInstances[goalVertex], state, tasks);
+        search.run();
+
+        auto plan = search.takeResult();
+        REQUIRE(!plan.failed);
+        REQUIRE(plan.getPlanPath().size() == 4);
+
+        return search.getExpandedCount();
+    };
+
+    REQUIRE(search(SearchHeuristic::RelaxedMaxCost) < search(SearchHeuristic::UnsatisfiedCount));
+
+    SECTION("falls back to counting while the relaxed graph is out of date") {
+        tasks.addTask(TaskIdentifier::Relax, Task{"relax"});
+
+        REQUIRE(search(SearchHeuristic::RelaxedMaxCost) == search(SearchHeuristic::UnsatisfiedCount));
+    }
+}
+
+TEST_CASE("simulated effects", "[planner]") {
+    //clumsy identifies the player in one step, but knocks over the stance the goal needs doing so
+    TaskDatabase tasks;
+
+    Task goal {"goal"};
+    goal.preconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    goal.preconditions.requiredFlags.push_back({WorldStateIdentifier::Stance, true});
+    auto goalVertex = tasks.addTask(TaskIdentifier::Search, goal);
+
+    Task clumsy {"clumsy"};
+    clumsy.postconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    clumsy.modifiedFlags[WorldStateIdentifier::Stance] = false;
+    tasks.addTask(TaskIdentifier::Stare, clumsy);
+
+    Task careful {"careful"};
+    careful.postconditions.requiredFlags.push_back({WorldStateIdentifier::PlayerIdentified, true});
+    careful.preconditions.requiredFlags.push_back({WorldStateIdentifier::Boredom, true});
+    tasks.addTask(TaskIdentifier::Stare, careful);
+
+    Task bore {"bore"};
+    bore.postconditions.requiredFlags.push_back({WorldStateIdentifier::Boredom, true});
+    tasks.addTask(TaskIdentifier::Wander, bore);
+
+    WorldState state;
+    state.current.flags[WorldStateIdentifier::PlayerIdentified] = false;
+    state.current.flags[WorldStateIdentifier::Boredom] = false;
+    state.current.flags[WorldStateIdentifier::Stance] = true;
+
+    auto search = [&](bool simulateEffects)
+    {
+        PlanSearch search;
+        search.setSimulateEffects(simulateEffects);
+        search.start(tasks.taskInstances[goalVertex], state, tasks);
+        search.run();
+
+        auto plan = search.takeResult();
+        REQUIRE(!plan.failed);
+
+        return plan;
+    };
+
+    SECTION("ignoring effects picks the shorter plan that can't work") {
+        auto plan = search(false);
+
+        REQUIRE(plan.size() == 2);
+        REQUIRE(plan.getTask(0).debugName == "clumsy");
+    }
+
+    SECTION("simulating effects prunes it") {
+        auto plan = search(true);
+
+        REQUIRE(plan.size() == 3);
+        REQUIRE(plan.getTask(0).debugName == "bore");
+        REQUIRE(plan.getTask(1).debugName == "careful");
+    }
+}
@@ -0,0 +1,444 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "catch.hpp"
+
+#include <cmath>
+#include <limits>
+#include "../UtilityBatch.h"
+#include "../Utility.h"
+#include "../HierarchicalTaskNetworkComponent.h"
+
+using namespace AI;
+
+namespace
+{
+    FunctionDefinition makeFunction(FunctionType type)
+    {
+        FunctionDefinition function;
+        function.type = type;
+
+        switch (type)
+        {
+            case FunctionType::Logistic: function.logistic = {1.f, 10.f, 0.5f}; break;
+            case FunctionType::Quadratic: function.quadratic = {2.f, -1.f, 0.25f}; break;
+            case FunctionType::Exponential: function.exponential = {3.f}; break;
+            case FunctionType::Gaussian: function.gaussian = {1.f, 0.5f, 0.2f}; break;
+            case FunctionType::Step: function.step = {0.5f}; break;
+            case FunctionType::Linear: break;
+        }
+
+        return function;
+    }
+
+    Consideration makeConsideration(FunctionType type, int group, bool useSubsetMax)
+    {
+        Consideration consideration;
+        consideration.type = ConsiderationType::Scalar;
+        consideration.function = makeFunction(type);
+        consideration.group = group;
+        consideration.useSubsetMax = useSubsetMax;
+
+        return consideration;
+    }
+}
+
+TEST_CASE("response curves", "[utility]") {
+    std::vector<float> inputs;
+
+    for (int i = 0; i <= 21; i++)
+    {
+        inputs.push_back(i / 20.f - 0.025f);
+    }
+
+    std::vector<float> outputs(inputs.size());
+
+    SECTION("match the formulas") {
+        auto function = makeFunction(FunctionType::Logistic);
+        function.verticalStretch = 2.f;
+        function.horizontalOffset = 0.1f;
+        evaluateResponseCurve(function, inputs.data(), outputs.data(), inputs.size());
+
+        for (std::size_t i = 0; i < inputs.size(); i++)
+        {
+            auto x = inputs[i] + 0.1f;
+            REQUIRE(outputs[i] == Approx(2.f / (1 + std::exp(-10.f * (x - 0.5f)))));
+        }
+
+        function = makeFunction(FunctionType::Exponential);
+        evaluateResponseCurve(function, inputs.data(), outputs.data(), inputs.size());
+
+        for (std::size_t i = 0; i < inputs.size(); i++)
+        {
+            REQUIRE(outputs[i] == Approx(std::pow(3.f, inputs[i])));
+        }
+
+        function = makeFunction(FunctionType::Gaussian);
+        evaluateResponseCurve(function, inputs.data(), outputs.data(), inputs.size());
+
+        for (std::size_t i = 0; i < inputs.size(); i++)
+        {
+            auto b = inputs[i] - 0.5f;
+            REQUIRE(outputs[i] == Approx(std::exp(-(b * b) / (0.4f * 0.4f))));
+        }
+
+        function = makeFunction(FunctionType::Step);
+        evaluateResponseCurve(function, inputs.data(), outputs.data(), inputs.size());
+
+        for (std::size_t i = 0; i < inputs.size(); i++)
+        {
+            REQUIRE(outputs[i] == (inputs[i] >= 0.5f ? 1.f : 0.f));
+        }
+    }
+}
+
+TEST_CASE("utility batches", "[utility]") {
+    const int agents {7};
+    float low[agents], high[agents];
+
+    for (int i = 0; i < agents; i++)
+    {
+        low[i] = i / 10.f;
+        high[i] = 1.f - i / 10.f;
+    }
+
+    UtilityBatch batch;
+    batch.begin(agents);
+    batch.beginTask();
+    batch.score(makeConsideration(FunctionType::Linear, 0, false), high);
+    batch.score(makeConsideration(FunctionType::Linear, 1, true), low);
+    batch.score(makeConsideration(FunctionType::Linear, 2, true), high);
+    batch.score(makeConsideration(FunctionType::Quadratic, 2, true), low);
+
+    float scores[agents];
+    batch.finishTask(scores);
+
+    for (int i = 0; i < agents; i++)
+    {
+        auto quadratic = 2.f * low[i] * low[i] - low[i] + 0.25f;
+        REQUIRE(scores[i] == Approx(high[i] * std::max(low[i], high[i] * quadratic)));
+    }
+
+    SECTION("without subset max groups the base score is used") {
+        batch.beginTask();
+        batch.score(makeConsideration(FunctionType::Linear, 0, false), low);
+        batch.score(makeConsideration(FunctionType::Linear, 0, false), high);
+        batch.finishTask(scores);
+
+        for (int i = 0; i < agents; i++)
+        {
+            REQUIRE(scores[i] == Approx(low[i] * high[i]));
+        }
+    }
+}
+
+TEST_CASE("baked response curves", "[utility]") {
+    const float maxError {0.001f};
+
+    SECTION("stay within the error bound of the formula") {
+        for (auto type : {FunctionType::Logistic, FunctionType::Exponential, FunctionType::Gaussian})
+        {
+            auto function = makeFunction(type);
+            function.horizontalStretch = 1.5f;
+            function.horizontalOffset = -0.2f;
+            function.verticalStretch = 0.8f;
+            function.verticalOffset = 0.1f;
+
+            auto table = bakeResponseCurve(function, maxError);
+            REQUIRE_FALSE(table.samples.empty());
+
+            std::vector<float> inputs;
+
+            //including inputs outside the table, which fall back to the formula
+            for (int i = -100; i <= 1100; i++)
+            {
+                inputs.push_back(i / 1000.f);
+            }
+
+            std::vector<float> baked(inputs.size()), analytic(inputs.size());
+            evaluateCurveTable(table, function, inputs.data(), baked.data(), inputs.size());
+            evaluateResponseCurve(function, inputs.data(), analytic.data(), inputs.size());
+
+            for (std::size_t i = 0; i < inputs.size(); i++)
+            {
+                REQUIRE(std::abs(baked[i] - analytic[i]) <= maxError + 1e-5f);
+            }
+        }
+    }
+
+    SECTION("curves without exp or pow aren't baked") {
+        REQUIRE(bakeResponseCurve(makeFunction(FunctionType::Step), maxError).samples.empty());
+        REQUIRE(bakeResponseCurve(makeFunction(FunctionType::Quadratic), maxError).samples.empty());
+    }
+
+    SECTION("batches of one agent use the table") {
+        auto consideration = makeConsideration(FunctionType::Logistic, 0, false);
+        consideration.bakedFunction = bakeResponseCurve(consideration.function, maxError);
+
+        UtilityBatch batch;
+        batch.begin(1);
+
+        for (auto input : {0.f, 0.25f, 0.5f, 0.75f, 1.f})
+        {
+            float score, baked;
+            batch.beginTask();
+            batch.score(consideration, &input);
+            batch.finishTask(&score);
+            evaluateCurveTable(consideration.bakedFunction, consideration.function, &input, &baked, 1);
+
+            REQUIRE(score == baked);
+            REQUIRE(std::abs(score - 1.f / (1 + std::exp(-10.f * (input - 0.5f)))) <= maxError + 1e-5f);
+        }
+    }
+
+    SECTION("baking can be turned off again") {
+        TaskDatabase tasks;
+        tasks.considerations[TaskIdentifier::Wander] = {makeConsideration(FunctionType::Logistic, 0, false)};
+        auto& consideration = tasks.considerations[TaskIdentifier::Wander][0];
+
+        REQUIRE(consideration.bakedFunction.samples.empty());
+
+        tasks.bakeResponseCurves(maxError);
+        REQUIRE_FALSE(consideration.bakedFunction.samples.empty());
+
+        tasks.bakeResponseCurves(0.f);
+        REQUIRE(consideration.bakedFunction.samples.empty());
+    }
+}
+
+TEST_CASE("consideration inputs", "[utility]") {
+    TaskDatabase tasks;
+
+    auto scalar = makeConsideration(FunctionType::Linear, 0, false);
+    scalar.scalar.identifier = WorldStateIdentifier::Curiosity;
+
+    auto distance = makeConsideration(FunctionType::Linear, 0, false);
+    distance.type = ConsiderationType::Distance;
+    distance.distance = {WorldStateIdentifier::CurrentPosition, WorldStateIdentifier::PlayerPosition};
+
+    auto repeat = makeConsideration(FunctionType::Linear, 1, true);
+    repeat.type = ConsiderationType::Repeat;
+    repeat.repeat.identifier = TaskIdentifier::Wander;
+
+    auto predicate = makeConsideration(FunctionType::Linear, 0, false);
+    predicate.type = ConsiderationType::Predicate;
+
+    tasks.considerations[TaskIdentifier::Wander] = {scalar, distance};
+    tasks.considerations[TaskIdentifier::Browse] = {repeat};
+    tasks.considerations[TaskIdentifier::Chase] = {predicate};
+    tasks.findConsiderationInputs();
+
+    auto curiosityChanged = StateMask{};
+    curiosityChanged.values = 1u << static_cast<int>(WorldStateIdentifier::Curiosity);
+    auto positionChanged = StateMask{};
+    positionChanged.vectors = 1u << static_cast<int>(WorldStateIdentifier::PlayerPosition);
+    auto history = 0u | InputSource::TaskHistory;
+
+    SECTION("considerations only see the changes to what they read") {
+        auto& wander = tasks.considerations[TaskIdentifier::Wander];
+
+        REQUIRE(wander[0].inputs.changedIn(curiosityChanged, 0));
+        REQUIRE_FALSE(wander[0].inputs.changedIn(positionChanged, history));
+        REQUIRE(wander[1].inputs.changedIn(positionChanged, 0));
+        REQUIRE_FALSE(wander[1].inputs.changedIn(curiosityChanged, history));
+        REQUIRE(tasks.considerations[TaskIdentifier::Browse][0].inputs.changedIn({}, history));
+        REQUIRE_FALSE(tasks.considerations[TaskIdentifier::Browse][0].inputs.changedIn(curiosityChanged, 0));
+        REQUIRE(tasks.considerations[TaskIdentifier::Chase][0].inputs.changedIn({}, 0));
+    }
+
+    SECTION("tasks read what their considerations do") {
+        auto& wander = tasks.considerationInputs[TaskIdentifier::Wander];
+
+        REQUIRE(wander.changedIn(curiosityChanged, 0));
+        REQUIRE(wander.changedIn(positionChanged, 0));
+        REQUIRE_FALSE(wander.changedIn({}, history));
+        REQUIRE_FALSE(tasks.considerationInputs[TaskIdentifier::Browse].changedIn(positionChanged, 0));
+    }
+
+    SECTION("cached responses score the same as scoring") {
+        UtilityBatch batch;
+        batch.begin(1);
+
+        auto first = makeConsideration(FunctionType::Logistic, 0, false);
+        auto second = makeConsideration(FunctionType::Gaussian, 1, true);
+        float inputs[] {0.3f, 0.6f};
+        float responses[2];
+
+        batch.beginTask();
+        batch.score(first, &inputs[0]);
+        batch.score(second, &inputs[1]);
+        float scored;
+        batch.finishTask(&scored);
+
+        batch.evaluate(first, &inputs[0], &responses[0]);
+        batch.evaluate(second, &inputs[1], &responses[1]);
+        batch.beginTask();
+        batch.scoreResponses(first, &responses[0]);
+        batch.scoreResponses(second, &responses[1]);
+        float cached;
+        batch.finishTask(&cached);
+
+        REQUIRE(cached == Approx(scored));
+    }
+}
+
+TEST_CASE("score bounds", "[utility]") {
+    const auto infinity = std::numeric_limits<float>::infinity();
+
+    SECTION("response bounds hold every response in their range") {
+        for (auto type : {FunctionType::Logistic, FunctionType::Quadratic, FunctionType::Exponential, 
+            FunctionType::Gaussian, FunctionType::Step, FunctionType::Linear})
+        {
+            for (auto verticalStretch : {0.8f, -1.5f})
+            {
+                auto function = makeFunction(type);
+                function.horizontalStretch = 1.5f;
+                function.horizontalOffset = -0.2f;
+                function.verticalStretch = verticalStretch;
+                function.verticalOffset = 0.1f;
+
+                auto bounds = responseBounds(function, 0.f, 1.f);
+                REQUIRE(std::isfinite(bounds.min));
+                REQUIRE(std::isfinite(bounds.max));
+
+                std::vector<float> inputs;
+
+                for (int i = 0; i <= 1000; i++)
+                {
+                    inputs.push_back(i / 1000.f);
+                }
+
+                std::vector<float> outputs(inputs.size());
+                evaluateResponseCurve(function, inputs.data(), outputs.data(), inputs.size());
+
+                for (auto y : outputs)
+                {
+                    REQUIRE(y >= bounds.min);
+                    REQUIRE(y <= bounds.max);
+                }
+            }
+        }
+    }
+
+    SECTION("unbounded inputs") {
+        auto logistic = responseBounds(makeFunction(FunctionType::Logistic), -infinity, infinity);
+        REQUIRE(logistic.min == Approx(0.f).margin(1e-4f));
+        REQUIRE(logistic.max == Approx(1.f).epsilon(1e-4f));
+
+        auto gaussian = responseBounds(makeFunction(FunctionType::Gaussian), 0.f, infinity);
+        REQUIRE(gaussian.max == Approx(1.f).epsilon(1e-4f));
+
+        REQUIRE(responseBounds(makeFunction(FunctionType::Quadratic), -infinity, infinity).max == infinity);
+        REQUIRE(responseBounds(makeFunction(FunctionType::Linear), 0.f, infinity).max == infinity);
+    }
+
+    SECTION("baked curves are widened by their table's error") {
+        auto function = makeFunction(FunctionType::Logistic);
+        auto table = bakeResponseCurve(function, 0.01f);
+        REQUIRE(responseBounds(function, 0.f, 1.f, &table).max >= responseBounds(function, 0.f, 1.f).max + 0.01f);
+    }
+
+    SECTION("task bounds hold the score finishTask gives") {
+        std::vector<Consideration> considerations {
+            makeConsideration(FunctionType::Logistic, 0, false),
+            makeConsideration(FunctionType::Quadratic, 0, false),
+            makeConsideration(FunctionType::Gaussian, 1, true),
+            makeConsideration(FunctionType::Exponential, 2, true)
+        };
+
+        std::vector<ScoreBounds> bounds;
+
+        for (auto& consideration : considerations)
+        {
+            bounds.push_back(responseBounds(consideration.function, 0.f, 1.f));
+        }
+
+        auto task = taskBounds(considerations, bounds.data());
+
+        UtilityBatch batch;
+        batch.begin(1);
+
+        for (int i = 0; i <= 100; i++)
+        {
+            auto input = i / 100.f;
+            float score;
+            batch.beginTask();
+
+            for (auto& consideration : considerations)
+            {
+                batch.score(consideration, &input);
+            }
+
+            batch.finishTask(&score);
+
+            REQUIRE(score >= task.min);
+            REQUIRE(score <= task.max);
+        }
+
+        //once every response is known the bounds are the score
+        float input {0.5f}, score;
+        batch.beginTask();
+
+        for (std::size_t i = 0; i < considerations.size(); i++)
+        {
+            float response;
+            batch.evaluate(considerations[i], &input, &response);
+            batch.scoreResponses(considerations[i], &response);
+            bounds[i] = {response, response};
+        }
+
+        batch.finishTask(&score);
+        task = taskBounds(considerations, bounds.data());
+        REQUIRE(task.min == Approx(score));
+        REQUIRE(task.max == Approx(score));
+    }
+}
+
+TEST_CASE("goal commitment", "[utility]") {
+    GoalCommitment commitment;
+    commitment.minimumDuration = 0.5f;
+    commitment.margin = 0.05f;
+    commitment.inertia = 0.2f;
+    commitment.inertiaHalfLife = 1.f;
+
+    SECTION("goals are kept for the minimum duration") {
+        REQUIRE_FALSE(commitment.allowsSwitch(0.25f, 0.f, 1.f));
+        REQUIRE(commitment.allowsSwitch(0.5f, 0.f, 1.f));
+    }
+
+    SECTION("a new goal has to beat the current one by the margin and inertia") {
+        //after a second the inertia has halved to 0.1
+        REQUIRE_FALSE(commitment.allowsSwitch(1.f, 0.5f, 0.64f));
+        REQUIRE(commitment.allowsSwitch(1.f, 0.5f, 0.66f));
+    }
+
+    SECTION("inertia decays") {
+        REQUIRE_FALSE(commitment.allowsSwitch(1.f, 0.5f, 0.6f));
+        REQUIRE(commitment.allowsSwitch(10.f, 0.5f, 0.6f));
+    }
+
+    SECTION("the defaults hold on to nothing") {
+        REQUIRE(GoalCommitment{}.allowsSwitch(0.f, 0.5f, 0.5f));
+        REQUIRE(GoalCommitment{}.allowsSwitch(0.f, 0.5f, 0.51f));
+    }
+}
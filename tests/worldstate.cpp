@@ -0,0 +1,595 @@
+/*
+MIT License
+
+Copyright (c) 2016 Patrick Lafferty
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "catch.hpp"
+
+#include <thread>
+#include <atomic>
+
+#include "../WorldState.h"
+#include "../Tasks.h"
+#include "../AgentStateTable.h"
+#include "../Snapshot.h"
+#include "../Recording.h"
+#include "../SquadBlackboard.h"
+#include "../StateDelta.h"
+#include "../HierarchicalTaskNetworkComponent.h"
+
+using namespace AI;
+
+TEST_CASE("state maps", "[worldstate]") {
+    WorldState state;
+
+    SECTION("keys start out absent") {
+        REQUIRE(state.current.flags.empty());
+        REQUIRE(state.current.values.find(WorldStateIdentifier::Alertness) == end(state.current.values));
+        REQUIRE(state.current.values.at(WorldStateIdentifier::Alertness) == 0.f);
+        REQUIRE(state.current.values.empty());
+    }
+
+    SECTION("operator[] marks a key present and iteration is in key order") {
+        state.current.values[WorldStateIdentifier::Curiosity] = 2.f;
+        state.current.values[WorldStateIdentifier::Alertness] = 1.f;
+
+        REQUIRE(state.current.values.size() == 2);
+
+        std::vector<WorldStateIdentifier> keys;
+        for (auto& value : state.current.values) {
+            keys.push_back(value.first);
+        }
+
+        REQUIRE(keys == std::vector<WorldStateIdentifier>{WorldStateIdentifier::Alertness, WorldStateIdentifier::Curiosity});
+        REQUIRE(state.current.values.find(WorldStateIdentifier::Curiosity)->second == 2.f);
+    }
+
+    SECTION("erase clears the value") {
+        state.current.values[WorldStateIdentifier::Boredom] = 5.f;
+        state.current.values.erase(WorldStateIdentifier::Boredom);
+
+        REQUIRE(state.current.values.count(WorldStateIdentifier::Boredom) == 0);
+        REQUIRE(state.current.values.at(WorldStateIdentifier::Boredom) == 0.f);
+    }
+
+    SECTION("facts keep their defaults until produced") {
+        REQUIRE(state.facts.flags.at(ConsumableFact::Glimpse).consumed);
+
+        state.produceFactFlag(ConsumableFact::Glimpse, true);
+
+        REQUIRE(state.consumeFactFlag(ConsumableFact::Glimpse).flag);
+        REQUIRE(state.facts.flags.find(ConsumableFact::Glimpse)->second.consumed);
+    }
+}
+
+TEST_CASE("pushing and popping task changes", "[worldstate]") {
+    WorldState state;
+    state.current.flags[WorldStateIdentifier::PlayerIdentified] = false;
+    state.current.values[WorldStateIdentifier::Alertness] = 10.f;
+
+    Task task;
+    task.modifiedFlags[WorldStateIdentifier::PlayerIdentified] = true;
+    task.modifiedValues[WorldStateIdentifier::Alertness] = 50.f;
+    task.modifiedVectors[WorldStateIdentifier::Destination] = {1.f, 2.f, 3.f};
+
+    state.pushChanges(task);
+
+    REQUIRE(state.current.flags.at(WorldStateIdentifier::PlayerIdentified));
+    REQUIRE(state.current.values.at(WorldStateIdentifier::Alertness) == 50.f);
+
+    state.popChanges();
+
+    REQUIRE_FALSE(state.current.flags.at(WorldStateIdentifier::PlayerIdentified));
+    REQUIRE(state.current.values.at(WorldStateIdentifier::Alertness) == 10.f);
+    REQUIRE(state.current.vectors.count(WorldStateIdentifier::Destination) == 0);
+    REQUIRE(state.changes.empty());
+    REQUIRE(state.journal.empty());
+}
+
+TEST_CASE("rewinding the journal", "[worldstate]") {
+    WorldState state;
+    state.current.values[WorldStateIdentifier::Boredom] = 1.f;
+
+    auto mark = state.markJournal();
+    state.setValue(WorldStateIdentifier::Boredom, 2.f);
+    state.setValue(WorldStateIdentifier::Boredom, 3.f);
+    state.setFlag(WorldStateIdentifier::PlayerIdentified, true);
+
+    auto inner = state.markJournal();
+    state.setVector(WorldStateIdentifier::PlayerPosition, {4.f, 5.f, 6.f});
+    state.rewindJournal(inner);
+
+    REQUIRE(state.current.vectors.count(WorldStateIdentifier::PlayerPosition) == 0);
+    REQUIRE(state.current.values.at(WorldStateIdentifier::Boredom) == 3.f);
+
+    state.rewindJournal(mark);
+
+    REQUIRE(state.current.values.at(WorldStateIdentifier::Boredom) == 1.f);
+    REQUIRE(state.current.flags.count(WorldStateIdentifier::PlayerIdentified) == 0);
+    REQUIRE(static_cast<int>(state.journal.size()) == mark);
+}
+
+TEST_CASE("change subscriptions", "[worldstate]") {
+    WorldState state;
+    state.setValue(WorldStateIdentifier::Alertness, 10.f);
+
+    StateMask emotions;
+    emotions.values = (1u << static_cast<int>(WorldStateIdentifier::Alertness)) | (1u << static_cast<int>(WorldStateIdentifier::Boredom));
+    emotions.factFlags = 1u << static_cast<int>(ConsumableFact::LostLead);
+    auto subscriber = state.subscribe(emotions);
+
+    SECTION("only subscribed slots that actually changed are reported") {
+        state.setValue(WorldStateIdentifier::Alertness, 10.f);
+        state.setValue(WorldStateIdentifier::Curiosity, 5.f);
+
+        REQUIRE_FALSE(state.takeChanges(subscriber).any());
+
+        state.setValue(WorldStateIdentifier::Alertness, 20.f);
+        state.produceFactFlag(ConsumableFact::LostLead, true);
+        auto changed = state.takeChanges(subscriber);
+
+        REQUIRE(changed.values == 1u << static_cast<int>(WorldStateIdentifier::Alertness));
+        REQUIRE(changed.factFlags != 0);
+        REQUIRE_FALSE(state.takeChanges(subscriber).any());
+    }
+
+    SECTION("rewinding reports the restored slots") {
+        auto mark = state.markJournal();
+        state.setValue(WorldStateIdentifier::Alertness, 30.f);
+        state.takeChanges(subscriber);
+        state.rewindJournal(mark);
+
+        REQUIRE(state.takeChanges(subscriber).values != 0);
+        REQUIRE(state.current.values.at(WorldStateIdentifier::Alertness) == 10.f);
+    }
+}
+
+TEST_CASE("agent state table", "[worldstate]") {
+    AgentStateTable table;
+    auto first = table.addAgent();
+    auto second = table.addAgent();
+
+    SECTION("store and load round trip a row") {
+        State state;
+        state.flags[WorldStateIdentifier::PlayerIdentified] = true;
+        state.values[WorldStateIdentifier::Curiosity] = 3.f;
+        state.vectors[WorldStateIdentifier::Destination] = {1.f, 2.f, 3.f};
+        table.store(second, state);
+
+        WorldState loaded;
+        loaded.current.values[WorldStateIdentifier::Stance] = 1.f;
+        table.load(second, loaded);
+
+        REQUIRE(loaded.current.flags.at(WorldStateIdentifier::PlayerIdentified));
+        REQUIRE(loaded.current.values.at(WorldStateIdentifier::Curiosity) == 3.f);
+        REQUIRE(loaded.current.vectors.at(WorldStateIdentifier::Destination).z == 3.f);
+        REQUIRE(loaded.current.values.count(WorldStateIdentifier::Stance) == 0);
+        REQUIRE(table.getValue(first, WorldStateIdentifier::Curiosity) == 0.f);
+    }
+
+    SECTION("batch tracker updates match ValueOverTimeTracker") {
+        table.setValue(first, WorldStateIdentifier::Alertness, 50.f);
+        table.setValue(second, WorldStateIdentifier::Alertness, 0.f);
+
+        ValueOverTimeTracker tracker;
+        float alertness = 50.f;
+
+        for (int i = 0; i < 600; i++) {
+            table.tickEmotionalState(1.f / 60.f);
+
+            alertness = std::max(alertness - 0.09f, 0.f);
+            tracker.update(alertness, 1.f / 60.f);
+        }
+
+        std::map<WorldStateIdentifier, ValueOverTimeTracker> trackers;
+        table.loadTrackers(first, trackers);
+
+        REQUIRE(table.getValue(first, WorldStateIdentifier::Alertness) == Approx(alertness));
+        REQUIRE(trackers[WorldStateIdentifier::Alertness].maxValue == tracker.maxValue);
+        REQUIRE(trackers[WorldStateIdentifier::Alertness].durationBelowValue == Approx(tracker.durationBelowValue));
+        REQUIRE(table.getValue(second, WorldStateIdentifier::Boredom) == Approx(6.f));
+    }
+
+    SECTION("falling alertness exceeds its extension") {
+        table.setValue(first, WorldStateIdentifier::Alertness, 80.f);
+        std::map<WorldStateIdentifier, ValueOverTimeTracker> trackers;
+        auto exceeds = [&] {
+            table.loadTrackers(first, trackers);
+            return trackerInput(trackers[WorldStateIdentifier::Alertness], ValueOverTimeTracker_Property::DurationExceedsExtension);
+        };
+
+        table.tickEmotionalState(1.f);
+        REQUIRE(exceeds() == 0.f);
+
+        //alertness decays on its own, an eighth of 80 is 10 seconds of it
+        for (int i = 0; i < 11; i++) {
+            table.tickEmotionalState(1.f);
+        }
+
+        REQUIRE(exceeds() == 1.f);
+        REQUIRE(trackerInput(trackers[WorldStateIdentifier::PlayerIdentified], ValueOverTimeTracker_Property::DurationExceedsExtension) == 0.f);
+    }
+
+    SECTION("distances") {
+        table.setVector(first, WorldStateIdentifier::CurrentPosition, {0.f, 0.f, 0.f});
+        table.setVector(first, WorldStateIdentifier::PlayerPosition, {3.f, 4.f, 0.f});
+
+        std::vector<float> distances;
+        table.distancesSquared(WorldStateIdentifier::CurrentPosition, WorldStateIdentifier::PlayerPosition, distances);
+
+        REQUIRE(distances.size() == 2);
+        REQUIRE(distances[0] == 25.f);
+        REQUIRE(distances[1] == 0.f);
+    }
+}
+
+TEST_CASE("state hash", "[worldstate]") {
+    WorldState state;
+    state.setValue(WorldStateIdentifier::Alertness, 40.f);
+    state.setVector(WorldStateIdentifier::CurrentPosition, {100.f, 200.f, 0.f});
+    state.produceFactFlag(ConsumableFact::HasLead, true);
+
+    SECTION("stays equal to a full recompute") {
+        REQUIRE(state.hash == computeHash(state.current, state.facts));
+
+        auto mark = state.markJournal();
+        state.setFlag(WorldStateIdentifier::PlayerIdentified, true);
+        state.remove(StateSlot::Value, WorldStateIdentifier::Alertness);
+        state.consumeFactFlag(ConsumableFact::HasLead);
+        REQUIRE(state.hash == computeHash(state.current, state.facts));
+
+        state.rewindJournal(mark);
+        state.produceFactFlag(ConsumableFact::HasLead, true);
+        REQUIRE(state.hash == computeHash(state.current, state.facts));
+    }
+
+    SECTION("writing the same values back gives the same hash") {
+        auto before = state.hash;
+        state.setValue(WorldStateIdentifier::Alertness, 80.f);
+        REQUIRE(state.hash != before);
+
+        state.setValue(WorldStateIdentifier::Alertness, 40.f);
+        REQUIRE(state.hash == before);
+    }
+
+    SECTION("jitter within a quantization step doesn't change the hash") {
+        auto before = state.hash;
+        state.setVector(WorldStateIdentifier::CurrentPosition, {101.f, 199.f, 0.5f});
+        REQUIRE(state.hash == before);
+
+        state.setVector(WorldStateIdentifier::CurrentPosition, {150.f, 200.f, 0.f});
+        REQUIRE(state.hash != before);
+    }
+
+    SECTION("consumed facts hash the same as missing ones") {
+        WorldState other;
+        other.setValue(WorldStateIdentifier::Alertness, 40.f);
+        other.setVector(WorldStateIdentifier::CurrentPosition, {100.f, 200.f, 0.f});
+
+        state.consumeFactFlag(ConsumableFact::HasLead);
+        REQUIRE(state.hash == other.hash);
+    }
+}
+
+TEST_CASE("snapshots", "[worldstate]") {
+    WorldState state;
+    state.setValue(WorldStateIdentifier::Alertness, 40.f);
+    state.setVector(WorldStateIdentifier::CurrentPosition, {100.f, 200.f, 0.f});
+    state.produceFactFlag(ConsumableFact::HasLead, true);
+    state.valueTrackers[WorldStateIdentifier::Alertness].maxValue = 75.f;
+
+    Engram engram;
+    engram.stimulus.x = 1.f;
+    engram.stimulus.y = 2.f;
+    engram.stimulus.intensity = 3.f;
+    engram.stimulus.type = StimulusType::Auditory;
+    engram.type = EngramType::Heard;
+    engram.age = 4;
+    state.memory.shortTermMemory.push_back(engram);
+    state.memory.focusLocus.emplace_back(engram);
+    state.memory.focusLocus[0].area.radius = 5.f;
+
+    SnapshotWriter writer;
+    writer.begin();
+    writeWorldState(writer, state);
+
+    SECTION("round trips") {
+        WorldState loaded;
+        SnapshotReader reader {writer.getBuffer()};
+        REQUIRE(reader.begin());
+        REQUIRE(readWorldState(reader, loaded, nullptr));
+
+        REQUIRE(loaded.hash == state.hash);
+        REQUIRE(loaded.current.values.at(WorldStateIdentifier::Alertness) == 40.f);
+        REQUIRE(loaded.facts.flags.at(ConsumableFact::HasLead).flag);
+        REQUIRE_FALSE(loaded.facts.flags.at(ConsumableFact::HasLead).consumed);
+        REQUIRE(loaded.valueTrackers[WorldStateIdentifier::Alertness].maxValue == 75.f);
+        REQUIRE(loaded.memory.shortTermMemory.size() == 1);
+        REQUIRE(loaded.memory.shortTermMemory[0].age == 4);
+        REQUIRE(loaded.memory.focusLocus.size() == 1);
+        REQUIRE(loaded.memory.focusLocus[0].engrams.size() == 1);
+        REQUIRE(loaded.memory.focusLocus[0].area.radius == 5.f);
+        REQUIRE(loaded.memory.focusLocus[0].id == state.memory.focusLocus[0].id);
+    }
+
+    SECTION("truncated snapshots fail to load") {
+        auto buffer = writer.getBuffer();
+        buffer.resize(buffer.size() / 2);
+
+        WorldState loaded;
+        SnapshotReader reader {buffer};
+        REQUIRE(reader.begin());
+        REQUIRE_FALSE(readWorldState(reader, loaded, nullptr));
+    }
+
+    SECTION("other versions are refused") {
+        auto buffer = writer.getBuffer();
+        buffer[4]++;
+
+        SnapshotReader reader {buffer};
+        REQUIRE_FALSE(reader.begin());
+    }
+}
+
+TEST_CASE("plan snapshots", "[worldstate]") {
+    auto tasks = setupTasks();
+    WorldQuerier querier;
+    TaskParameters parameters;
+    WorldState state;
+    state.setFlag(WorldStateIdentifier::PlayerIdentified, false);
+    state.setValue(WorldStateIdentifier::Alertness, 0.f);
+
+    auto plan = generatePlan(tasks.tasks[TaskIdentifier::Wander], state, querier, parameters, tasks);
+    REQUIRE(!plan.failed);
+    REQUIRE(plan.size() > 1);
+    plan.currentTask = 1;
+    plan.instances[1].remainingRepeats = 7;
+
+    SnapshotWriter writer;
+    writer.begin();
+    writePlanCursor(writer, getPlanCursor(plan, TaskIdentifier::Wander));
+
+    PlanCursor cursor;
+    SnapshotReader reader {writer.getBuffer()};
+    REQUIRE(reader.begin());
+    REQUIRE(readPlanCursor(reader, cursor));
+
+    SECTION("the plan is rebuilt from its vertices") {
+        auto restored = rebuildPlan(cursor.vertices, cursor.implementations, cursor.revision, tasks);
+        REQUIRE(applyPlanCursor(cursor, restored));
+
+        REQUIRE(restored.size() == plan.size());
+        REQUIRE(restored.getPlanPath() == plan.getPlanPath());
+        REQUIRE(restored.currentTask == 1);
+        REQUIRE(restored.instances[1].remainingRepeats == 7);
+    }
+
+    SECTION("a changed task database can't rebuild it") {
+        tasks.addTask(TaskIdentifier::Relax, Task{"relax"});
+
+        REQUIRE(rebuildPlan(cursor.vertices, cursor.implementations, cursor.revision, tasks).empty());
+    }
+}
+
+TEST_CASE("record and replay", "[worldstate]") {
+    auto setup = [](World& world) {
+        auto actor = world.createActor();
+        actor->addComponent(std::make_unique<HierarchicalTaskNetworkComponent>(actor))->initializeComponent();
+        return actor;
+    };
+
+    GameMode recorded;
+    World recordedWorld {&recorded};
+    recorded.startRecording();
+    auto actor = setup(recordedWorld);
+
+    for (int i = 0; i < 60; i++)
+    {
+        if (i == 20)
+        {
+            auto transform = Math::Transform{{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 50, 50, 0, 1}};
+            actor->setActorTransform(transform);
+            recorded.injectSound({10.f, 10.f}, 5.f, AuditoryTag::Footsteps);
+        }
+
+        recorded.tick();
+    }
+
+    TickReplayer replayer {recorded.getRecorder()->getLog()};
+    REQUIRE(replayer.begin());
+
+    GameMode replayed;
+    World replayedWorld {&replayed};
+    replayed.setSeed(replayer.getSeed());
+    replayed.setPlanWorkerCount(0);
+    setup(replayedWorld);
+
+    while (replayer.step(replayed, replayedWorld)) {}
+
+    REQUIRE_FALSE(replayer.failed());
+    REQUIRE(replayer.getTickCount() == 60);
+    REQUIRE(replayer.getFirstMismatch() == -1);
+    REQUIRE(replayed.getAgentStates().checksum() == recorded.getAgentStates().checksum());
+}
+
+TEST_CASE("squad blackboard", "[worldstate]") {
+    SquadBlackboard squad;
+
+    SECTION("facts start out consumed") {
+        REQUIRE(squad.generation(StateSlot::Vector, ConsumableFact::Player_LastKnownLocation) == 0);
+        REQUIRE(squad.readFactVector(ConsumableFact::Player_LastKnownLocation).consumed);
+    }
+
+    SECTION("reading doesn't claim") {
+        squad.produceFactVector(ConsumableFact::Player_LastKnownLocation, {1.f, 2.f, 3.f});
+        auto read = squad.readFactVector(ConsumableFact::Player_LastKnownLocation);
+        REQUIRE_FALSE(read.consumed);
+        REQUIRE(read.value == Math::Vector3{1.f, 2.f, 3.f});
+
+        FactVector claimed;
+        REQUIRE(squad.consumeFactVector(ConsumableFact::Player_LastKnownLocation, claimed));
+        REQUIRE(claimed.value == read.value);
+        REQUIRE_FALSE(squad.consumeFactVector(ConsumableFact::Player_LastKnownLocation, claimed));
+        REQUIRE(squad.readFactVector(ConsumableFact::Player_LastKnownLocation).consumed);
+    }
+
+    SECTION("each production is claimed exactly once across threads") {
+        const int productions {1000};
+        std::atomic<int> claims {0};
+        std::atomic<bool> producing {true};
+        std::vector<std::thread> consumers;
+
+        for (int i = 0; i < 4; i++)
+        {
+            consumers.emplace_back([&] {
+                FactValue value;
+
+                while (producing)
+                {
+                    if (squad.consumeFactValue(ConsumableFact::Lead, value))
+                    {
+                        claims++;
+                    }
+
+                    std::this_thread::yield();
+                }
+            });
+        }
+
+        int produced {0};
+
+        for (int i = 0; i < productions; i++)
+        {
+            //only produce once the last one was claimed, so none are produced over
+            while (!squad.readFactValue(ConsumableFact::Lead).consumed) {std::this_thread::yield();}
+            squad.produceFactValue(ConsumableFact::Lead, static_cast<float>(i));
+            produced++;
+        }
+
+        while (!squad.readFactValue(ConsumableFact::Lead).consumed) {std::this_thread::yield();}
+        producing = false;
+
+        for (auto& consumer : consumers)
+        {
+            consumer.join();
+        }
+
+        REQUIRE(claims == produced);
+        REQUIRE(squad.generation(StateSlot::Value, ConsumableFact::Lead) == productions);
+    }
+}
+
+TEST_CASE("state deltas", "[worldstate]") {
+    WorldState server;
+    WorldState client;
+    StateDeltaEncoder encoder;
+    StateDeltaDecoder decoder;
+    BitWriter writer;
+
+    SECTION("only changed slots are sent once acknowledged") {
+        server.setValue(WorldStateIdentifier::Alertness, 40.f);
+        server.setVector(WorldStateIdentifier::CurrentPosition, {100.f, 200.f, 0.f});
+        server.produceFactFlag(ConsumableFact::HasLead, true);
+
+        writer.begin();
+        encoder.encode(server, writer);
+        BitReader first {writer.finish()};
+        encoder.acknowledge(decoder.apply(first, client));
+        REQUIRE(client.hash == server.hash);
+
+        auto subscriber = client.subscribe({~0u, ~0u, ~0u, ~0u, ~0u, ~0u});
+        client.takeChanges(subscriber);
+        server.setValue(WorldStateIdentifier::Alertness, 45.f);
+
+        writer.begin();
+        encoder.encode(server, writer);
+        auto& packet = writer.finish();
+        //header, the 6 "any changed" bits, the values mask and 1 + 32 bits for alertness
+        REQUIRE(packet.size() == (64 + 6 + WorldStateIdentifierCount + 33 + 7) / 8);
+
+        BitReader second {packet};
+        REQUIRE(decoder.apply(second, client) != 0);
+        REQUIRE(client.current.values.at(WorldStateIdentifier::Alertness) == 45.f);
+        REQUIRE(client.hash == server.hash);
+
+        auto changed = client.takeChanges(subscriber);
+        REQUIRE(changed.values == 1u << static_cast<int>(WorldStateIdentifier::Alertness));
+        REQUIRE_FALSE(changed.vectors);
+    }
+
+    SECTION("a lossy, laggy loopback catches up") {
+        LoopbackChannel toClient {2, 3};
+        LoopbackChannel toServer {1, 4};
+        std::vector<std::uint8_t> packet;
+
+        for (int tick = 0; tick < 100; tick++)
+        {
+            server.setValue(WorldStateIdentifier::Alertness, static_cast<float>(tick % 7));
+            server.setFlag(WorldStateIdentifier::PlayerIdentified, tick % 10 < 5);
+
+            if (tick % 13 == 0)
+            {
+                server.produceFactVector(ConsumableFact::Player_LastKnownLocation, {static_cast<float>(tick), 0.f, 0.f});
+            }
+            else if (tick % 13 == 6)
+            {
+                server.consumeFactVector(ConsumableFact::Player_LastKnownLocation);
+            }
+
+            //nothing changes for the last few ticks, so the last deltas get through
+            if (tick >= 90)
+            {
+                server.setValue(WorldStateIdentifier::Alertness, 3.f);
+                server.setFlag(WorldStateIdentifier::PlayerIdentified, true);
+            }
+
+            writer.begin();
+            encoder.encode(server, writer);
+            toClient.send(writer.finish());
+
+            while (toClient.receive(packet))
+            {
+                BitReader reader {packet};
+                auto sequence = decoder.apply(reader, client);
+
+                if (sequence != 0)
+                {
+                    BitWriter ack;
+                    ack.write(sequence, 32);
+                    toServer.send(ack.finish());
+                }
+            }
+
+            while (toServer.receive(packet))
+            {
+                BitReader reader {packet};
+                encoder.acknowledge(reader.read(32));
+            }
+
+            toClient.tick();
+            toServer.tick();
+        }
+
+        REQUIRE(client.hash == server.hash);
+        REQUIRE(client.facts.vectors.at(ConsumableFact::Player_LastKnownLocation).consumed 
+            == server.facts.vectors.at(ConsumableFact::Player_LastKnownLocation).consumed);
+    }
+}